@@ -26,6 +26,9 @@
 #include <time.h>
 #include <math.h>
 #include <ctype.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
 
 /*
 
@@ -57,6 +60,7 @@ act_connection *ActSim::runSim (act_connection **cause)
   }
 
   ret = SimDES::Run ();
+  ActSimProfile::leave ();
   
   return NULL;
 }
@@ -70,6 +74,7 @@ act_connection *ActSim::Step (long nsteps)
   }
 
   ret = SimDES::Advance (nsteps);
+  ActSimProfile::leave ();
 
   return NULL;
 }
@@ -83,6 +88,7 @@ act_connection *ActSim::Advance (long delay)
   }
 
   ret = SimDES::AdvanceTime (delay);
+  ActSimProfile::leave ();
 
   return NULL;
 }
@@ -148,6 +154,17 @@ static void _init_prs_objects (ActInstTable *I)
   }
 }
 
+/* summary of the levelized reset pass */
+static void _settle_report (ActSimSettle *settle, int nsettled)
+{
+  printf ("Levelized reset: %d gate%s, %d level%s, %d in cycles; "
+	  "%d Boolean%s settled\n",
+	  settle->numGates(), settle->numGates() == 1 ? "" : "s",
+	  settle->numLevels(), settle->numLevels() == 1 ? "" : "s",
+	  settle->numCyclic(),
+	  nsettled, nsettled == 1 ? "" : "s");
+}
+
 void ActSim::runInit ()
 {
   ActNamespace *g = ActNamespace::Global();
@@ -159,16 +176,18 @@ void ActSim::runInit ()
 
   XyceActInterface::getXyceInterface()->initXyce();
 
+  /*-- all fanout is known at this point --*/
+  packFanout ();
+
   /*-- random init --*/
   for (int i=0; i < A_LEN (_rand_init); i++) {
     int v = random() % 2;
     if (getBool (_rand_init[i]) == 2) {
       if (setBool (_rand_init[i], v)) {
-	SimDES **arr = getFO (_rand_init[i], 0);
-	for (int j=0; j < numFanout (_rand_init[i], 0); j++) {
-	  ActSimDES *x = dynamic_cast<ActSimDES *>(arr[j]);
-	  Assert (x, "What?");
-	  x->propagate ();
+	ActSimDES **arr = getFO (_rand_init[i], 0);
+	int nfanout = numFanout (_rand_init[i], 0);
+	for (int j=0; j < nfanout; j++) {
+	  arr[j]->propagate ();
 	}
       }
     }
@@ -208,6 +227,14 @@ void ActSim::runInit ()
 
   config_set_default_int ("sim.reset_rounds", 100);
 
+  /* -- optional levelized settling of production rules -- */
+  ActSimSettle *settle = NULL;
+  int nsettled = 0;
+  if (config_get_int ("sim.reset_levelized")) {
+    settle = new ActSimSettle (this);
+    nsettled += settle->Run (config_get_int ("sim.reset_rounds"));
+  }
+
   if (!g->getlang() || !g->getlang()->getinit()) {
     if (fragmented_set) {
       int count = 0;
@@ -218,11 +245,18 @@ void ActSim::runInit ()
 	if (SimDES::AdvanceTime (10) != NULL) {
 	  warning ("breakpoint?");
 	}
+	if (settle) {
+	  nsettled += settle->Run (max_count);
+	}
       }
       if (count == max_count) {
 	warning ("Pending production rule events during reset phase?");
       }
     }
+    if (settle) {
+      _settle_report (settle, nsettled);
+      delete settle;
+    }
     setMode (0);
     for (li = list_first (_chp_sim_objects); li; li = list_next (li)) {
       ChpSim *cx = (ChpSim *) list_value (li);
@@ -281,6 +315,9 @@ void ActSim::runInit ()
 	  if (SimDES::AdvanceTime (100) != NULL) {
 	    warning ("breakpoint?");
 	  }
+	  if (settle) {
+	    nsettled += settle->Run (max_rounds);
+	  }
 	  count++;
 	  if (!SimDES::matchPendingEvent (_match_hseprs)) {
 	    break;
@@ -310,6 +347,10 @@ void ActSim::runInit ()
     }
   }
   FREE (lia);
+  if (settle) {
+    _settle_report (settle, nsettled);
+    delete settle;
+  }
   setMode (0);
   for (li = list_first (_chp_sim_objects); li; li = list_next (li)) {
     ChpSim *cx = (ChpSim *) list_value (li);
@@ -369,6 +410,10 @@ static int _pend_prs;
 
 static bool _match_count (Event *e)
 {
+  if (ChpSimRunQueue *rq = dynamic_cast <ChpSimRunQueue *> (e->getObj())) {
+    _pend_count += rq->length ();
+    return false;
+  }
   _pend_count++;
   if (dynamic_cast <OnePrsSim *> (e->getObj())) {
     _pend_prs++;
@@ -382,6 +427,23 @@ static bool _match_verbose (Event *e, unsigned long tm)
   OnePrsSim *pobj = NULL;
   MultiPrsSim *mpobj = NULL;
   unsigned long now = SimDES::CurTimeLo();
+
+  if (ChpSimRunQueue *rq = dynamic_cast<ChpSimRunQueue *> (e->getObj())) {
+    for (int i=0; i < rq->length(); i++) {
+      const struct chpsim_rq_entry *re = rq->entry (i);
+      printf ("%10lu [chp] ", (re->t - now));
+      if (re->c->getProc()) {
+	char *tmp = re->c->getProc()->getFullName();
+	printf ("%s / ", tmp);
+	FREE (tmp);
+      }
+      if (re->c->getName()) {
+	re->c->getName()->Print (stdout);
+      }
+      printf (" (run queue)\n");
+    }
+    return false;
+  }
   if (!obj) {
     pobj = dynamic_cast<OnePrsSim *> (e->getObj());
     if (!pobj) {
@@ -472,6 +534,750 @@ void runPending (bool verbose)
 }
 
 
+/* event statistics */
+
+unsigned long ActSimEvents::_scheduled = 0;
+unsigned long ActSimEvents::_cancelled = 0;
+unsigned long ActSimEvents::_executed = 0;
+unsigned long ActSimEvents::_recycled = 0;
+unsigned long ActSimEvents::_coalesced = 0;
+long ActSimEvents::_live = 0;
+long ActSimEvents::_peak = 0;
+
+void ActSimEvents::Print (FILE *fp)
+{
+  fprintf (fp, "Events scheduled: %lu\n", _scheduled);
+  fprintf (fp, "Events executed: %lu\n", _executed);
+  fprintf (fp, "Events cancelled: %lu\n", _cancelled);
+  fprintf (fp, "Objects recycled: %lu\n", _recycled);
+  fprintf (fp, "Events coalesced: %lu\n", _coalesced);
+  fprintf (fp, "Live events: %ld (peak %ld)\n", _live, _peak);
+}
+
+void ActSimEvents::Clear ()
+{
+  _scheduled = 0;
+  _cancelled = 0;
+  _executed = 0;
+  _recycled = 0;
+  _coalesced = 0;
+  /* live events are still in the queue */
+  _peak = _live;
+}
+
+
+/*------------------------------------------------------------------------
+ *
+ *  Profiler
+ *
+ *------------------------------------------------------------------------
+ */
+
+int ActSimProfile::_on = 0;
+int ActSimProfile::_cur_set = 0;
+ActSimObj *ActSimProfile::_cur = NULL;
+unsigned long ActSimProfile::_t = 0;
+struct actsim_prof_cnt ActSimProfile::_other = { 0, 0, 0 };
+unsigned long ActSimProfile::_cal_ticks = 0;
+double ActSimProfile::_cal_sec = 0;
+
+unsigned long ActSimProfile::now ()
+{
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc ();
+#else
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec*1000000000UL + ts.tv_nsec;
+#endif
+}
+
+static double _prof_wall ()
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+void ActSimProfile::Start ()
+{
+  if (_cal_sec == 0) {
+    _cal_ticks = now ();
+    _cal_sec = _prof_wall ();
+  }
+  _cur_set = 0;
+  _on = 1;
+}
+
+void ActSimProfile::Stop ()
+{
+  leave ();
+  _on = 0;
+}
+
+static void _prof_clear (ActInstTable *t)
+{
+  if (t->obj) {
+    struct actsim_prof_cnt *p = t->obj->getProf ();
+    p->events = 0;
+    p->cancelled = 0;
+    p->ticks = 0;
+  }
+  if (t->H) {
+    hash_bucket_t *b;
+    hash_iter_t i;
+    hash_iter_init (t->H, &i);
+    while ((b = hash_iter_next (t->H, &i))) {
+      _prof_clear ((ActInstTable *) b->v);
+    }
+  }
+}
+
+void ActSimProfile::Clear (ActInstTable *I)
+{
+  _prof_clear (I);
+  _other.events = 0;
+  _other.cancelled = 0;
+  _other.ticks = 0;
+  _cur_set = 0;
+}
+
+/* seconds per tick */
+double ActSimProfile::_tickTime ()
+{
+#if defined(__x86_64__) || defined(__i386__)
+  unsigned long t;
+  double sec;
+
+  if (_cal_sec == 0) {
+    return 0;
+  }
+  t = now ();
+  sec = _prof_wall ();
+  if (t == _cal_ticks) {
+    return 0;
+  }
+  return (sec - _cal_sec)/(t - _cal_ticks);
+#else
+  return 1e-9;
+#endif
+}
+
+struct prof_inst {
+  char *name;			// instance name
+  struct actsim_prof_cnt self;	// this object
+  struct actsim_prof_cnt tot;	// including sub-instances
+};
+
+A_DECL (struct prof_inst, _prof_tab);
+
+static void _prof_add (struct actsim_prof_cnt *x, struct actsim_prof_cnt *y)
+{
+  x->events += y->events;
+  x->cancelled += y->cancelled;
+  x->ticks += y->ticks;
+}
+
+/* collect the instance table in pre-order, returning the subtree totals */
+static struct actsim_prof_cnt _prof_collect (ActInstTable *t,
+					      const char *name)
+{
+  int idx;
+  struct actsim_prof_cnt tot;
+
+  A_NEW (_prof_tab, struct prof_inst);
+  idx = A_LEN (_prof_tab);
+  A_NEXT (_prof_tab).name = Strdup (name);
+  if (t->obj) {
+    A_NEXT (_prof_tab).self = *(t->obj->getProf());
+  }
+  else {
+    A_NEXT (_prof_tab).self.events = 0;
+    A_NEXT (_prof_tab).self.cancelled = 0;
+    A_NEXT (_prof_tab).self.ticks = 0;
+  }
+  A_INC (_prof_tab);
+  tot = _prof_tab[idx].self;
+
+  if (t->H) {
+    hash_bucket_t *b;
+    hash_iter_t i;
+    char *buf;
+    int len;
+
+    hash_iter_init (t->H, &i);
+    while ((b = hash_iter_next (t->H, &i))) {
+      struct actsim_prof_cnt sub;
+      len = strlen (name) + strlen (b->key) + 2;
+      MALLOC (buf, char, len);
+      if (name[0]) {
+	snprintf (buf, len, "%s.%s", name, b->key);
+      }
+      else {
+	snprintf (buf, len, "%s", b->key);
+      }
+      sub = _prof_collect ((ActInstTable *) b->v, buf);
+      _prof_add (&tot, &sub);
+      FREE (buf);
+    }
+  }
+  _prof_tab[idx].tot = tot;
+  return tot;
+}
+
+static void _prof_free ()
+{
+  for (int i=0; i < A_LEN (_prof_tab); i++) {
+    FREE (_prof_tab[i].name);
+  }
+  A_FREE (_prof_tab);
+}
+
+static int _prof_cmp (const void *a, const void *b)
+{
+  const struct prof_inst *x = (const struct prof_inst *) a;
+  const struct prof_inst *y = (const struct prof_inst *) b;
+
+  if (x->self.ticks != y->self.ticks) {
+    return x->self.ticks > y->self.ticks ? -1 : 1;
+  }
+  if (x->self.events != y->self.events) {
+    return x->self.events > y->self.events ? -1 : 1;
+  }
+  return strcmp (x->name, y->name);
+}
+
+static int _prof_cmp_events (const void *a, const void *b)
+{
+  const struct prof_inst *x = (const struct prof_inst *) a;
+  const struct prof_inst *y = (const struct prof_inst *) b;
+
+  if (x->self.events != y->self.events) {
+    return x->self.events > y->self.events ? -1 : 1;
+  }
+  return strcmp (x->name, y->name);
+}
+
+void ActSimProfile::Report (FILE *fp, ActInstTable *I, int top,
+			    int events_only)
+{
+  struct actsim_prof_cnt tot;
+  double ttot, tt;
+  int i, n;
+
+  A_INIT (_prof_tab);
+  tot = _prof_collect (I, "");
+  _prof_add (&tot, &_other);
+
+  if (tot.events == 0 && tot.cancelled == 0) {
+    fprintf (fp, "No profile data (use `profile start').\n");
+    _prof_free ();
+    return;
+  }
+
+  if (events_only) {
+    fprintf (fp, "Profile: %lu events, %lu cancelled\n", tot.events,
+	     tot.cancelled);
+    fprintf (fp, "%12s %10s  %s\n", "events", "cancelled", "instance");
+    qsort (_prof_tab, A_LEN (_prof_tab), sizeof (struct prof_inst),
+	   _prof_cmp_events);
+    n = 0;
+    for (i=0; i < A_LEN (_prof_tab) && (top <= 0 || n < top); i++) {
+      struct prof_inst *p = &_prof_tab[i];
+      if (p->self.events == 0 && p->self.cancelled == 0) {
+	continue;
+      }
+      n++;
+      fprintf (fp, "%12lu %10lu  %s\n", p->self.events, p->self.cancelled,
+	       p->name[0] ? p->name : "<top>");
+    }
+    if (_other.events > 0 || _other.cancelled > 0) {
+      fprintf (fp, "%12lu %10lu  %s\n", _other.events, _other.cancelled,
+	       "<other>");
+    }
+    _prof_free ();
+    return;
+  }
+
+  tt = _tickTime ();
+  ttot = tot.ticks > 0 ? tot.ticks : 1;
+
+  fprintf (fp, "Profile: %lu events, %lu cancelled", tot.events,
+	   tot.cancelled);
+  if (tt > 0) {
+    fprintf (fp, ", %.3f ms", tot.ticks*tt*1e3);
+  }
+  fprintf (fp, "\n");
+  fprintf (fp, "%7s %7s %12s %10s  %s\n", "self%", "total%", "events",
+	   "cancelled", "instance");
+
+  qsort (_prof_tab, A_LEN (_prof_tab), sizeof (struct prof_inst), _prof_cmp);
+  n = 0;
+  for (i=0; i < A_LEN (_prof_tab) && (top <= 0 || n < top); i++) {
+    struct prof_inst *p = &_prof_tab[i];
+    if (p->self.events == 0 && p->self.cancelled == 0 && p->self.ticks == 0) {
+      continue;
+    }
+    n++;
+    fprintf (fp, "%6.2f%% %6.2f%% %12lu %10lu  %s\n",
+	     100.0*p->self.ticks/ttot, 100.0*p->tot.ticks/ttot,
+	     p->self.events, p->self.cancelled,
+	     p->name[0] ? p->name : "<top>");
+  }
+  if (_other.events > 0 || _other.cancelled > 0) {
+    fprintf (fp, "%6.2f%% %7s %12lu %10lu  %s\n",
+	     100.0*_other.ticks/ttot, "-", _other.events, _other.cancelled,
+	     "<other>");
+  }
+  _prof_free ();
+}
+
+/*
+ * Folded stacks, one line per instance with its own time in
+ * microseconds (or events, if time is not available or events_only
+ * is set). The output can
+ * be fed directly to flamegraph.pl.
+ */
+void ActSimProfile::Folded (FILE *fp, ActInstTable *I, int events_only)
+{
+  double tt;
+  int i;
+
+  A_INIT (_prof_tab);
+  _prof_collect (I, "");
+  tt = events_only ? 0 : _tickTime ();
+
+  for (i=0; i < A_LEN (_prof_tab); i++) {
+    struct prof_inst *p = &_prof_tab[i];
+    unsigned long v;
+
+    v = tt > 0 ? (unsigned long) (p->self.ticks*tt*1e6 + 0.5) :
+      p->self.events;
+    if (v == 0) {
+      continue;
+    }
+    fprintf (fp, "top");
+    if (p->name[0]) {
+      fputc (';', fp);
+      for (char *s = p->name; *s; s++) {
+	fputc (*s == '.' ? ';' : *s, fp);
+      }
+    }
+    fprintf (fp, " %lu\n", v);
+  }
+  if (_other.events > 0) {
+    unsigned long v = tt > 0 ?
+      (unsigned long) (_other.ticks*tt*1e6 + 0.5) : _other.events;
+    if (v > 0) {
+      fprintf (fp, "top;<other> %lu\n", v);
+    }
+  }
+  _prof_free ();
+}
+
+
+
+/*------------------------------------------------------------------------
+ *
+ *  Checkpoint/restore
+ *
+ *  File layout (version 2): every field is a fixed-width
+ *  little-endian value (see actsim_write_u32/u64).
+ *
+ *    header  : magic (8 bytes), version, # of Booleans, ints and
+ *              channels, # of objects, random seed (all u32), and
+ *              the current time (u64)
+ *    state   : the state vector, then the state of each simulation
+ *              object in instance-table order
+ *    events  : count (u32), then for each pending event its kind,
+ *              type, object index and gate index (u32) followed by
+ *              its delay relative to the checkpoint time (u64)
+ *
+ *------------------------------------------------------------------------
+ */
+
+#define ACTSIM_CKPT_MAGIC   "ACTSIMCK"
+#define ACTSIM_CKPT_VERSION 2
+
+#define CKPT_EV_OBJ   0		/* event for an ActSimObj */
+#define CKPT_EV_GATE  1		/* event for a production rule */
+#define CKPT_EV_MULTI 2		/* event for a multi-driver node */
+
+struct ckpt_event {
+  Event *e;
+  unsigned long tm;
+};
+
+A_DECL (struct ckpt_event, _ckpt_ev);
+
+static bool _match_collect (Event *e, unsigned long tm)
+{
+  A_NEW (_ckpt_ev, struct ckpt_event);
+  A_NEXT (_ckpt_ev).e = e;
+  A_NEXT (_ckpt_ev).tm = tm;
+  A_INC (_ckpt_ev);
+  return false;
+}
+
+static void _collect_events ()
+{
+  A_INIT (_ckpt_ev);
+  SimDES::matchPendingEvent (_match_collect);
+}
+
+static void _collect_objs (ActInstTable *t, list_t *l)
+{
+  if (!t) {
+    return;
+  }
+  if (t->obj) {
+    list_append (l, t->obj);
+  }
+  if (t->H) {
+    hash_bucket_t *b;
+    hash_iter_t i;
+    hash_iter_init (t->H, &i);
+    while ((b = hash_iter_next (t->H, &i))) {
+      _collect_objs ((ActInstTable *) b->v, l);
+    }
+  }
+}
+
+struct ckpt_header {
+  char magic[8];
+  unsigned int version;
+  unsigned int nbools, nints, nchans;
+  unsigned int nobjs;
+  unsigned int seed;
+  unsigned long tm;
+};
+
+static void _write_header (FILE *fp, struct ckpt_header *h)
+{
+  actsim_write (fp, h->magic, 8);
+  actsim_write_u32 (fp, h->version);
+  actsim_write_u32 (fp, h->nbools);
+  actsim_write_u32 (fp, h->nints);
+  actsim_write_u32 (fp, h->nchans);
+  actsim_write_u32 (fp, h->nobjs);
+  actsim_write_u32 (fp, h->seed);
+  actsim_write_u64 (fp, h->tm);
+}
+
+/* returns 0 if this is not a checkpoint we can read */
+static int _read_header (FILE *fp, struct ckpt_header *h)
+{
+  actsim_read (fp, h->magic, 8);
+  if (memcmp (h->magic, ACTSIM_CKPT_MAGIC, 8) != 0) {
+    warning ("restore: not an actsim checkpoint");
+    return 0;
+  }
+  h->version = actsim_read_u32 (fp);
+  if (h->version != ACTSIM_CKPT_VERSION) {
+    warning ("restore: unsupported checkpoint version %u", h->version);
+    return 0;
+  }
+  h->nbools = actsim_read_u32 (fp);
+  h->nints = actsim_read_u32 (fp);
+  h->nchans = actsim_read_u32 (fp);
+  h->nobjs = actsim_read_u32 (fp);
+  h->seed = actsim_read_u32 (fp);
+  h->tm = actsim_read_u64 (fp);
+  return 1;
+}
+
+static void _write_event (FILE *fp, int *ev, unsigned long delay)
+{
+  for (int i=0; i < 4; i++) {
+    actsim_write_u32 (fp, ev[i]);
+  }
+  actsim_write_u64 (fp, delay);
+}
+
+static unsigned long _read_event (FILE *fp, int *ev)
+{
+  for (int i=0; i < 4; i++) {
+    ev[i] = actsim_read_u32 (fp);
+  }
+  return actsim_read_u64 (fp);
+}
+
+void ActSim::saveSim (FILE *fp)
+{
+  struct ckpt_header h;
+  list_t *objs;
+  listitem_t *li;
+  struct pHashtable *H;
+  unsigned long now;
+  int count, skipped;
+  int idx;
+
+  objs = list_new ();
+  _collect_objs (getInstTable (), objs);
+
+  memcpy (h.magic, ACTSIM_CKPT_MAGIC, 8);
+  h.version = ACTSIM_CKPT_VERSION;
+  h.nbools = state->numBools ();
+  h.nints = state->numInts ();
+  h.nchans = state->numChans ();
+  h.nobjs = list_length (objs);
+  h.seed = getRandomSeed ();
+  h.tm = SimDES::CurTimeLo ();
+  _write_header (fp, &h);
+
+  state->saveState (fp);
+
+  H = phash_new (16);
+  idx = 0;
+  for (li = list_first (objs); li; li = list_next (li)) {
+    ActSimObj *obj = (ActSimObj *) list_value (li);
+    phash_bucket_t *b = phash_add (H, obj);
+    b->i = idx++;
+    if (PrsSim *ps = dynamic_cast<PrsSim *> (obj)) {
+      ps->saveState (fp);
+    }
+    else if (ChpSim *cs = dynamic_cast<ChpSim *> (obj)) {
+      cs->saveState (fp);
+    }
+  }
+
+  /*-- pending events --*/
+  _collect_events ();
+  now = SimDES::CurTimeLo ();
+  count = 0;
+  skipped = 0;
+  for (int pass=0; pass < 2; pass++) {
+    if (pass == 1) {
+      actsim_write_u32 (fp, count);
+    }
+    for (int i=0; i < A_LEN (_ckpt_ev); i++) {
+      Event *e = _ckpt_ev[i].e;
+      int ev[4];
+      phash_bucket_t *b;
+      
+      if (ChpSimRunQueue *rq = dynamic_cast<ChpSimRunQueue *> (e->getObj())) {
+	/* steps in the CHP run queue are saved as ordinary events */
+	for (int k=0; k < rq->length(); k++) {
+	  const struct chpsim_rq_entry *re = rq->entry (k);
+	  b = phash_lookup (H, re->c);
+	  if (!b) {
+	    if (pass == 0) {
+	      skipped++;
+	    }
+	    continue;
+	  }
+	  if (pass == 0) {
+	    count++;
+	  }
+	  else {
+	    unsigned long delay = re->t - now;
+	    ev[0] = CKPT_EV_OBJ;
+	    ev[1] = re->type;
+	    ev[2] = b->i;
+	    ev[3] = -1;
+	    _write_event (fp, ev, delay);
+	  }
+	}
+	continue;
+      }
+      ev[1] = e->getType ();
+      ev[2] = -1;
+      ev[3] = -1;
+      if (OnePrsSim *op = dynamic_cast<OnePrsSim *> (e->getObj())) {
+	b = phash_lookup (H, op->getPrsSim());
+	ev[0] = CKPT_EV_GATE;
+	if (b) {
+	  ev[2] = b->i;
+	  ev[3] = op->getPrsSim()->gateIndex (op);
+	}
+      }
+      else if (MultiPrsSim *mp = dynamic_cast<MultiPrsSim *> (e->getObj())) {
+	ev[0] = CKPT_EV_MULTI;
+	ev[2] = mp->causeGlobalIdx ();
+      }
+      else {
+	ev[0] = CKPT_EV_OBJ;
+	b = phash_lookup (H, e->getObj());
+	if (b) {
+	  ev[2] = b->i;
+	}
+	if (dynamic_cast<ChpSim *> (e->getObj()) &&
+	    SIM_EV_TYPE (ev[1]) == MAX_LOCAL_PCS) {
+	  /* shared-variable wake-ups are re-created on restore */
+	  continue;
+	}
+      }
+      if (ev[2] == -1) {
+	if (pass == 0) {
+	  skipped++;
+	}
+	continue;
+      }
+      if (pass == 0) {
+	count++;
+      }
+      else {
+	unsigned long delay = _ckpt_ev[i].tm - now;
+	_write_event (fp, ev, delay);
+      }
+    }
+  }
+  A_FREE (_ckpt_ev);
+  phash_free (H);
+  list_free (objs);
+
+  if (skipped > 0) {
+    warning ("checkpoint: %d pending event%s not saved (not part of the design instance table)", skipped, skipped == 1 ? "" : "s");
+  }
+}
+
+int ActSim::restoreSim (FILE *fp)
+{
+  struct ckpt_header h;
+  list_t *objs;
+  listitem_t *li;
+  ActSimObj **arr;
+  bitset_t **sched;
+  unsigned long now;
+  int nobjs, count;
+  int i;
+
+  if (!_read_header (fp, &h)) {
+    return 0;
+  }
+  objs = list_new ();
+  _collect_objs (getInstTable (), objs);
+  if (h.nbools != (unsigned)state->numBools () ||
+      h.nints != (unsigned)state->numInts () ||
+      h.nchans != (unsigned)state->numChans () ||
+      h.nobjs != (unsigned)list_length (objs)) {
+    warning ("restore: checkpoint is for a different design");
+    list_free (objs);
+    return 0;
+  }
+  /* simulation time only moves forward */
+  now = SimDES::CurTimeLo ();
+  if (h.tm < now) {
+    warning ("restore: checkpoint time %lu is earlier than the current time %lu", h.tm, now);
+    list_free (objs);
+    return 0;
+  }
+  nobjs = h.nobjs;
+
+  MALLOC (arr, ActSimObj *, nobjs + 1);
+  MALLOC (sched, bitset_t *, nobjs + 1);
+  i = 0;
+  for (li = list_first (objs); li; li = list_next (li)) {
+    sched[i] = NULL;
+    arr[i++] = (ActSimObj *) list_value (li);
+  }
+  list_free (objs);
+
+  /*-- discard the current event queue and wait lists --*/
+  if (chpRunQueue ()) {
+    chpRunQueue ()->clear ();
+  }
+  _collect_events ();
+  for (i=0; i < A_LEN (_ckpt_ev); i++) {
+    /* this includes wake-ups that were never counted */
+    _ckpt_ev[i].e->Remove ();
+  }
+  A_FREE (_ckpt_ev);
+  ActSimEvents::discardAll ();
+
+  /* with the event queue empty, this just moves the clock */
+  while (now < h.tm) {
+    unsigned long dt = h.tm - now;
+    if (dt > (1UL << 30)) {
+      dt = (1UL << 30);
+    }
+    SimDES::AdvanceTime (dt);
+    now += dt;
+  }
+
+  for (i=0; i < nobjs; i++) {
+    if (ChpSim *cs = dynamic_cast<ChpSim *> (arr[i])) {
+      cs->detachWaits ();
+    }
+  }
+
+  state->restoreState (fp);
+
+  for (i=0; i < nobjs; i++) {
+    if (PrsSim *ps = dynamic_cast<PrsSim *> (arr[i])) {
+      ps->restoreState (fp);
+    }
+    else if (ChpSim *cs = dynamic_cast<ChpSim *> (arr[i])) {
+      cs->restoreState (fp);
+    }
+  }
+
+  /*-- pending events --*/
+  count = actsim_read_u32 (fp);
+  for (int j=0; j < count; j++) {
+    int ev[4];
+    unsigned long delay = _read_event (fp, ev);
+
+    if (ev[0] == CKPT_EV_GATE) {
+      if (ev[2] < 0 || ev[2] >= nobjs || !dynamic_cast<PrsSim *> (arr[ev[2]])) {
+	fatal_error ("restore: corrupt event");
+      }
+      OnePrsSim *op = ((PrsSim *)arr[ev[2]])->getGate (ev[3]);
+      op->setPending (op->getPendingFlags(),
+		      ActSimEvents::mk (op, ev[1], delay));
+    }
+    else if (ev[0] == CKPT_EV_MULTI) {
+      MultiPrsSim *mp = getMulti (ev[2]);
+      if (!mp) {
+	fatal_error ("restore: corrupt event");
+      }
+      OnePrsSim *op = mp->getOneDriver (0);
+      op->setPending (op->getPendingFlags(),
+		      ActSimEvents::mk (mp, ev[1], delay));
+    }
+    else {
+      if (ev[2] < 0 || ev[2] >= nobjs) {
+	fatal_error ("restore: corrupt event");
+      }
+      ChpSim *cs = dynamic_cast<ChpSim *> (arr[ev[2]]);
+      if (cs && (SIM_EV_FLAGS (ev[1]) != 0 ||
+		 SIM_EV_TYPE (ev[1]) == MAX_LOCAL_PCS)) {
+	ActSimEvents::mkWakeup (cs, ev[1], delay);
+      }
+      else {
+	ActSimEvents::mk (arr[ev[2]], ev[1], delay);
+      }
+      if (cs) {
+	if (SIM_EV_TYPE (ev[1]) < cs->numPCs()) {
+	  if (!sched[ev[2]]) {
+	    sched[ev[2]] = bitset_new (cs->numPCs());
+	  }
+	  bitset_set (sched[ev[2]], SIM_EV_TYPE (ev[1]));
+	}
+      }
+    }
+  }
+
+  /*-- re-register blocked processes --*/
+  for (i=0; i < nobjs; i++) {
+    if (PrsSim *ps = dynamic_cast<PrsSim *> (arr[i])) {
+      ps->clearStalePending ();
+    }
+    else if (ChpSim *cs = dynamic_cast<ChpSim *> (arr[i])) {
+      cs->restoreWaits (sched[i]);
+    }
+    if (sched[i]) {
+      bitset_free (sched[i]);
+    }
+  }
+  FREE (sched);
+  FREE (arr);
+
+  setRandomSeed (h.seed);
+  return 1;
+}
+
+
 /*------------------------------------------------------------------------
  *
  *  Basic methods for all act simulation objects
@@ -487,6 +1293,9 @@ ActSimObj::ActSimObj (ActSimCore *sim, Process *p)
   _abs_port_chan = NULL;
   name = NULL;
   _shared = new WaitForOne(0);
+  _prof.events = 0;
+  _prof.cancelled = 0;
+  _prof.ticks = 0;
 }
 
 
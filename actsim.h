@@ -31,6 +31,7 @@
 #include <act/sdf.h>
 #include <regex.h>
 #include <stdlib.h>
+#include <time.h>
 #include <math.h>
 #include <common/int.h>
 #include "actsim_ext.h"
@@ -78,19 +79,85 @@ class MultiPrsSim;
  */
 #define TRACE_NUM_FORMATS 3
 
+/*
+ * Booleans are stored in three separate planes of words: the value,
+ * the X bit, and the "special" bit (bool has constraints attached to
+ * it). Bool x is bit (x % ACT_BOOL_WORDBITS) of word
+ * (x / ACT_BOOL_WORDBITS) in each plane. If the X bit is set, the value
+ * bit is ignored.
+ */
+#define ACT_BOOL_WORDBITS (8*(int)sizeof (unsigned long))
+#define ACT_BOOL_WORD(x)  ((x)/ACT_BOOL_WORDBITS)
+#define ACT_BOOL_MASK(x)  (1UL << ((x) % ACT_BOOL_WORDBITS))
+
+/*
+ * Integers up to this width are stored natively in ActSimState.
+ */
+#define ACT_INT_NATIVE_BITS (8*(int)sizeof (unsigned long))
+
 class ActSimState {
 public:
   ActSimState (int bools, int ints, int chans);
   ~ActSimState ();
 
-  BigInt *getInt (int x);
+  /*
+   * Integers of width <= ACT_INT_NATIVE_BITS are stored as a raw
+   * word plus a width; wider integers are kept as BigInts in a
+   * dense side array, and ival[] holds their index. getInt()
+   * returns a copy of the value; getWideInt() returns the stored
+   * value of a wide integer.
+   */
+  BigInt getInt (int x);
   void setInt (int x, BigInt &v);
-  int getBool (int x);
-  inline bool isSpecialBool (int x) { return bitset_tst (bits, 3*x+2); }
-  void mkSpecialBool (int x) { bitset_set (bits, 3*x+2); }
+  void setInt (int x, unsigned long v, int w);
+
+  inline int isWideInt (int x) { return iwidth[x] > ACT_INT_NATIVE_BITS; }
+  inline const BigInt &getWideInt (int x) { return *iwide[ival[x]]; }
+  inline int getIntWidth (int x) {
+    return isWideInt (x) ? getWideInt (x).getWidth() : iwidth[x];
+  }
+  /* low word of the integer */
+  inline unsigned long getIntVal (int x) {
+    return isWideInt (x) ? getWideInt (x).getVal (0) : ival[x];
+  }
+
+  inline int getBool (int x) {
+    unsigned long m = ACT_BOOL_MASK (x);
+    if (bx[ACT_BOOL_WORD (x)] & m) {
+      return 2;
+    }
+    return (bval[ACT_BOOL_WORD (x)] & m) ? 1 : 0;
+  }
+  inline bool isSpecialBool (int x) {
+    return (bspecial[ACT_BOOL_WORD (x)] & ACT_BOOL_MASK (x)) ? true : false;
+  }
+  void mkSpecialBool (int x) { bspecial[ACT_BOOL_WORD (x)] |= ACT_BOOL_MASK (x); }
   bool setBool (int x, int v); // success == true
+
+  /*-- word-level access to the Boolean state --*/
+  int numBools () { return nbools; }
+  int numBoolWords () { return nbwords; }
+  unsigned long getBoolWord (int w) { return bval[w]; }
+  unsigned long getXWord (int w) { return bx[w]; }
+  unsigned long getSpecialWord (int w) { return bspecial[w]; }
+
+  /*
+   * Raw update of one word of value and X bits; bypasses
+   * constraint checks. Used to restore state.
+   */
+  void setBoolWord (int w, unsigned long v, unsigned long xv);
+
+  /*
+   * Extract n <= ACT_BOOL_WORDBITS consecutive Booleans starting at
+   * offset start; bit i of *v/*xv corresponds to Boolean start+i.
+   */
+  void getBoolRange (int start, int n, unsigned long *v, unsigned long *xv);
+
+  /* number of Booleans whose value is val (0, 1, or 2 for X) */
+  int countBools (int val);
   act_channel_state *getChan (int x);
   int numChans () { return nchans; }
+  int numInts () { return nints; }
 
   void *allocState (int sz);
 
@@ -110,12 +177,30 @@ public:
     }
   }
 
+  /* binary save/restore of all values and channel state; restore
+     frees the channel probe wait lists, which the probing processes
+     re-create when they re-evaluate their guards */
+  void saveState (FILE *fp);
+  void restoreState (FILE *fp);
+
 private:
+  void _setInt (int x, BigInt &v);
+  void _setWide (int x);
+  void _clrWide (int x);
+
   bitset_t *hazards;		/* hazard information */
-  bitset_t *bits;		/* Booleans */
+  unsigned long *bval;		/* Boolean values */
+  unsigned long *bx;		/* Boolean X bits */
+  unsigned long *bspecial;	/* Booleans with constraints */
   int nbools;			/* # of Booleans */
+  int nbwords;			/* # of words in each plane */
   
-  BigInt *ival;			/* integers */
+  unsigned long *ival;		/* integer values; index into iwide
+				   for wide integers */
+  unsigned char *iwidth;	/* integer widths; > ACT_INT_NATIVE_BITS
+				   means the value is in iwide */
+  A_DECL (BigInt *, iwide);	/* wide integer values */
+  A_DECL (int, iwide_free);	/* unused entries in iwide */
   int nints;			/* number of integers */
 
 
@@ -126,6 +211,9 @@ private:
 };
 
 
+class ActSimObj;
+struct ActInstTable;
+
 class ActSimDES : public SimDES {
 public:
   virtual ~ActSimDES() { };
@@ -134,9 +222,134 @@ public:
     buf[0] = '\0';
   }
   virtual int causeGlobalIdx() { return -1; }
+
+  /* simulation object charged with this object's work by the
+     profiler */
+  virtual ActSimObj *profObj () { return NULL; }
+};
+
+/*
+ * Per-instance profile counters
+ */
+struct actsim_prof_cnt {
+  unsigned long events;		// # of events executed
+  unsigned long cancelled;	// # of its events cancelled
+  unsigned long ticks;		// time spent
+};
+
+/*
+ * Opt-in profiler. When it is on, each executed event is charged to
+ * the simulation object that handles it; the time from one event to
+ * the next is charged to the object handling the first one.
+ */
+class ActSimProfile {
+public:
+  static inline int on () { return _on; }
+
+  /* current time in ticks (cycle counter where available) */
+  static unsigned long now ();
+
+  static inline void enter (ActSimObj *o);
+  static inline void cancelled (Event *ev);
+
+  /* end of a simulation run: close the current interval */
+  static inline void leave () {
+    if (_cur_set) {
+      _charge (now ());
+      _cur_set = 0;
+    }
+  }
+
+  static void Start ();
+  static void Stop ();
+  static void Clear (ActInstTable *I);
+
+  /* print the <top> hottest instances, or folded stacks; with
+     events_only, only the event counts are used, so the output does
+     not depend on timing */
+  static void Report (FILE *fp, ActInstTable *I, int top,
+		      int events_only = 0);
+  static void Folded (FILE *fp, ActInstTable *I, int events_only = 0);
+
+private:
+  static int _on;
+  static int _cur_set;		// in the middle of an event
+  static ActSimObj *_cur;	// object being charged
+  static unsigned long _t;	// start of the current interval
+  static struct actsim_prof_cnt _other; // work not charged to an object
+
+  /* for converting ticks to seconds */
+  static unsigned long _cal_ticks;
+  static double _cal_sec;
+
+  static inline void _charge (unsigned long t);
+  static double _tickTime ();
+};
+
+/*
+ * Event bookkeeping. All events scheduled by simulation objects are
+ * created and cancelled through these functions so that we can keep
+ * track of event traffic in the inner simulation loop.
+ *
+ * Only events made by mk() are counted. Wake-ups scheduled by the
+ * library's wait objects (and re-created by mkWakeup()) are not.
+ */
+class ActSimEvents {
+public:
+  static inline Event *mk (SimDES *s, int type, int delay,
+			   void *cause = NULL) {
+    _scheduled++;
+    _live++;
+    if (_live > _peak) {
+      _peak = _live;
+    }
+    return new Event (s, type, delay, cause);
+  }
+
+  /* a wake-up of the kind normally scheduled by a wait object */
+  static inline Event *mkWakeup (SimDES *s, int type, int delay,
+				 void *cause = NULL) {
+    return new Event (s, type, delay, cause);
+  }
+
+  /* every pending event has been removed from the queue */
+  static inline void discardAll () { _live = 0; }
+
+  static inline void cancel (Event *ev) {
+    _cancelled++;
+    _live--;
+    if (ActSimProfile::on ()) {
+      ActSimProfile::cancelled (ev);
+    }
+    ev->Remove ();
+  }
+
+  /* <o> is the object charged by the profiler */
+  static inline void fire (ActSimObj *o = NULL) {
+    _executed++;
+    _live--;
+    if (ActSimProfile::on ()) {
+      ActSimProfile::enter (o);
+    }
+  }
+
+  static inline void recycle () { _recycled++; }
+  static inline void coalesce () { _coalesced++; }
+  static unsigned long numExecuted () { return _executed; }
+
+  static void Print (FILE *fp);
+  static void Clear ();
+
+private:
+  static unsigned long _scheduled; // # of events scheduled
+  static unsigned long _cancelled; // # of events removed before firing
+  static unsigned long _executed;  // # of events that fired
+  static unsigned long _recycled;  // # of pooled objects re-used
+  static unsigned long _coalesced; // # of CHP statements run without
+				   // an event
+  static long _live, _peak;	   // current/peak # of events in the queue
 };
 
-class ActSimObj;
 
 struct ActInstTable {
   struct Hashtable *H;	// sub-instances (optional)
@@ -187,6 +400,9 @@ public:
   void sRemove() { _shared->DelObject (this); }
   int  sWaiting() { return _shared->isWaiting (this); }
 
+  ActSimObj *profObj () { return this; }
+  struct actsim_prof_cnt *getProf () { return &_prof; }
+
   virtual void sPrintCause (char *buf, int sz) {
     // by default, the instance causes the change!
     if (getName()) {
@@ -210,8 +426,50 @@ protected:
   int *_abs_port_int;
 
   WaitForOne *_shared;
+
+  struct actsim_prof_cnt _prof;	/* profile counters */
 };
 
+
+inline void ActSimProfile::_charge (unsigned long t)
+{
+  if (_cur) {
+    _cur->getProf()->ticks += t - _t;
+  }
+  else {
+    _other.ticks += t - _t;
+  }
+}
+
+inline void ActSimProfile::enter (ActSimObj *o)
+{
+  unsigned long t = now ();
+  if (_cur_set) {
+    _charge (t);
+  }
+  _cur_set = 1;
+  _cur = o;
+  _t = t;
+  if (o) {
+    o->getProf()->events++;
+  }
+  else {
+    _other.events++;
+  }
+}
+
+inline void ActSimProfile::cancelled (Event *ev)
+{
+  ActSimDES *s = dynamic_cast<ActSimDES *> (ev->getObj());
+  ActSimObj *o = s ? s->profObj () : NULL;
+  if (o) {
+    o->getProf()->cancelled++;
+  }
+  else {
+    _other.cancelled++;
+  }
+}
+
 class ActSimState;
 
 class ActExclConstraint {
@@ -317,6 +575,9 @@ public:
 
 class ChpSimGraph;
 class ChpSim;
+class ChpSimRunQueue;
+class ActSimTraceWriter;
+class ActNativeTraceWriter;
 class PrsSim;
 class XyceSim;
 
@@ -341,8 +602,13 @@ class ActSimCore {
   ActSimState *getState () { return state; }
   void setState (ActSimState *);
 
-  BigInt *getInt (int x) { return state->getInt (x); }
+  BigInt getInt (int x) { return state->getInt (x); }
+  const BigInt &getWideInt (int x) { return state->getWideInt (x); }
   void setInt (int x, BigInt &v) { state->setInt (x, v); }
+  void setInt (int x, unsigned long v, int w) { state->setInt (x, v, w); }
+  int getIntWidth (int x) { return state->getIntWidth (x); }
+  unsigned long getIntVal (int x) { return state->getIntVal (x); }
+  int isWideInt (int x) { return state->isWideInt (x); }
   int getBool (int x) { return state->getBool (x); }
   bool setBool (int x, int v) { return state->setBool (x, v); }
   int isSpecialBool (int x)  { return state->isSpecialBool (x); }
@@ -390,10 +656,25 @@ class ActSimCore {
   void gWakeup () { state->gWakeup(); }
 #endif
 
-  void incFanout (int off, int type, SimDES *who);
-  int numFanout (int off, int type) { if (type == 0) return nfo[off]; else return nfo[off+nint_start];
-}
-  SimDES **getFO (int off, int type) { if (type == 0) { return fo[off]; } else { return fo[off+nint_start]; } }
+  void incFanout (int off, int type, ActSimDES *who);
+
+  /*
+    Fanout is collected per variable using incFanout(), and then
+    packed into a single CSR table by packFanout() once the design
+    (including any Xyce interface) is complete. Until then the
+    per-variable arrays are used directly.
+  */
+  void packFanout () { if (!fo_idx) { _packFanout (); } }
+  int numFanout (int off, int type) {
+    if (type != 0) { off += nint_start; }
+    if (!fo_idx) { return nfo[off]; }
+    return fo_idx[off+1] - fo_idx[off];
+  }
+  ActSimDES **getFO (int off, int type) {
+    if (type != 0) { off += nint_start; }
+    if (!fo_idx) { return fo[off]; }
+    return fo_csr + fo_idx[off];
+  }
     
   void logFilter (const char *s);
   int isFiltered (const char *s);
@@ -406,6 +687,7 @@ class ActSimCore {
     if (flag) _sim_rand_when = 1; else _sim_rand_when = 0;
   }
   void setRandomSeed (unsigned seed) { _seed = seed; }
+  unsigned getRandomSeed () { return _seed; }
   void setRandomChoice (int v) { _sim_rand_excl = v; }
   int isRandomChoice() { return _sim_rand_excl; }
   int isResetMode() { return _prs_sim_mode; }
@@ -459,6 +741,10 @@ class ActSimCore {
   }
 
   int infLoopOpt() { return _inf_loop_opt; }
+  int prsCompiledEval() { return _prs_compiled_eval; }
+  int chpExprMode() { return _chp_expr_mode; }
+  ChpSimRunQueue *chpRunQueue() { return _chp_rq; }
+  int chpCoalesce() { return _chp_coalesce; }
 
   void computeFanout (ActInstTable *inst);
 
@@ -466,15 +752,31 @@ class ActSimCore {
     char *s;
     unsigned int ignore_fmt;
     void *node[TRACE_NUM_FORMATS];
+    int nid;			// signal id in the trace_all file, or -1
+    unsigned char quiet;	// only present for trace_all: don't print
   };
 
+  /*
+    A variable is "observed" if it has a watchpoint or a breakpoint
+    on it. This is kept as one bit per variable so the common case
+    (nothing observed) is a single bit test.
+  */
+  inline bool isObserved (int type, unsigned long off) {
+    if (type == 3) { type = 2; }
+    return bitset_tst (_obs[type], off) ? true : false;
+  }
+
   inline void addWatchPt (int type, unsigned long off, const char *name) {
     ihash_bucket_t *b;
     watchpt_bucket *w;
+    int nid = -1;
     if (type == 3) { type = 2; }
+    bitset_set (_obs[type], off);
     b = ihash_lookup (_W, ((unsigned long)type) | (off << 2));
     if (b) {
       w = (watchpt_bucket *) b->v;
+      flushTrace ();
+      nid = w->nid;
       FREE (w->s);
       FREE (w);
     }
@@ -488,12 +790,17 @@ class ActSimCore {
     for (int i=0; i < TRACE_NUM_FORMATS; i++) {
       w->node[i] = NULL;
     }
+    w->nid = nid;
+    w->quiet = 0;
   }
 
   inline const watchpt_bucket *chkWatchPt (int type, unsigned long off) {
     ihash_bucket_t *b;
     watchpt_bucket *w;
     if (type == 3) { type = 2; }
+    if (!bitset_tst (_obs[type], off)) {
+      return nullptr;
+    }
     b = ihash_lookup (_W, ((unsigned long)type) | (off << 2));
     if (b) {
       w = (watchpt_bucket *) b->v;
@@ -511,15 +818,27 @@ class ActSimCore {
     b = ihash_lookup (_W, ((unsigned long)type) | (off << 2));
     if (b) {
       w = (watchpt_bucket *) b->v;
+      if (w->nid >= 0 && _ntr) {
+	/* still part of trace_all; just stop displaying it */
+	w->quiet = 1;
+	return;
+      }
+      flushTrace ();
       ihash_delete (_W, ((unsigned long)type) | (off << 2));
       FREE (w->s);
       FREE (w);
+      if (!ihash_lookup (_B, ((unsigned long)type) | (off << 2))) {
+	bitset_clr (_obs[type], off);
+      }
     }
   }
 
   inline const char *chkBreakPt (int type, unsigned long off) {
     ihash_bucket_t *b;
     if (type == 3) { type = 2; }
+    if (!bitset_tst (_obs[type], off)) {
+      return nullptr;
+    }
     b = ihash_lookup (_B, ((unsigned long)type) | (off << 2));
     if (b) {
       return (char *)b->v;
@@ -536,10 +855,14 @@ class ActSimCore {
     if (b) {
       FREE (b->v);
       ihash_delete (_B, ((unsigned long)type) | (off << 2));
+      if (!ihash_lookup (_W, ((unsigned long)type) | (off << 2))) {
+	bitset_clr (_obs[type], off);
+      }
     }
     else {
       b = ihash_add (_B, ((unsigned long)type) | (off << 2));
       b->v = Strdup (name);
+      bitset_set (_obs[type], off);
     }
   }
 
@@ -547,6 +870,24 @@ class ActSimCore {
   act_trace_t *getTrace (int fmt) { return _tr[fmt]; }
   void recordTrace (const watchpt_bucket *w, int type,
 		    act_chan_state_t chan_state, const BigInt &val);
+  void writeTraceRec (const struct actsim_trace_rec *r);
+
+  /* wait for the background trace writer, if any, to catch up */
+  void flushTrace ();
+  void printTraceStats (FILE *fp, int verbose = 0);
+
+  /* in a forked child: forget the parent's trace files and writer */
+  void detachTraces ();
+
+  /*-- trace_all: every selected signal into one native trace file --*/
+  int openTraceAll (const char *file); // 0 on failure
+  int addTraceAll (int type, unsigned long off, const char *name);
+  void beginTraceAll ();
+  void closeTraceAll ();
+  int isTraceAll () { return _ntr ? 1 : 0; }
+  void printTraceAllStats (FILE *fp);
+  void recordNativeTrace (const watchpt_bucket *w, int type,
+			  act_chan_state_t chan_state, const BigInt &val);
 
   void setTimescale (float tm) { _int_to_float_timescale = tm*1e-12; }
   float getTimescale() { return _int_to_float_timescale; }
@@ -658,9 +999,17 @@ protected:
   int *nfo;			// nbools + nint length (=nfo_len), contains
 				// fanout count for each variable
   
-  SimDES ***fo;			// fanout destinations
+  ActSimDES ***fo;		// fanout destinations
   struct iHashtable *hfo;	// for high fanout nets
 
+  int *fo_idx;			// packed fanout: destinations for
+				// variable i are fo_csr[fo_idx[i]] to
+				// fo_csr[fo_idx[i+1]-1]
+  ActSimDES **fo_csr;		// packed fanout destinations
+
+  void _packFanout ();		// nfo/fo -> fo_idx/fo_csr
+  void _unpackFanout ();	// fo_idx/fo_csr -> nfo/fo
+
   struct iHashtable *map;	/* map from process pointer to
 				   process_info */
 
@@ -705,10 +1054,25 @@ protected:
 
   struct iHashtable *_W;		/* watchpoints */
   struct iHashtable *_B;		/* breakpoints */
+  bitset_t *_obs[3];		/* observed bool/int/chan variables:
+				   has a watch or a breakpoint */
 
   act_extern_trace_func_t *_trfn[TRACE_NUM_FORMATS];
   act_trace_t *_tr[TRACE_NUM_FORMATS];
   static char *_trname[TRACE_NUM_FORMATS];
+  ActSimTraceWriter *_trw;	/* background trace writer, if any */
+  ActNativeTraceWriter *_ntr;	/* trace_all output, if any */
+
+  /*-- scratch space for recordTrace --*/
+  unsigned long *_tr_tm;	/* current time, _tr_tmlen words */
+  int _tr_tmsz, _tr_tmlen;
+  unsigned long _tr_tmlo;	/* low word of the time in _tr_tm */
+  int _tr_tmvalid;
+  float _tr_ftm;		/* current time in metric units */
+  unsigned long *_tr_val;	/* wide values, _tr_valsz words */
+  int _tr_valsz;
+  void _traceTime ();
+  unsigned long *_traceVal (int n);
   float _int_to_float_timescale; // units to convert integer units
 				 // to time
   /*-- timing forks --*/
@@ -763,6 +1127,18 @@ protected:
 
   unsigned int _inf_loop_opt:1;	/* turn on infinite loop optimization */
 
+  unsigned int _prs_compiled_eval:1; /* 1 = use compiled prs rules, 0 =
+					walk the expression tree */
+
+  unsigned int _chp_expr_mode:2; /* 0 = walk CHP expression trees, 1 =
+				    compiled, 2 = compiled and checked
+				    against the tree walk */
+
+  ChpSimRunQueue *_chp_rq;	/* CHP run queue, NULL if not used */
+  int _n_non_chp;		/* # of prs/xyce simulation objects */
+  int _chp_coalesce;		/* max # of zero-delay CHP statements
+				   run inline after a step */
+
   unsigned int _rand_min, _rand_max;
   
   unsigned _seed;		 /* random seed, if used */
@@ -805,8 +1181,16 @@ public:
 
    
 
+  /*
+   * Binary checkpoint of the simulation. restoreSim() must be used
+   * with the same design; it returns 1 on success, 0 if the
+   * checkpoint does not match the current simulation or was taken
+   * at an earlier time than the current one. The simulation time is
+   * advanced to the checkpoint time, so pending events fire at the
+   * same times as they would have in the original run.
+   */
   void saveSim (FILE *);
-  void restoreSim (FILE *);
+  int restoreSim (FILE *);
 
   ActInstTable *getInstTable () { return &I; }
 
@@ -815,6 +1199,57 @@ private:
   list_t *_init_simobjs;
 };
 
+
+/*
+ * Levelized settling of the production rule network, used to speed up
+ * the reset phase. Compiled, fixed-delay production rules without weak
+ * pulls are ordered by level (gates in combinational cycles are placed
+ * last), and Run() evaluates them directly on a copy of the Boolean
+ * state until nothing changes. Pending events for these gates are
+ * discarded; the changed Booleans are then written back and their
+ * fanout is notified, so the event-driven engine picks up from the
+ * settled state.
+ */
+class ActSimSettle {
+public:
+  ActSimSettle (ActSim *sim);
+  ~ActSimSettle ();
+
+  int numGates() { return _ngates; }
+  int numLevels() { return _nlevels; }
+  int numCyclic() { return _ngates - _acyclic; }
+
+  /* settle for at most max_passes passes; returns # of changed Booleans */
+  int Run (int max_passes);
+
+private:
+  ActSim *_sim;
+
+  int _ngates;			// # of gates handled
+  OnePrsSim **_gate;		// gates in level order
+  int *_out;			// output of each gate (global offset)
+  int *_drv;			// Boolean -> index of its gate, or -1
+  int _acyclic;			// gates [0.._acyclic-1] are not in cycles
+  int _nlevels;
+
+  int _nwords;			// # of words in each Boolean plane
+  unsigned long *_v, *_x;	// working copy of the Boolean state
+  unsigned long *_v0, *_x0;	// Boolean state before settling
+
+  A_DECL (PrsSim *, _objs);
+
+  void _collect (ActInstTable *t);
+  int _eval (const int *code);
+  int _get (int off) {
+    unsigned long m = ACT_BOOL_MASK (off);
+    if (_x[ACT_BOOL_WORD (off)] & m) {
+      return 2;
+    }
+    return (_v[ACT_BOOL_WORD (off)] & m) ? 1 : 0;
+  }
+  void _set (int off, int v);
+};
+
 void sim_recordChannel (ActSimCore *sc, ActSimObj *c, ActId *id);
 void actsim_close_log (void);
 void actsim_set_log (FILE *fp);
@@ -830,4 +1265,17 @@ int is_rand_excl ();
 bool _match_hseprs (Event *);
 void runPending (bool verbose);
 
+/* checkpoint I/O (fixed-width, little-endian); reads abort on a
+   truncated file */
+void actsim_write (FILE *fp, const void *buf, size_t sz);
+void actsim_read (FILE *fp, void *buf, size_t sz);
+void actsim_write_u32 (FILE *fp, unsigned int v);
+void actsim_write_u64 (FILE *fp, unsigned long v);
+unsigned int actsim_read_u32 (FILE *fp);
+unsigned long actsim_read_u64 (FILE *fp);
+void actsim_write_bigint (FILE *fp, BigInt &v);
+void actsim_read_bigint (FILE *fp, BigInt &v);
+void actsim_write_multires (FILE *fp, expr_multires &v);
+void actsim_read_multires (FILE *fp, expr_multires &v);
+
 #endif /* __ACT_SIM_H__ */
@@ -33,4 +33,47 @@ typedef struct expr_res {
 
 #define ACT_EXPR_RES_PRINTF "l"
 
+/*
+ * Extended external function interface.
+ *
+ * If the shared library provides
+ *
+ *    int <name>_batch (int ncalls, int nargs, expr_arg *args, expr_arg *ret)
+ *
+ * it is used instead of the single-value function <name>. Arguments
+ * and return values are passed as lists of values of any width, so
+ * wide integers, arrays, and structures are supported. Arrays and
+ * structures are flattened in the same order as the simulator's
+ * internal representation (structure fields in declaration order,
+ * arrays in row-major order).
+ *
+ * args has ncalls*nargs entries; the arguments for call i start at
+ * args[i*nargs]. ret has ncalls entries, shaped by the caller to
+ * match the return type (widths set, value words allocated); the
+ * callee fills in the values. Structure return types give multiple
+ * return values. A non-zero result is treated as a fatal error.
+ *
+ * actsim passes ncalls > 1 when one expression calls the same function
+ * several times and has no other function calls (e.g. f(a) + f(b));
+ * the calls are in evaluation order.
+ *
+ * All storage belongs to the caller and is only valid for the
+ * duration of the call.
+ */
+typedef struct expr_val {
+  int width;			/* bitwidth */
+  int len;			/* # of 64-bit words in v */
+  unsigned long *v;		/* value, least significant word first */
+} expr_val;
+
+typedef struct expr_arg {
+  int n;			/* # of values (1 for int/bool) */
+  expr_val *val;
+} expr_arg;
+
+typedef int (*EXTFUNC_BATCH) (int ncalls, int nargs,
+			      expr_arg *args, expr_arg *ret);
+
+#define ACT_EXT_BATCH_SUFFIX "_batch"
+
 #endif /* __ACTSIM__EXT_H__ */
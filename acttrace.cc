@@ -0,0 +1,231 @@
+/*************************************************************************
+ *
+ *  Copyright (c) 2024 Rajit Manohar
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA  02110-1301, USA.
+ *
+ **************************************************************************
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <act/tracelib.h>
+#include "nattrace.h"
+
+/*
+ * Offline tool for actsim native trace files (see trace_all):
+ * conversion to VCD, and indexed queries.
+ */
+
+static void usage (char *s)
+{
+  fprintf (stderr, "Usage: %s <cmd> <trace> ...\n", s);
+  fprintf (stderr, "  vcd <trace> <vcdfile>         : convert to VCD\n");
+  fprintf (stderr, "  info <trace>                  : list signals and sections\n");
+  fprintf (stderr, "  value <trace> <name> <t>      : value of <name> at time <t>\n");
+  fprintf (stderr, "  changes <trace> <name> <t0> <t1> : changes of <name> in [t0,t1]\n");
+  exit (1);
+}
+
+/* VCD identifier code for signal i */
+static void vcd_id (int i, char *buf)
+{
+  int n = 0;
+  do {
+    buf[n++] = 33 + (i % 94);
+    i /= 94;
+  } while (i > 0);
+  buf[n] = '\0';
+}
+
+/*
+ * Pick a VCD timescale for <ts> seconds per time unit. Returns the
+ * multiplier needed for the time values when there is no exact match.
+ */
+static unsigned long vcd_timescale (FILE *fp, double ts)
+{
+  static const char *units[] = { "s", "ms", "us", "ns", "ps", "fs" };
+  double u = 1.0;
+
+  for (int i=0; i < 6; i++) {
+    for (int m=1; m <= 100; m *= 10) {
+      double r = ts/(u*m);
+      if (fabs (r - 1.0) < 1e-6) {
+	fprintf (fp, "$timescale %d %s $end\n", m, units[i]);
+	return 1;
+      }
+    }
+    u *= 1e-3;
+  }
+  fprintf (fp, "$timescale 1 fs $end\n");
+  u = floor (ts/1e-15 + 0.5);
+  return u < 1 ? 1 : (unsigned long) u;
+}
+
+static void vcd_bits (FILE *fp, int width, int nw, unsigned long *v)
+{
+  int i, started = 0;
+
+  fputc ('b', fp);
+  for (i = width-1; i >= 0; i--) {
+    int b = 0;
+    if (i/64 < nw) {
+      b = (v[i/64] >> (i % 64)) & 1;
+    }
+    if (b || started || i == 0) {
+      fputc (b ? '1' : '0', fp);
+      started = 1;
+    }
+  }
+}
+
+static int convert_vcd (const char *in, const char *out)
+{
+  ActNativeTraceReader rd;
+  struct nattrace_change c;
+  char id[8];
+  unsigned long mult;
+  unsigned long tcur;
+  int first;
+  FILE *fp;
+
+  if (!rd.open (in)) {
+    fprintf (stderr, "Could not read trace file `%s'\n", in);
+    return 1;
+  }
+  fp = fopen (out, "w");
+  if (!fp) {
+    fprintf (stderr, "Could not open `%s' for writing\n", out);
+    return 1;
+  }
+
+  fprintf (fp, "$comment\n   converted from actsim trace `%s'\n$end\n", in);
+  mult = vcd_timescale (fp, rd.getTimescale ());
+  fprintf (fp, "$scope module top $end\n");
+  for (int i=0; i < rd.numSignals(); i++) {
+    vcd_id (i, id);
+    fprintf (fp, "$var %s %d %s %s $end\n",
+	     rd.sigType (i) == NATTRACE_BOOL ? "wire" : "reg",
+	     rd.sigWidth (i) > 0 ? rd.sigWidth (i) : 1, id, rd.sigName (i));
+  }
+  fprintf (fp, "$upscope $end\n");
+  fprintf (fp, "$enddefinitions $end\n");
+
+  first = 1;
+  tcur = 0;
+  while (rd.next (&c)) {
+    if (first || c.tm != tcur) {
+      fprintf (fp, "#%lu\n", c.tm*mult);
+      tcur = c.tm;
+      first = 0;
+    }
+    vcd_id (c.id, id);
+    switch (rd.sigType (c.id)) {
+    case NATTRACE_BOOL:
+      fprintf (fp, "%c%s\n", c.v[0] == 0 ? '0' : (c.v[0] == 1 ? '1' : 'x'),
+	       id);
+      break;
+
+    case NATTRACE_INT:
+      vcd_bits (fp, rd.sigWidth (c.id), c.nw, c.v);
+      fprintf (fp, " %s\n", id);
+      break;
+
+    case NATTRACE_CHAN:
+      /* only a channel carrying a value has one */
+      if (c.state == ACT_CHAN_VALUE) {
+	vcd_bits (fp, rd.sigWidth (c.id), c.nw, c.v);
+      }
+      else {
+	fprintf (fp, "bz");
+      }
+      fprintf (fp, " %s\n", id);
+      break;
+    }
+  }
+  fclose (fp);
+  rd.close ();
+  return 0;
+}
+
+static int trace_info (const char *in)
+{
+  ActNativeTraceReader rd;
+  static const char *types[] = { "bool", "int", "chan" };
+
+  if (!rd.open (in)) {
+    fprintf (stderr, "Could not read trace file `%s'\n", in);
+    return 1;
+  }
+  printf ("Timescale : %g s\n", rd.getTimescale ());
+  printf ("Sections  : %d (%s)\n", rd.numSections (),
+	  rd.hasIndex () ? "indexed" : "no index");
+  printf ("Signals   : %d\n", rd.numSignals ());
+  for (int i=0; i < rd.numSignals(); i++) {
+    printf ("  %s %s<%d>\n", rd.sigName (i),
+	    (rd.sigType (i) >= 0 && rd.sigType (i) <= 2) ?
+	    types[rd.sigType (i)] : "?", rd.sigWidth (i));
+  }
+  return 0;
+}
+
+/* value at a time, or changes in a time range */
+static int trace_query (const char *in, const char *name,
+			const char *t0s, const char *t1s)
+{
+  unsigned long t0, t1;
+
+  t0 = strtoul (t0s, NULL, 0);
+  t1 = t1s ? strtoul (t1s, NULL, 0) : 0;
+  if (nattrace_query (stdout, in, name, t0, t1, t1s != NULL) < 0) {
+    return 1;
+  }
+  return 0;
+}
+
+int main (int argc, char **argv)
+{
+  if (argc < 3) {
+    usage (argv[0]);
+  }
+  if (strcmp (argv[1], "vcd") == 0) {
+    if (argc != 4) {
+      usage (argv[0]);
+    }
+    return convert_vcd (argv[2], argv[3]);
+  }
+  else if (strcmp (argv[1], "info") == 0) {
+    if (argc != 3) {
+      usage (argv[0]);
+    }
+    return trace_info (argv[2]);
+  }
+  else if (strcmp (argv[1], "value") == 0) {
+    if (argc != 5) {
+      usage (argv[0]);
+    }
+    return trace_query (argv[2], argv[3], argv[4], NULL);
+  }
+  else if (strcmp (argv[1], "changes") == 0) {
+    if (argc != 6) {
+      usage (argv[0]);
+    }
+    return trace_query (argv[2], argv[3], argv[4], argv[5]);
+  }
+  usage (argv[0]);
+  return 1;
+}
@@ -488,9 +488,11 @@ int ChanMethods::runMethod (ActSimCore *sim,
 	  const ActSim::watchpt_bucket *nm;
 	  if ((nm = sim->chkWatchPt (0, b->i))) {
 	    BigInt tmpv;
-	    ch->_dummy->msgPrefix ();
-	    printf (" %s := %c\n", nm->s, _ops[idx].op[from].type == CHAN_OP_BOOL_T ?
-		    '1' : '0');
+	    if (!nm->quiet) {
+	      ch->_dummy->msgPrefix ();
+	      printf (" %s := %c\n", nm->s, _ops[idx].op[from].type == CHAN_OP_BOOL_T ?
+		      '1' : '0');
+	    }
 	    tmpv = (_ops[idx].op[from].type == CHAN_OP_BOOL_T ? 1 : 0);
 	    sim->recordTrace (nm, 0, ACT_CHAN_IDLE, tmpv);
 	  }
@@ -1248,6 +1248,7 @@ static chpsimstmt *gc_to_chpsim (act_chp_gc_t *gc, ActSimCore *s, const int anno
     }
     tmp->next = NULL;
     tmp->g = expr_to_chp_expr (gc->g, s, &flags);
+    tmp->code = ChpSimGraph::compileExpr (s, tmp->g);
     gc = gc->next;
   }
 
@@ -1358,6 +1359,7 @@ chpsimgraph_info *ChpSimGraph::buildChpSimGraph (ActSimCore *sc,
 	  }
 	  tmp->next = NULL;
 	  tmp->g = expr_to_chp_expr (e, sc, &flags);
+	  tmp->code = ChpSimGraph::compileExpr (sc, tmp->g);
 
 	  // then label
 	  li = list_next (li);
@@ -1499,6 +1501,63 @@ static void _get_costs (stateinfo_t *si, ActId *id, chpsimstmt *stmt)
 }
 
 
+/*
+ * Returns 1 if e only reads local (non-port) variables without any
+ * probes or function calls, so that evaluating it earlier or later in
+ * the same time step cannot be observed by another process. Local
+ * variables can still have fanout to other processes; that depends
+ * on the instance and is checked by ChpSim::_coalesce_ok().
+ */
+static int _local_expr (Expr *e)
+{
+  if (!e) {
+    return 1;
+  }
+  switch (e->type) {
+  case E_TRUE:
+  case E_FALSE:
+  case E_INT:
+    return 1;
+
+  case E_CHP_VARBOOL:
+  case E_CHP_VARINT:
+    return e->u.x.val >= 0 ? 1 : 0;
+
+  case E_AND:
+  case E_OR:
+  case E_PLUS:
+  case E_MINUS:
+  case E_MULT:
+  case E_DIV:
+  case E_MOD:
+  case E_LSL:
+  case E_LSR:
+  case E_ASR:
+  case E_XOR:
+  case E_LT:
+  case E_GT:
+  case E_LE:
+  case E_GE:
+  case E_EQ:
+  case E_NE:
+    return _local_expr (e->u.e.l) && _local_expr (e->u.e.r);
+
+  case E_NOT:
+  case E_COMPLEMENT:
+  case E_UMINUS:
+  case E_BUILTIN_BOOL:
+    return _local_expr (e->u.e.l);
+
+  case E_QUERY:
+    return _local_expr (e->u.e.l) && _local_expr (e->u.e.r->u.e.l) &&
+      _local_expr (e->u.e.r->u.e.r);
+
+  default:
+    return 0;
+  }
+}
+
+
 ChpSimGraph *ChpSimGraph::_buildChpSimGraph (ActSimCore *sc,
 					    act_chp_lang_t *c,
 					    ChpSimGraph **stop, const int annotate_mode, int &dda_pos, int &dea_pos)
@@ -1717,12 +1776,15 @@ ChpSimGraph *ChpSimGraph::_buildChpSimGraph (ActSimCore *sc,
 	ret->stmt->u.sendrecv.width = TypeFactory::totBitWidth (ch);
       }
       ret->stmt->u.sendrecv.e = NULL;
+      ret->stmt->u.sendrecv.code = NULL;
       ret->stmt->u.sendrecv.d = NULL;
       ret->stmt->u.sendrecv.is_structx = 0;
 
       if (c->u.comm.e) {
 	int flags = 0;
 	ret->stmt->u.sendrecv.e = expr_to_chp_expr (c->u.comm.e, sc, &flags);
+	ret->stmt->u.sendrecv.code =
+	  ChpSimGraph::compileExpr (sc, ret->stmt->u.sendrecv.e);
       }
       if (c->u.comm.var) {
 	ActId *id = c->u.comm.var;
@@ -1820,12 +1882,15 @@ ChpSimGraph *ChpSimGraph::_buildChpSimGraph (ActSimCore *sc,
       }
 
       ret->stmt->u.sendrecv.e = NULL;
+      ret->stmt->u.sendrecv.code = NULL;
       ret->stmt->u.sendrecv.d = NULL;
       ret->stmt->u.sendrecv.is_structx = 0;
 
       if (c->u.comm.e) {
 	int flags = 0;
 	ret->stmt->u.sendrecv.e = expr_to_chp_expr (c->u.comm.e, sc, &flags);
+	ret->stmt->u.sendrecv.code =
+	  ChpSimGraph::compileExpr (sc, ret->stmt->u.sendrecv.e);
 	Assert (ch->acktype(), "Bidirectional channel inconsistency");
 	if (TypeFactory::isStructure (ch->acktype())) {
 	  ret->stmt->u.sendrecv.is_structx = 2;
@@ -1998,6 +2063,11 @@ ChpSimGraph *ChpSimGraph::_buildChpSimGraph (ActSimCore *sc,
 	ret->stmt->u.assign.is_struct = 0;
       }
       ret->stmt->u.assign.e = expr_to_chp_expr (c->u.assign.e, sc, &flags);
+      ret->stmt->u.assign.code = NULL;
+      if (!ret->stmt->u.assign.is_struct) {
+	ret->stmt->u.assign.code =
+	  ChpSimGraph::compileExpr (sc, ret->stmt->u.assign.e);
+      }
 
       if (ret->stmt->u.assign.is_struct) {
 	if (ActBooleanizePass::isDynamicRef (sc->cursi()->bnl, c->u.assign.id))  {
@@ -2053,6 +2123,13 @@ ChpSimGraph *ChpSimGraph::_buildChpSimGraph (ActSimCore *sc,
 	  ret->stmt->u.assign.d.isbool = 1;
 	}
       }
+      ret->stmt->u.assign.is_local = 0;
+      if (!ret->stmt->u.assign.is_struct &&
+	  !ret->stmt->u.assign.d.range &&
+	  ret->stmt->u.assign.d.offset >= 0 &&
+	  _local_expr (ret->stmt->u.assign.e)) {
+	ret->stmt->u.assign.is_local = 1;
+      }
     }
     (*stop) = ret;
     break;
@@ -2293,10 +2370,12 @@ ChpSimGraph::~ChpSimGraph ()
 	int nguards = 1;
 	int nw;
 	_free_chp_expr (stmt->u.cond.c.g);
+	freeExpr (stmt->u.cond.c.code);
 	x = stmt->u.cond.c.next;
 	while (x) {
 	  struct chpsimcond *t;
 	  _free_chp_expr (x->g);
+	  freeExpr (x->code);
 	  t = x->next;
 	  FREE (x);
 	  x = t;
@@ -2332,6 +2411,7 @@ ChpSimGraph::~ChpSimGraph ()
     case CHPSIM_ASSIGN:
       _free_deref (&stmt->u.assign.d);
       _free_chp_expr (stmt->u.assign.e);
+      freeExpr (stmt->u.assign.code);
       break;
 
     case CHPSIM_NOP:
@@ -2342,6 +2422,7 @@ ChpSimGraph::~ChpSimGraph ()
       if (stmt->u.sendrecv.e) {
 	_free_chp_expr (stmt->u.sendrecv.e);
       }
+      freeExpr (stmt->u.sendrecv.code);
       if (stmt->u.sendrecv.d) {
 	_free_deref (stmt->u.sendrecv.d);
       }
@@ -2382,3 +2463,240 @@ chpsimgraph_info::~chpsimgraph_info()
 {
   if (g) { delete g; }
 }
+
+
+/*------------------------------------------------------------------------
+ * Compiled CHP expressions
+ *------------------------------------------------------------------------
+ */
+static int _ewidth (ActSimCore *sc, Expr *e)
+{
+  phash_bucket_t *b = sc->exprWidth (e);
+  return b ? b->i : -1;
+}
+
+static int _const_width (unsigned long x)
+{
+  int width = 0;
+  while (x) {
+    x = x >> 1;
+    width++;
+  }
+  return width == 0 ? 1 : width;
+}
+
+/*
+ * Emit code for e into c->op[pos...] (if c->op is not NULL), returning
+ * the next position. *depth is the current stack depth, and *maxd is
+ * updated with the maximum depth seen.
+ */
+static int _emit_expr (ActSimCore *sc, Expr *e, struct chpsim_ecode *c,
+		       int pos, int *depth, int *maxd)
+{
+  struct chpsim_eop *op;
+  int jz, jmp;
+
+#define EMIT(t)					\
+  do {						\
+    op = c->op ? &c->op[pos] : NULL;		\
+    if (op) {					\
+      op->type = (t);				\
+      op->w = -1;				\
+      op->x = 0;				\
+      op->v = 0;				\
+      op->e = e;				\
+    }						\
+    pos++;					\
+  } while (0)
+#define PUSH					\
+  do {						\
+    (*depth)++;					\
+    if (*depth > *maxd) { *maxd = *depth; }	\
+  } while (0)
+
+  switch (e->type) {
+  case E_TRUE:
+  case E_FALSE:
+    EMIT (CHPSIM_EOP_CONST);
+    if (op) {
+      op->w = 1;
+      op->v = (e->type == E_TRUE ? 1 : 0);
+    }
+    PUSH;
+    break;
+
+  case E_INT:
+    if (e->u.ival.v_extra) {
+      EMIT (CHPSIM_EOP_BIGCONST);
+    }
+    else {
+      EMIT (CHPSIM_EOP_CONST);
+      if (op) {
+	op->v = e->u.ival.v;
+	op->w = _const_width (e->u.ival.v);
+      }
+    }
+    PUSH;
+    break;
+
+  case E_CHP_VARBOOL:
+    EMIT (CHPSIM_EOP_VARBOOL);
+    if (op) {
+      op->x = e->u.x.val;
+      op->w = 1;
+    }
+    PUSH;
+    break;
+
+  case E_CHP_VARINT:
+    EMIT (CHPSIM_EOP_VARINT);
+    if (op) {
+      op->x = e->u.x.val;
+      op->w = e->u.x.extra;
+    }
+    PUSH;
+    break;
+
+  case E_AND:
+  case E_OR:
+  case E_PLUS:
+  case E_MINUS:
+  case E_MULT:
+  case E_DIV:
+  case E_MOD:
+  case E_LSL:
+  case E_LSR:
+  case E_ASR:
+  case E_XOR:
+  case E_LT:
+  case E_GT:
+  case E_LE:
+  case E_GE:
+  case E_EQ:
+  case E_NE:
+    pos = _emit_expr (sc, e->u.e.l, c, pos, depth, maxd);
+    pos = _emit_expr (sc, e->u.e.r, c, pos, depth, maxd);
+    EMIT (e->type);
+    if (op && e->type == E_MINUS) {
+      op->w = _ewidth (sc, e);
+    }
+    (*depth)--;
+    break;
+
+  case E_NOT:
+  case E_COMPLEMENT:
+  case E_UMINUS:
+  case E_BUILTIN_BOOL:
+    pos = _emit_expr (sc, e->u.e.l, c, pos, depth, maxd);
+    EMIT (e->type);
+    if (op && e->type != E_BUILTIN_BOOL) {
+      op->w = _ewidth (sc, e->u.e.l);
+    }
+    break;
+
+  case E_QUERY:
+    /* cond; JZ else; then; JMP end; else: ...; end: */
+    pos = _emit_expr (sc, e->u.e.l, c, pos, depth, maxd);
+    jz = pos;
+    EMIT (CHPSIM_EOP_JZ);
+    (*depth)--;
+    pos = _emit_expr (sc, e->u.e.r->u.e.l, c, pos, depth, maxd);
+    (*depth)--;
+    jmp = pos;
+    EMIT (CHPSIM_EOP_JMP);
+    if (c->op) {
+      c->op[jz].x = pos;
+    }
+    pos = _emit_expr (sc, e->u.e.r->u.e.r, c, pos, depth, maxd);
+    if (c->op) {
+      c->op[jmp].x = pos;
+    }
+    break;
+
+  default:
+    /* everything else uses the tree evaluator */
+    EMIT (CHPSIM_EOP_TREE);
+    PUSH;
+    break;
+  }
+#undef EMIT
+#undef PUSH
+  return pos;
+}
+
+struct chpsim_ecode *ChpSimGraph::compileExpr (ActSimCore *sc, Expr *e)
+{
+  struct chpsim_ecode *c, tmp;
+  int depth, maxd;
+
+  if (!e || sc->chpExprMode() == 0) {
+    return NULL;
+  }
+
+  /* pass 1: size and stack depth */
+  tmp.op = NULL;
+  depth = 0;
+  maxd = 0;
+  tmp.n = _emit_expr (sc, e, &tmp, 0, &depth, &maxd);
+  if (tmp.n == 1 && e->type != E_CHP_VARBOOL && e->type != E_CHP_VARINT) {
+    /* nothing gained over exprEval() */
+    return NULL;
+  }
+
+  /* pass 2: emit */
+  NEW (c, struct chpsim_ecode);
+  MALLOC (c->op, struct chpsim_eop, tmp.n);
+  depth = 0;
+  maxd = 0;
+  c->n = _emit_expr (sc, e, c, 0, &depth, &maxd);
+  c->depth = maxd;
+  Assert (c->n == tmp.n && depth == 1, "compileExpr: inconsistent code");
+
+  /* the 64-bit evaluator only handles operators whose result does
+     not depend on BigInt width rules */
+  c->fast = 1;
+  for (int i=0; i < c->n && c->fast; i++) {
+    switch (c->op[i].type) {
+    case CHPSIM_EOP_CONST:
+    case CHPSIM_EOP_VARBOOL:
+    case CHPSIM_EOP_JZ:
+    case CHPSIM_EOP_JMP:
+    case E_AND:
+    case E_OR:
+    case E_XOR:
+    case E_LT:
+    case E_GT:
+    case E_LE:
+    case E_GE:
+    case E_EQ:
+    case E_NE:
+    case E_BUILTIN_BOOL:
+      break;
+
+    case CHPSIM_EOP_VARINT:
+      if (c->op[i].w > 64) {
+	c->fast = 0;
+      }
+      break;
+
+    case E_NOT:
+    case E_COMPLEMENT:
+      if (c->op[i].w != -1 && c->op[i].w != 1) {
+	c->fast = 0;
+      }
+      break;
+
+    default:
+      c->fast = 0;
+      break;
+    }
+  }
+  return c;
+}
+
+void ChpSimGraph::freeExpr (struct chpsim_ecode *c)
+{
+  if (!c) return;
+  FREE (c->op);
+  FREE (c);
+}
@@ -46,7 +46,46 @@ class ChanTraceDelayed : public SimDES {
   ChanTraceDelayed (const ActSim::watchpt_bucket *n, const BigInt &x) { _n = n; _has_val = 1; _v = x; }
   ~ChanTraceDelayed () { _n = NULL; }
 
+  /*
+   * One of these is created for every traced channel action, so
+   * recycle them through a free list.
+   */
+  static void *operator new (size_t sz) {
+    void *x;
+    Assert (sz == sizeof (ChanTraceDelayed), "What?");
+    if (_freelist) {
+      x = _freelist;
+      _freelist = *((void **)x);
+      ActSimEvents::recycle ();
+    }
+    else {
+      x = malloc (sz);
+      if (!x) {
+	fatal_error ("ChanTraceDelayed: out of memory");
+      }
+    }
+    return x;
+  }
+
+  static void operator delete (void *x) {
+    *((void **)x) = _freelist;
+    _freelist = x;
+  }
+
   int Step (Event *ev) {
+    ActSimEvents::fire ();
+    /* written directly, so anything queued must go out first */
+    glob_sim->flushTrace ();
+    if (_n->nid >= 0 && glob_sim->isTraceAll ()) {
+      if (_has_val) {
+	glob_sim->recordNativeTrace (_n, 2, ACT_CHAN_VALUE, _v);
+      }
+      else {
+	BigInt zero;
+	zero = 0;
+	glob_sim->recordNativeTrace (_n, 2, ACT_CHAN_IDLE, zero);
+      }
+    }
     BigInt xtm = SimDES::CurTime();
     float tm = glob_sim->curTimeMetricUnits ();
     int len = xtm.getLen();
@@ -125,8 +164,12 @@ class ChanTraceDelayed : public SimDES {
   const ActSim::watchpt_bucket *_n;
   unsigned int _has_val:1;
   BigInt _v;
+
+  static void *_freelist;
 };  
 
+void *ChanTraceDelayed::_freelist = NULL;
+
 //#define DUMP_ALL
 
 static int stat_count = 0;
@@ -308,6 +351,8 @@ ChpSim::ChpSim (chpsimgraph_info *cgi,
     max_cnt = 0;
     max_stats = 0;
   }
+  _g0 = g;
+  _maxcnt = 0;
 
   _deadlock_pc = NULL;
   _stalled_pc = list_new ();
@@ -318,7 +363,11 @@ ChpSim::ChpSim (chpsimgraph_info *cgi,
   _area_cost = 0;
   _statestk = NULL;
   _cureval = NULL;
+  _fnlayout = NULL;
   _frag_ch = NULL;
+  _coal_ok = NULL;
+  _ext_root = NULL;
+  _ext_pos = 0;
   _hse_mode = 0;		/* default is CHP */
   
   _maxstats = max_stats;
@@ -386,6 +435,7 @@ ChpSim::ChpSim (chpsimgraph_info *cgi,
     }
     _holes[0] = -1;
 
+    _maxcnt = max_cnt;
     if (max_cnt > 0) {
       _tot = (int *)sim->getState()->allocState (sizeof (int)*max_cnt);
       for (int i=0; i < max_cnt; i++) {
@@ -437,6 +487,7 @@ ChpSim::~ChpSim()
   if (_statestk) {
     list_free (_statestk);
   }
+  _freeFnLayouts ();
   list_free (_stalled_pc);
 
   if (_deadlock_pc) {
@@ -446,6 +497,10 @@ ChpSim::~ChpSim()
   if (_maxstats > 0) {
     FREE (_stats);
   }
+
+  if (_coal_ok) {
+    phash_free (_coal_ok);
+  }
 }
 
 int ChpSim::_nextEvent (int pc, int bw_cost)
@@ -454,13 +509,30 @@ int ChpSim::_nextEvent (int pc, int bw_cost)
     pc = _updatepc (pc);
   }
   if (_pc[pc]) {
-    new Event (this, SIM_EV_MKTYPE (pc,0) /* pc */,
+    _schedule (SIM_EV_MKTYPE (pc,0) /* pc */,
 	       _sc->getDelay (_pc[pc]->stmt->delay_cost + bw_cost));
     return 1;
   }
   return 0;
 }
 
+/*
+ * Schedule the next step of this process. Processes from the design
+ * go through the CHP run queue when it is enabled; initializer blocks
+ * and HSE processes always use the global event queue, since the
+ * reset phase looks for their events there.
+ */
+void ChpSim::_schedule (int type, int delay)
+{
+  ChpSimRunQueue *rq = _sc->chpRunQueue ();
+  if (rq && _proc != NULL && !_hse_mode) {
+    rq->schedule (this, type, delay);
+  }
+  else {
+    ActSimEvents::mk (this, type, delay);
+  }
+}
+
 void ChpSim::_initEvent ()
 {
   _nextEvent (0, 0);
@@ -934,15 +1006,114 @@ static bool _matchme (Event *ev)
   return false;
 }
 
+/*
+ * Execute an assignment statement; returns 1 if a breakpoint was hit.
+ */
+int ChpSim::_assign (chpsimstmt *stmt, void *cause)
+{
+  BigInt v;
+  unsigned long fv;
+  int fw;
+  int off, my_loff;
+  int breakpt = 0;
+
+  if (stmt->u.assign.is_struct) {
+    _vs = exprStruct (stmt->u.assign.e);
+    if (!_structure_assign (&stmt->u.assign.d, &_vs, cause)) {
+      breakpt = 1;
+    }
+  }
+  else if (stmt->u.assign.is_int && !stmt->u.assign.d.isenum &&
+	   stmt->u.assign.iwidth <= ACT_INT_NATIVE_BITS &&
+	   stmt->u.assign.code && stmt->u.assign.code->fast &&
+	   _sc->chpExprMode() != 2 &&
+	   _cevalFast (stmt->u.assign.code, &fv, &fw)) {
+    /* narrow integer: no BigInt unless the variable is observed */
+    if (stmt->u.assign.iwidth < ACT_INT_NATIVE_BITS) {
+      fv &= ((1UL << stmt->u.assign.iwidth) - 1);
+    }
+    off = computeOffset (&stmt->u.assign.d);
+    my_loff = off;
+    off = getGlobalOffset (off, 1);
+    if (_sc->isObserved (1, off)) {
+      v.setWidth (stmt->u.assign.iwidth);
+      v.setVal (0, fv);
+      v.toStatic ();
+      if (chkWatchBreakPt (1, my_loff, off, v, cause)) {
+	breakpt = 1;
+      }
+    }
+    _sc->setInt (off, fv, stmt->u.assign.iwidth);
+    intProp (off);
+  }
+  else {
+    v = _evalCode (stmt->u.assign.code, stmt->u.assign.e);
+#ifdef DUMP_ALL
+    printf ("%lu (w=%d)", v.getVal (0), v.getWidth());
+#endif
+    off = computeOffset (&stmt->u.assign.d);
+    my_loff = off;
+
+    if (stmt->u.assign.is_int == 0) {
+      off = getGlobalOffset (off, 0);
+#if 0
+      printf (" [bglob=%d]", off);
+#endif
+      if (chkWatchBreakPt (0, my_loff, off, v, cause)) {
+	breakpt = 1;
+      }
+      _sc->setBool (off, v.getVal (0));
+      boolProp (off);
+    }
+    else {
+      off = getGlobalOffset (off, 1);
+#if 0
+      printf (" [iglob=%d]", off);
+#endif
+      v.setWidth (stmt->u.assign.iwidth);
+      v.toStatic ();
+
+      if (chkWatchBreakPt (1, my_loff, off, v, cause)) {
+	breakpt = 1;
+      }
+      v.setWidth (stmt->u.assign.iwidth);
+      if (stmt->u.assign.d.isenum) {
+	BigInt tmpv (64, 0, 0);
+	tmpv.setVal (0, stmt->u.assign.d.enum_sz);
+	if (v >= tmpv) {
+	  breakpt = 1;
+	  _enum_error (_proc, v, stmt->u.assign.d.enum_sz);
+	}
+      }
+      _sc->setInt (off, v);
+      intProp (off);
+    }
+  }
+  return breakpt;
+}
+
 int ChpSim::Step (Event *ev)
 {
   int ev_type = ev->getType ();
+
+  /* wake-ups are scheduled by the wait objects, not by us */
+  if (SIM_EV_FLAGS (ev_type) == 0 && SIM_EV_TYPE (ev_type) != MAX_LOCAL_PCS) {
+    ActSimEvents::fire (this);
+  }
+  else if (ActSimProfile::on ()) {
+    ActSimProfile::enter (this);
+  }
+  return _step (ev_type, ev->getCause());
+}
+
+int ChpSim::_step (int ev_type, void *cause)
+{
   int pc = SIM_EV_TYPE (ev_type);
   int flag = SIM_EV_FLAGS (ev_type);
   int forceret = 0;
   int frag;
   BigInt v;
-  expr_multires vs, xchg;
+  expr_multires &vs = _vs, &xchg = _xchg;
   int off, goff;
   int _breakpt = 0;
   int sh_wakeup = 0;
@@ -976,7 +1147,7 @@ int ChpSim::Step (Event *ev)
 
   if (!_hse_mode && _sc->isResetMode() && _proc != NULL) {
     /*-- this is a real process: wait for run mode --*/
-    new Event (this, SIM_EV_MKTYPE (pc, 0), 10);
+    _schedule (SIM_EV_MKTYPE (pc, 0), 10);
     return 1;
   }
 
@@ -1058,54 +1229,8 @@ int ChpSim::Step (Event *ev)
     printf ("assign v[%d] := ", stmt->u.assign.d.offset);
 #endif
     pc = _updatepc (pc);
-    if (stmt->u.assign.is_struct) {
-      vs = exprStruct (stmt->u.assign.e);
-      if (!_structure_assign (&stmt->u.assign.d, &vs, ev->getCause())) {
-	_breakpt = 1;
-      }
-    }
-    else {
-      v = exprEval (stmt->u.assign.e);
-#ifdef DUMP_ALL
-      printf ("%lu (w=%d)", v.getVal (0), v.getWidth());
-#endif
-      off = computeOffset (&stmt->u.assign.d);
-      my_loff = off;
-
-      if (stmt->u.assign.is_int == 0) {
-	off = getGlobalOffset (off, 0);
-#if 0
-	printf (" [bglob=%d]", off);
-#endif
-	if (chkWatchBreakPt (0, my_loff, off, v, ev->getCause())) {
-	  _breakpt = 1;
-	}
-	_sc->setBool (off, v.getVal (0));
-	boolProp (off);
-      }
-      else {
-	off = getGlobalOffset (off, 1);
-#if 0
-	printf (" [iglob=%d]", off);
-#endif
-	v.setWidth (stmt->u.assign.iwidth);
-	v.toStatic ();
-
-	if (chkWatchBreakPt (1, my_loff, off, v, ev->getCause())) {
-	  _breakpt = 1;
-	}
-	v.setWidth (stmt->u.assign.iwidth);
-	if (stmt->u.assign.d.isenum) {
-	  BigInt tmpv (64, 0, 0);
-	  tmpv.setVal (0, stmt->u.assign.d.enum_sz);
-	  if (v >= tmpv) {
-	    _breakpt = 1;
-	    _enum_error (_proc, v, stmt->u.assign.d.enum_sz);
-	  }
-	}
-	_sc->setInt (off, v);
-	intProp (off);
-      }
+    if (_assign (stmt, cause)) {
+      _breakpt = 1;
     }
     break;
 
@@ -1137,7 +1262,7 @@ int ChpSim::Step (Event *ev)
 	    vs = exprStruct (stmt->u.sendrecv.e);
 	  }
 	  else {
-	    v = exprEval (stmt->u.sendrecv.e);
+	    v = _evalCode (stmt->u.sendrecv.code, stmt->u.sendrecv.e);
 	    vs.setSingle (v);
 	  }
 	}
@@ -1154,6 +1279,13 @@ int ChpSim::Step (Event *ev)
       /*-- attempt to send; suceeds if there is a receiver waiting,
 	otherwise we have to wait for the receiver --*/
       goff = getGlobalOffset (stmt->u.sendrecv.chvar, 2);
+
+      /* varSend() hands vs over to the channel, so keep a copy of
+	 the value if it has to be displayed */
+      expr_multires wv;
+      if (!flag && _sc->isObserved (3, goff)) {
+	wv = vs;
+      }
       rv = varSend (pc, flag, stmt->u.sendrecv.chvar, goff,
 		    stmt->u.sendrecv.flavor, vs, stmt->u.sendrecv.is_structx,
 		    &xchg, &frag, &skipwrite);
@@ -1186,7 +1318,7 @@ int ChpSim::Step (Event *ev)
 #if 0
 		printf (" [glob=%d]", off);
 #endif
-		if (chkWatchBreakPt (0, id, off, v, ev->getCause())) {
+		if (chkWatchBreakPt (0, id, off, v, cause)) {
 		  _breakpt = 1;
 		}
 		_sc->setBool (off, v.getVal (0));
@@ -1197,7 +1329,7 @@ int ChpSim::Step (Event *ev)
 #if 0	    
 		printf (" [glob=%d]", off);
 #endif
-		if (chkWatchBreakPt (1, id, off, v, ev->getCause())) {
+		if (chkWatchBreakPt (1, id, off, v, cause)) {
 		  _breakpt = 1;
 		}
 		v.setWidth (stmt->u.sendrecv.width);
@@ -1214,15 +1346,15 @@ int ChpSim::Step (Event *ev)
 	      }
 	    }
 	    else {
-	      if (!_structure_assign (stmt->u.sendrecv.d, &xchg, ev->getCause())) {
+	      if (!_structure_assign (stmt->u.sendrecv.d, &xchg, cause)) {
 		_breakpt = 1;
 	      }
 	    }
 	  }
 	}
       }
-      if (chkWatchBreakPt (3, stmt->u.sendrecv.chvar, goff, vs,
-			   ev->getCause(),
+      if (chkWatchBreakPt (3, stmt->u.sendrecv.chvar, goff, wv,
+			   cause,
 			   (frag ? 1 : 0) | ((rv ? 1 : (flag ? 2 : 0)) << 1))) {
 	_breakpt = 1;
       }
@@ -1254,7 +1386,7 @@ int ChpSim::Step (Event *ev)
 	      xchg = exprStruct (stmt->u.sendrecv.e);
 	    }
 	    else {
-	      v = exprEval (stmt->u.sendrecv.e);
+	      v = _evalCode (stmt->u.sendrecv.code, stmt->u.sendrecv.e);
 	      xchg.setSingle (v); 
 	    }
 	  }
@@ -1275,8 +1407,9 @@ int ChpSim::Step (Event *ev)
 	v = vs.v[0];
       }
       /*-- attempt to receive value --*/
-      if (chkWatchBreakPt (2, stmt->u.sendrecv.chvar, goff, vs,
-			   ev->getCause(),
+      expr_multires none;
+      if (chkWatchBreakPt (2, stmt->u.sendrecv.chvar, goff, rv ? none : vs,
+			   cause,
 			   ((rv ? 1 : (flag ? 2 : 0)) << 1))) {
 	_breakpt = 1;
       }
@@ -1299,7 +1432,7 @@ int ChpSim::Step (Event *ev)
 #if 0	    
 	      printf (" [glob=%d]", off);
 #endif
-	      if (chkWatchBreakPt (0, id, off, v, ev->getCause())) {
+	      if (chkWatchBreakPt (0, id, off, v, cause)) {
 		_breakpt = 1;
 	      }
 	      _sc->setBool (off, v.getVal (0));
@@ -1310,7 +1443,7 @@ int ChpSim::Step (Event *ev)
 #if 0	    
 	      printf (" [glob=%d]", off);
 #endif
-	      if (chkWatchBreakPt (1, id, off, v, ev->getCause())) {
+	      if (chkWatchBreakPt (1, id, off, v, cause)) {
 		_breakpt = 1;
 	      }
 
@@ -1328,7 +1461,7 @@ int ChpSim::Step (Event *ev)
 	    }
 	  }
 	  else {
-	    if (!_structure_assign (stmt->u.sendrecv.d, &vs, ev->getCause(), true)) {
+	    if (!_structure_assign (stmt->u.sendrecv.d, &vs, cause, true)) {
 	      _breakpt = 1;
 	    }
 	  }
@@ -1465,7 +1598,6 @@ int ChpSim::Step (Event *ev)
       int cnt = 0;
       list_t *ch_list = NULL;
       int choice = -1;
-      BigInt res;
 
 #ifdef DUMP_ALL
       if (stmt->type == CHPSIM_COND || stmt->type == CHPSIM_CONDARB) {
@@ -1503,8 +1635,7 @@ int ChpSim::Step (Event *ev)
       ch_list = list_new ();
       while (gc) {
 	if (gc->g) {
-	  res = exprEval (gc->g);
-	  if (res.getVal (0) != 0) {
+	  if (_evalGuard (gc)) {
 	    list_iappend (ch_list, cnt);
 	  }
 	  cnt++;
@@ -1609,12 +1740,118 @@ int ChpSim::Step (Event *ev)
 #ifdef DUMP_ALL  
     printf (" [NEXT!]\n");
 #endif
+    /*-- run zero-delay local assignments without an event --*/
+    for (int n=0; !_breakpt && n < _sc->chpCoalesce(); n++) {
+      while (_pc[pc] && !_pc[pc]->stmt) {
+	pc = _updatepc (pc);
+      }
+      if (!_pc[pc]) {
+	return 1;
+      }
+      stmt = _pc[pc]->stmt;
+      if (stmt->type != CHPSIM_ASSIGN || !stmt->u.assign.is_local ||
+	  !_coalesce_ok (stmt)) {
+	break;
+      }
+      int delay = _sc->getDelay (stmt->delay_cost + bw_cost);
+      if (delay != 0) {
+	_schedule (SIM_EV_MKTYPE (pc, 0), delay);
+	return 1;
+      }
+#ifdef DUMP_ALL
+      printf (" [coalesce] assign v[%d]", stmt->u.assign.d.offset);
+#endif
+      ActSimEvents::coalesce ();
+      _energy_cost += stmt->energy_cost;
+      pc = _updatepc (pc);
+      if (_assign (stmt, cause)) {
+	_breakpt = 1;
+      }
+      bw_cost = stmt->bw_cost;
+    }
     _nextEvent (pc, bw_cost);
   }
   return 1 - _breakpt;
 }
 
 
+/*
+ * Returns 1 if no process other than this one reads the variable at
+ * local offset loc (type 0 = bool, 1 = int).
+ */
+int ChpSim::_private_var (int loc, int type)
+{
+  int off = getGlobalOffset (loc, type);
+  int nfo = _sc->numFanout (off, type);
+  ActSimDES **fo = _sc->getFO (off, type);
+
+  for (int i=0; i < nfo; i++) {
+    if (fo[i] != this) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+int ChpSim::_private_expr (Expr *e)
+{
+  if (!e) {
+    return 1;
+  }
+  switch (e->type) {
+  case E_CHP_VARBOOL:
+    return _private_var (e->u.x.val, 0);
+
+  case E_CHP_VARINT:
+    return _private_var (e->u.x.val, 1);
+
+  case E_NOT:
+  case E_COMPLEMENT:
+  case E_UMINUS:
+  case E_BUILTIN_BOOL:
+    return _private_expr (e->u.e.l);
+
+  case E_QUERY:
+    return _private_expr (e->u.e.l) && _private_expr (e->u.e.r->u.e.l) &&
+      _private_expr (e->u.e.r->u.e.r);
+
+  case E_TRUE:
+  case E_FALSE:
+  case E_INT:
+    return 1;
+
+  default:
+    /* binary operators; anything else was rejected when the graph
+       was built */
+    return _private_expr (e->u.e.l) && _private_expr (e->u.e.r);
+  }
+}
+
+/*
+ * A statement marked is_local only reads and writes variables local
+ * to the process type; a variable with fanout to another process
+ * (e.g. one connected to a sub-instance port) can still be observed,
+ * so the assignment must go through the event queue. Fanout is per
+ * instance, so the answer is cached here rather than in the graph.
+ */
+int ChpSim::_coalesce_ok (struct chpsimstmt *stmt)
+{
+  phash_bucket_t *b;
+
+  if (!_coal_ok) {
+    _coal_ok = phash_new (4);
+  }
+  b = phash_lookup (_coal_ok, stmt);
+  if (!b) {
+    b = phash_add (_coal_ok, stmt);
+    b->i = _private_var (stmt->u.assign.d.offset,
+			 stmt->u.assign.d.isbool ? 0 : 1) &&
+      _private_expr (stmt->u.assign.e);
+  }
+  return b->i;
+}
+
+
 /* returns 1 if blocked */
 int ChpSim::varSend (int pc, int wakeup, int id, int off, int flavor,
 		     expr_multires &v, int bidir,
@@ -1673,7 +1910,7 @@ int ChpSim::varSend (int pc, int wakeup, int id, int off, int flavor,
 #endif
     *frag = 1;
     if (c->sfrag_st == 0) {
-      c->data = v;
+      c->data.swap (v);
       c->sfrag_st = 1;
       c->sufrag_st = 0;
     }
@@ -1702,7 +1939,7 @@ int ChpSim::varSend (int pc, int wakeup, int id, int off, int flavor,
 	/* finished protocol */
 	c->sfrag_st = 0;
 	if (bidir) {
-	  *xchg = c->data2;
+	  xchg->swap (c->data2);
 	  *skipwrite = c->skip_action;
 	  c->skip_action = 0;
 	}
@@ -1721,7 +1958,7 @@ int ChpSim::varSend (int pc, int wakeup, int id, int off, int flavor,
 	if (c->use_flavors && c->send_flavor == 1) {
 	  if (c->sfrag_st == 3) {
 	    if (bidir) {
-	      *xchg = c->data2;
+	      xchg->swap (c->data2);
 	      *skipwrite = c->skip_action;
 	      c->skip_action = 0;
 	    }
@@ -1758,7 +1995,7 @@ int ChpSim::varSend (int pc, int wakeup, int id, int off, int flavor,
     Assert (c->sender_probe == 0, "What?");
 
     if (bidir) {
-      *xchg = c->data;
+      xchg->swap (c->data);
       *skipwrite = c->skip_action;
       c->skip_action = 0;
     }
@@ -1771,9 +2008,9 @@ int ChpSim::varSend (int pc, int wakeup, int id, int off, int flavor,
     printf (" [waiting-recv %d]", c->recv_here-1);
 #endif
     // blocked receive, because there was no data
-    c->data = v;
+    c->data.swap (v);
     if (bidir) {
-      *xchg = c->data2;
+      xchg->swap (c->data2);
       *skipwrite = c->skip_action;
       c->skip_action = 0;
     }
@@ -1814,7 +2051,7 @@ int ChpSim::varSend (int pc, int wakeup, int id, int off, int flavor,
       c->receiver_probe = 0;
     }
     // we need to wait for the receive to show up
-    c->data2 = v;
+    c->data2.swap (v);
     if (c->send_here != 0) {
       act_connection *x;
       int dy;
@@ -1900,7 +2137,7 @@ int ChpSim::varRecv (int pc, int wakeup, int id, int off, int flavor,
     *frag = 1;
     if (c->rfrag_st == 0) {
       if (bidir) {
-	c->data2 = xchg;
+	c->data2.swap (xchg);
       }
       c->rfrag_st = 1;
       c->rufrag_st = 0;
@@ -1932,7 +2169,7 @@ int ChpSim::varRecv (int pc, int wakeup, int id, int off, int flavor,
 	printf ("[recv %p] done\n", c);
 #endif
 	c->rfrag_st = 0;
-	(*v) = c->data;
+	v->swap (c->data);
 	*skipwrite = c->skip_action;
 	c->skip_action = 0;
 	return 0;
@@ -1949,7 +2186,7 @@ int ChpSim::varRecv (int pc, int wakeup, int id, int off, int flavor,
 #if 0
 	    printf ("[recv %p] done\n", c);
 #endif
-	    (*v) = c->data;
+	    v->swap (c->data);
 	    *skipwrite = c->skip_action;
 	    c->skip_action = 0;
 	    return 0;
@@ -1979,7 +2216,7 @@ int ChpSim::varRecv (int pc, int wakeup, int id, int off, int flavor,
     printf (" [recv-wakeup %d]", pc);
 #endif
     //v->v[0].v = c->data;
-    *v = c->data;
+    v->swap (c->data);
     *skipwrite = c->skip_action;
     c->skip_action = 0;
     if (c->recv_here != 0) {
@@ -2007,11 +2244,11 @@ int ChpSim::varRecv (int pc, int wakeup, int id, int off, int flavor,
 #ifdef DUMP_ALL    
     printf (" [waiting-send %d]", c->send_here-1);
 #endif    
-    *v = c->data2;
+    v->swap (c->data2);
     *skipwrite = c->skip_action;
     c->skip_action = 0;
     if (bidir) {
-      c->data = xchg;
+      c->data.swap (xchg);
     }
     c->w->Notify (c->send_here-1, this);
     c->send_here = 0;
@@ -2055,7 +2292,7 @@ int ChpSim::varRecv (int pc, int wakeup, int id, int off, int flavor,
       c->w->AddObject (this);
     }
     if (bidir) {
-      c->data2 = xchg;
+      c->data2.swap (xchg);
     }
     return 1;
   }
@@ -2092,7 +2329,15 @@ BigInt ChpSim::varEval (int id, int type)
     }
   }
   else if (type == 1) {
-    r = *_sc->getInt (off);
+    if (!_sc->isWideInt (off)) {
+      /* build the value in place rather than copying one */
+      r.setWidth (_sc->getIntWidth (off));
+      r.setVal (0, _sc->getIntVal (off));
+      r.toStatic ();
+    }
+    else {
+      r = _sc->getWideInt (off);
+    }
   }
   else if (type == 2) {
     act_channel_state *c = _sc->getChan (off);
@@ -2404,161 +2649,680 @@ void ChpSim::_run_chp (Function *f, act_chp_lang_t *c)
 typedef expr_res (*EXTFUNC) (int nargs, expr_res *args);
 struct ExtLibs *_chp_ext = NULL;
 
-/**
- * Function that returns a simple value
+/*
+ * Argument/return buffers for the batched external interface. These
+ * are reused across calls.
  */
-BigInt ChpSim::funcEval (Function *f, int nargs, void **vargs)
+static expr_arg *_ext_args = NULL;
+static int _ext_max_args = 0;
+static expr_val *_ext_vals = NULL;
+static int _ext_max_vals = 0;
+static unsigned long *_ext_words = NULL;
+static int _ext_max_words = 0;
+static expr_res *_ext_res = NULL;
+static int _ext_max_res = 0;
+
+#define EXT_GROW(p,type,max,need)		\
+  do {						\
+    if ((need) > (max)) {			\
+      if (max) { FREE (p); }			\
+      max = (need);				\
+      MALLOC (p, type, max);			\
+    }						\
+  } while (0)
+
+static int _ext_nwords (int width)
 {
-  struct Hashtable *lstate;
-  hash_bucket_t *b;
-  hash_iter_t iter;
-  BigInt *x;
-  expr_multires *xm;
-  BigInt ret;
-  ActInstiter it(f->CurScope());
-
-  /*-- allocate state and bindings --*/
-  lstate = hash_new (4);
-
-  for (it = it.begin(); it != it.end(); it++) {
-    ValueIdx *vx = (*it);
-    if (TypeFactory::isParamType (vx->t)) continue;
+  return width <= 0 ? 1 : (width + 63)/64;
+}
 
-    b = hash_add (lstate, vx->getName());
+static int _ext_is_multi (Function *f, int i)
+{
+  return (TypeFactory::isStructure (f->getPortType (i)) ||
+	  f->getPortType (i)->arrayInfo()) ? 1 : 0;
+}
 
-    if (TypeFactory::isStructure (vx->t) || vx->t->arrayInfo()) {
-      expr_multires *x2;
-      Data *xd = dynamic_cast<Data *> (vx->t->BaseType());
-      NEW (x2, expr_multires);
-      new (x2) expr_multires (xd, vx->t->arrayInfo());
-      b->v = x2;
-      if (!xd) {
-	x2->setAllWidths (TypeFactory::bitWidth (vx->t));
-      }
-    }
-    else {
-      NEW (x, BigInt);
-      new (x) BigInt;
-      x->setVal (0, 0);
-      x->setWidth (TypeFactory::bitWidth (vx->t));
-      b->v = x;
-    }
+/*
+ * BigInt does not give access to its word storage, so values are
+ * copied into the argument buffer.
+ */
+static void _ext_fill (expr_val *ev, unsigned long **wp, BigInt *b)
+{
+  ev->width = b->getWidth();
+  ev->len = b->getLen();
+  ev->v = *wp;
+  for (int j=0; j < ev->len; j++) {
+    ev->v[j] = b->getVal (j);
   }
+  *wp += ev->len;
+}
 
-  if (nargs != f->getNumPorts()) {
-    fatal_error ("Function `%s': invalid number of arguments", f->getName());
-  }
+/*
+ * Resolved external functions, keyed by Function *. A symbol is
+ * looked up only on the first call; NULL entries record functions
+ * that are not provided by any library.
+ */
+struct chp_ext_entry {
+  EXTFUNC f;			/* single-value interface */
+  EXTFUNC_BATCH b;		/* batched interface */
+};
+static struct iHashtable *_chp_ext_cache = NULL;
 
-  for (int i=0; i < f->getNumPorts(); i++) {
-    int w;
-    b = hash_lookup (lstate, f->getPortName (i));
-    Assert (b, "What?");
+static struct chp_ext_entry *_ext_lookup (Function *f)
+{
+  ihash_bucket_t *ib;
+  struct chp_ext_entry *x;
+  char buf[1024];
 
-    if (TypeFactory::isStructure (f->getPortType (i)) ||
-	f->getPortType (i)->arrayInfo()) {
-      xm = (expr_multires *)b->v;
-      *xm = *((expr_multires *)vargs[i]);
-    }
-    else {
-      x = (BigInt *) b->v;
-      w = x->getWidth ();
-      *x = *((BigInt *)vargs[i]);
-      x->setWidth (w);
-      x->toStatic ();
-    }
+  if (!_chp_ext_cache) {
+    _chp_ext_cache = ihash_new (4);
   }
+  ib = ihash_lookup (_chp_ext_cache, (long)f);
+  if (ib) {
+    return (struct chp_ext_entry *)ib->v;
+  }
+  if (!_chp_ext) {
+    _chp_ext = act_read_extern_table ("sim.extern");
+  }
+  NEW (x, struct chp_ext_entry);
+  snprintf (buf, 1024, "%s%s", f->getName(), ACT_EXT_BATCH_SUFFIX);
+  x->b = (EXTFUNC_BATCH) act_find_dl_func (_chp_ext, f->getns(), buf);
+  x->f = (EXTFUNC) act_find_dl_func (_chp_ext, f->getns(), f->getName());
+  ib = ihash_add (_chp_ext_cache, (long)f);
+  ib->v = x;
+  return x;
+}
 
-  /* --- run body -- */
-  if (f->isExternal()) {
-    EXTFUNC extcall = NULL;
-
-    if (!_chp_ext) {
-      _chp_ext = act_read_extern_table ("sim.extern");
-    }
-    extcall = (EXTFUNC) act_find_dl_func (_chp_ext, f->getns(), f->getName());
-
-    if (!extcall) {
-      fatal_error ("Function `%s%s' missing chp body as well as external definition.",
-		   f->getns() == ActNamespace::Global() ? "" :
-		   f->getns()->Name(true) + 2,
-		   f->getName());
-    }
-
-    expr_res *extargs = NULL;
-    expr_res extret;
-    if (nargs > 0) {
-      MALLOC (extargs, expr_res, nargs);
-      for (int i=0; i < nargs; i++) {
-	if (TypeFactory::isStructure (f->getPortType (i))) {
-	  fatal_error ("External function calls cannot have structure arguments");
-	}
-	if (f->getPortType (i)->arrayInfo()) {
-	  fatal_error ("External function calls cannot have array arguments");
+/*
+ * Call f through the batched interface, once for each of the ncalls
+ * argument lists in vargs[]. ret[] holds nret values per call with
+ * their widths set; they are overwritten with the results.
+ */
+static void _ext_call_batch (EXTFUNC_BATCH fn, Function *f, int ncalls,
+			     int nargs, void ***vargs, int nret, BigInt *ret)
+{
+  int nv, nw, res;
+  expr_val *vp;
+  unsigned long *wp;
+  expr_arg *ap;
+
+  /*-- size --*/
+  nv = ncalls*nret;
+  nw = 0;
+  for (int c=0; c < ncalls; c++) {
+    for (int i=0; i < nargs; i++) {
+      if (_ext_is_multi (f, i)) {
+	expr_multires *m = (expr_multires *)vargs[c][i];
+	nv += m->nvals;
+	for (int j=0; j < m->nvals; j++) {
+	  nw += m->v[j].getLen();
 	}
-	extargs[i].width = ((BigInt *)vargs[i])->getWidth ();
-	extargs[i].v = ((BigInt *)vargs[i])->getVal (0);
       }
-    }
-    extret = (*extcall) (nargs, extargs);
-    if (nargs > 0) {
-      FREE (extargs);
-    }
-    BigInt tmp;
-    tmp.setWidth (extret.width);
-    tmp.setVal (0, extret.v);
-
-    hash_iter_init (lstate, &iter);
-    while ((b = hash_iter_next (lstate, &iter))) {
-      ValueIdx *vx = f->CurScope()->LookupVal (b->key);
-      Assert (vx, "How is this possible?");
-      if (TypeFactory::isStructure (vx->t)) {
-	((expr_multires *)b->v)->~expr_multires();
+      else {
+	nv++;
+	nw += ((BigInt *)vargs[c][i])->getLen();
+      }
+    }
+  }
+  for (int j=0; j < nret; j++) {
+    nw += ncalls*_ext_nwords (ret[j].getWidth());
+  }
+  EXT_GROW (_ext_args, expr_arg, _ext_max_args, ncalls*(nargs + 1));
+  EXT_GROW (_ext_vals, expr_val, _ext_max_vals, nv);
+  EXT_GROW (_ext_words, unsigned long, _ext_max_words, nw);
+
+  /*-- marshal --*/
+  vp = _ext_vals;
+  wp = _ext_words;
+  ap = _ext_args;
+  for (int c=0; c < ncalls; c++) {
+    for (int i=0; i < nargs; i++) {
+      ap->val = vp;
+      if (_ext_is_multi (f, i)) {
+	expr_multires *m = (expr_multires *)vargs[c][i];
+	ap->n = m->nvals;
+	for (int j=0; j < m->nvals; j++) {
+	  _ext_fill (vp++, &wp, &m->v[j]);
+	}
       }
       else {
-	((BigInt *)b->v)->~BigInt();
+	ap->n = 1;
+	_ext_fill (vp++, &wp, (BigInt *)vargs[c][i]);
       }
-      FREE (b->v);
+      ap++;
     }
-    hash_free (lstate);
-    
-    return tmp;
   }
-  
-  act_chp *c = f->getlang()->getchp();
-  Scope *_tmp = _cureval;
-  stack_push (_statestk, lstate);
-  _cureval = f->CurScope();
-  _run_chp (f, c->c);
-  _cureval = _tmp;
-  stack_pop (_statestk);
-
-  /* -- return result -- */
-  b = hash_lookup (lstate, "self");
-  x = (BigInt *)b->v;
-  ret = *x;
-
-  hash_iter_init (lstate, &iter);
-  while ((b = hash_iter_next (lstate, &iter))) {
-    ValueIdx *vx = f->CurScope()->LookupVal (b->key);
-    Assert (vx, "How is this possible?");
-    if (TypeFactory::isStructure (vx->t) || vx->t->arrayInfo()) {
-      ((expr_multires *)b->v)->~expr_multires();
-    }
-    else {
-      ((BigInt *)b->v)->~BigInt();
+  for (int c=0; c < ncalls; c++) {
+    ap->n = nret;
+    ap->val = vp;
+    for (int j=0; j < nret; j++) {
+      vp->width = ret[c*nret + j].getWidth();
+      vp->len = _ext_nwords (vp->width);
+      vp->v = wp;
+      for (int k=0; k < vp->len; k++) {
+	wp[k] = 0;
+      }
+      wp += vp->len;
+      vp++;
     }
-    FREE (b->v);
+    ap++;
   }
-  hash_free (lstate);
 
-  return ret;
+  ap = &_ext_args[ncalls*nargs];
+  res = (*fn) (ncalls, nargs, _ext_args, ap);
+  if (res != 0) {
+    fatal_error ("External function `%s' failed (%d).", f->getName(), res);
+  }
+
+  /*-- unmarshal --*/
+  for (int c=0; c < ncalls; c++) {
+    vp = ap[c].val;
+    for (int j=0; j < nret; j++) {
+      BigInt *r = &ret[c*nret + j];
+      r->setWidth (vp[j].width);
+      for (int k=0; k < vp[j].len && k < r->getLen(); k++) {
+	r->setVal (k, vp[j].v[k]);
+      }
+    }
+  }
 }
 
 
-// but at least 1
-static int _ceil_log2 (int w)
-{
-  int i;
+/*
+ * Batching of external calls. If an expression evaluated by
+ * _evalCode() makes two or more calls to the same function with a
+ * batched interface, and nothing else in it calls a function, all the
+ * calls are made in one invocation of the batched entry point when the
+ * first one is reached. Evaluating the rest of the expression has no
+ * side effects, so this does not change the order of external calls.
+ */
+struct chp_ext_batch {
+  Function *f;
+  int n;			/* # of calls, 0 if not batched */
+  Expr **call;			/* calls in evaluation order */
+};
+static struct pHashtable *_ext_batches = NULL;
+
+/*
+ * Append the external calls in e to calls, in evaluation order.
+ * Returns 0 if e has a call that cannot be batched. With calls NULL,
+ * e may not contain any call.
+ */
+static int _ext_scan (Expr *e, list_t *calls)
+{
+  if (!e) {
+    return 1;
+  }
+  switch (e->type) {
+  case E_TRUE:
+  case E_FALSE:
+  case E_INT:
+  case E_VAR:
+  case E_CHP_VARBOOL:
+  case E_CHP_VARINT:
+  case E_CHP_VARCHAN:
+  case E_CHP_CHANSTRUCT_REF:
+  case E_CHP_VARSTRUCT:
+  case E_PROBEIN:
+  case E_PROBEOUT:
+  case E_SELF:
+  case E_SELF_ACK:
+    return 1;
+
+  case E_NOT:
+  case E_COMPLEMENT:
+  case E_UMINUS:
+  case E_BUILTIN_BOOL:
+  case E_BITFIELD:
+    return _ext_scan (e->u.e.l, calls);
+
+  case E_AND:
+  case E_OR:
+  case E_XOR:
+  case E_PLUS:
+  case E_MINUS:
+  case E_MULT:
+  case E_DIV:
+  case E_MOD:
+  case E_LSL:
+  case E_LSR:
+  case E_ASR:
+  case E_LT:
+  case E_GT:
+  case E_LE:
+  case E_GE:
+  case E_EQ:
+  case E_NE:
+  case E_BUILTIN_INT:
+    return _ext_scan (e->u.e.l, calls) && _ext_scan (e->u.e.r, calls);
+
+  case E_QUERY:
+    /* only one of the two branches is evaluated */
+    return _ext_scan (e->u.e.l, calls) &&
+      _ext_scan (e->u.e.r->u.e.l, NULL) && _ext_scan (e->u.e.r->u.e.r, NULL);
+
+  case E_CONCAT:
+    for (; e; e = e->u.e.r) {
+      if (!_ext_scan (e->u.e.l, calls)) {
+	return 0;
+      }
+    }
+    return 1;
+
+  case E_FUNCTION:
+    {
+      Function *f = (Function *)e->u.fn.s;
+      if (!calls || !f->isExternal() ||
+	  TypeFactory::isStructure (f->getRetType()) || !_ext_lookup (f)->b) {
+	return 0;
+      }
+      for (Expr *tmp = e->u.fn.r; tmp; tmp = tmp->u.e.r) {
+	if (!_ext_scan (tmp->u.e.l, NULL)) {
+	  return 0;
+	}
+      }
+      list_append (calls, e);
+    }
+    return 1;
+
+  default:
+    /* array derefs and anything else may hide a call */
+    return 0;
+  }
+}
+
+static struct chp_ext_batch *_ext_batch_info (Expr *root)
+{
+  phash_bucket_t *b;
+  struct chp_ext_batch *x;
+  list_t *l;
+  listitem_t *li;
+
+  if (!_ext_batches) {
+    _ext_batches = phash_new (4);
+  }
+  b = phash_lookup (_ext_batches, root);
+  if (b) {
+    return (struct chp_ext_batch *)b->v;
+  }
+  NEW (x, struct chp_ext_batch);
+  x->f = NULL;
+  x->n = 0;
+  x->call = NULL;
+
+  l = list_new ();
+  if (_ext_scan (root, l) && list_length (l) > 1) {
+    /* calls to different functions would be re-ordered */
+    x->f = (Function *) ((Expr *)list_value (list_first (l)))->u.fn.s;
+    for (li = list_first (l); li; li = list_next (li)) {
+      if (((Expr *)list_value (li))->u.fn.s != (void *)x->f) {
+	break;
+      }
+    }
+    if (!li) {
+      x->n = list_length (l);
+      MALLOC (x->call, Expr *, x->n);
+      x->n = 0;
+      for (li = list_first (l); li; li = list_next (li)) {
+	x->call[x->n++] = (Expr *) list_value (li);
+      }
+    }
+  }
+  list_free (l);
+  b = phash_add (_ext_batches, root);
+  b->v = x;
+  return x;
+}
+
+/*
+ * If e is one of the batched external calls in the expression being
+ * evaluated, set *res to its result and return 1. The first call in
+ * the batch makes all of them.
+ */
+int ChpSim::_extBatched (Expr *e, BigInt *res)
+{
+  struct chp_ext_batch *x = _ext_batch_info (_ext_root);
+  int nargs;
+
+  if (x->n == 0) {
+    return 0;
+  }
+  if (_ext_pos == 0) {
+    void ***vargs;
+
+    if (e != x->call[0]) {
+      return 0;
+    }
+    MALLOC (vargs, void **, x->n);
+    for (int i=0; i < x->n; i++) {
+      construct_fn_args (x->call[i], &nargs, &vargs[i]);
+    }
+    if (nargs != x->f->getNumPorts()) {
+      fatal_error ("Function `%s': invalid number of arguments",
+		   x->f->getName());
+    }
+    _ext_ret.resize (x->n);
+    for (int i=0; i < x->n; i++) {
+      _ext_ret.v[i].setWidth (TypeFactory::bitWidth (x->f->getRetType()));
+      _ext_ret.v[i].setVal (0, 0);
+    }
+    _ext_call_batch (_ext_lookup (x->f)->b, x->f, x->n, nargs, vargs,
+		     1, _ext_ret.v);
+    for (int i=0; i < x->n; i++) {
+      free_fn_args (x->call[i], &nargs, &vargs[i]);
+    }
+    FREE (vargs);
+  }
+  if (_ext_pos < x->n && e == x->call[_ext_pos]) {
+    *res = _ext_ret.v[_ext_pos++];
+    return 1;
+  }
+  return 0;
+}
+
+/**
+ * Function that returns a simple value
+ */
+/*
+ * Frame layout for function f, computed on first use. is_struct is
+ * set when the function returns a structure (funcStruct).
+ */
+struct chpsim_fn_layout *ChpSim::_getFnLayout (Function *f, int is_struct)
+{
+  ihash_bucket_t *ib;
+  struct chpsim_fn_layout *l;
+  struct Hashtable *names;
+  hash_bucket_t *b;
+  int i;
+
+  if (!_fnlayout) {
+    _fnlayout = ihash_new (4);
+  }
+  ib = ihash_lookup (_fnlayout, (long)f);
+  if (ib) {
+    return (struct chpsim_fn_layout *)ib->v;
+  }
+
+  ActInstiter it(f->CurScope());
+  NEW (l, struct chpsim_fn_layout);
+  l->nslots = 0;
+  for (it = it.begin(); it != it.end(); it++) {
+    ValueIdx *vx = (*it);
+    if (TypeFactory::isParamType (vx->t)) continue;
+    l->nslots++;
+  }
+  if (l->nslots > 0) {
+    MALLOC (l->name, const char *, l->nslots);
+    MALLOC (l->multi, unsigned char, l->nslots);
+    MALLOC (l->isport, unsigned char, l->nslots);
+    MALLOC (l->init, void *, l->nslots);
+  }
+  else {
+    l->name = NULL;
+    l->multi = NULL;
+    l->isport = NULL;
+    l->init = NULL;
+  }
+  if (f->getNumPorts() > 0) {
+    MALLOC (l->port, int, f->getNumPorts());
+  }
+  else {
+    l->port = NULL;
+  }
+  l->self = -1;
+  l->free = NULL;
+
+  names = hash_new (4);
+  i = 0;
+  for (it = it.begin(); it != it.end(); it++) {
+    ValueIdx *vx = (*it);
+    if (TypeFactory::isParamType (vx->t)) continue;
+
+    b = hash_add (names, vx->getName());
+    b->i = i;
+    l->name[i] = vx->getName();
+    l->isport[i] = 0;
+    if (strcmp (vx->getName(), "self") == 0) {
+      l->self = i;
+    }
+    if (TypeFactory::isStructure (vx->t) || vx->t->arrayInfo()) {
+      expr_multires *x2;
+      Data *xd = dynamic_cast<Data *> (vx->t->BaseType());
+      x2 = new expr_multires (xd, vx->t->arrayInfo());
+      if (!xd) {
+	x2->setAllWidths (TypeFactory::bitWidth (vx->t));
+      }
+      l->multi[i] = 1;
+      l->init[i] = x2;
+    }
+    else {
+      BigInt *x = new BigInt;
+      x->setVal (0, 0);
+      x->setWidth (TypeFactory::bitWidth (vx->t));
+      if (is_struct) {
+	x->toStatic ();
+      }
+      l->multi[i] = 0;
+      l->init[i] = x;
+    }
+    i++;
+  }
+  for (i=0; i < f->getNumPorts(); i++) {
+    b = hash_lookup (names, f->getPortName (i));
+    Assert (b, "What?");
+    l->port[i] = b->i;
+    l->isport[b->i] = 1;
+  }
+  hash_free (names);
+
+  ib = ihash_add (_fnlayout, (long)f);
+  ib->v = l;
+  return l;
+}
+
+/*
+ * Get a frame for a call; all non-port slots hold their initial
+ * values.
+ */
+struct chpsim_fn_frame *ChpSim::_allocFrame (struct chpsim_fn_layout *l)
+{
+  struct chpsim_fn_frame *fr;
+
+  if (l->free) {
+    fr = l->free;
+    l->free = fr->next;
+    for (int i=0; i < l->nslots; i++) {
+      if (l->isport[i]) continue;
+      if (l->multi[i]) {
+	*((expr_multires *)fr->slot[i]) = *((expr_multires *)l->init[i]);
+      }
+      else {
+	*((BigInt *)fr->slot[i]) = *((BigInt *)l->init[i]);
+      }
+    }
+    return fr;
+  }
+
+  /* build a new frame */
+  NEW (fr, struct chpsim_fn_frame);
+  fr->H = hash_new (4);
+  fr->next = NULL;
+  if (l->nslots > 0) {
+    MALLOC (fr->slot, void *, l->nslots);
+  }
+  else {
+    fr->slot = NULL;
+  }
+  for (int i=0; i < l->nslots; i++) {
+    if (l->multi[i]) {
+      fr->slot[i] = new expr_multires (*((expr_multires *)l->init[i]));
+    }
+    else {
+      fr->slot[i] = new BigInt (*((BigInt *)l->init[i]));
+    }
+    hash_bucket_t *b = hash_add (fr->H, l->name[i]);
+    b->v = fr->slot[i];
+  }
+  return fr;
+}
+
+void ChpSim::_releaseFrame (struct chpsim_fn_layout *l,
+			    struct chpsim_fn_frame *fr)
+{
+  fr->next = l->free;
+  l->free = fr;
+}
+
+static void _free_fn_slots (struct chpsim_fn_layout *l, void **slot)
+{
+  for (int i=0; i < l->nslots; i++) {
+    if (l->multi[i]) {
+      delete ((expr_multires *)slot[i]);
+    }
+    else {
+      delete ((BigInt *)slot[i]);
+    }
+  }
+}
+
+void ChpSim::_freeFnLayouts ()
+{
+  ihash_iter_t it;
+  ihash_bucket_t *ib;
+
+  if (!_fnlayout) {
+    return;
+  }
+  ihash_iter_init (_fnlayout, &it);
+  while ((ib = ihash_iter_next (_fnlayout, &it))) {
+    struct chpsim_fn_layout *l = (struct chpsim_fn_layout *)ib->v;
+    while (l->free) {
+      struct chpsim_fn_frame *fr = l->free;
+      l->free = fr->next;
+      _free_fn_slots (l, fr->slot);
+      if (fr->slot) {
+	FREE (fr->slot);
+      }
+      hash_free (fr->H);
+      FREE (fr);
+    }
+    _free_fn_slots (l, l->init);
+    if (l->nslots > 0) {
+      FREE (l->name);
+      FREE (l->multi);
+      FREE (l->isport);
+      FREE (l->init);
+    }
+    if (l->port) {
+      FREE (l->port);
+    }
+    FREE (l);
+  }
+  ihash_free (_fnlayout);
+  _fnlayout = NULL;
+}
+
+/*
+ * Bind the arguments to the port slots of a frame.
+ */
+static void _bind_fn_args (Function *f, struct chpsim_fn_layout *l,
+			   struct chpsim_fn_frame *fr, void **vargs)
+{
+  for (int i=0; i < f->getNumPorts(); i++) {
+    int s = l->port[i];
+    if (l->multi[s]) {
+      *((expr_multires *)fr->slot[s]) = *((expr_multires *)vargs[i]);
+    }
+    else {
+      BigInt *x = (BigInt *) fr->slot[s];
+      int w = x->getWidth ();
+      *x = *((BigInt *)vargs[i]);
+      x->setWidth (w);
+      x->toStatic ();
+    }
+  }
+}
+
+BigInt ChpSim::funcEval (Function *f, int nargs, void **vargs)
+{
+  struct chpsim_fn_layout *l;
+  struct chpsim_fn_frame *fr;
+  BigInt ret;
+
+  if (nargs != f->getNumPorts()) {
+    fatal_error ("Function `%s': invalid number of arguments", f->getName());
+  }
+
+  /* --- run body -- */
+  if (f->isExternal()) {
+    struct chp_ext_entry *ext = _ext_lookup (f);
+    EXTFUNC extcall = ext->f;
+
+    if (ext->b) {
+      BigInt tmp;
+      tmp.setWidth (TypeFactory::bitWidth (f->getRetType()));
+      tmp.setVal (0, 0);
+      _ext_call_batch (ext->b, f, 1, nargs, &vargs, 1, &tmp);
+      return tmp;
+    }
+
+    if (!extcall) {
+      fatal_error ("Function `%s%s' missing chp body as well as external definition.",
+		   f->getns() == ActNamespace::Global() ? "" :
+		   f->getns()->Name(true) + 2,
+		   f->getName());
+    }
+
+    expr_res *extargs = NULL;
+    expr_res extret;
+    if (nargs > 0) {
+      EXT_GROW (_ext_res, expr_res, _ext_max_res, nargs);
+      extargs = _ext_res;
+      for (int i=0; i < nargs; i++) {
+	if (TypeFactory::isStructure (f->getPortType (i))) {
+	  fatal_error ("External function calls cannot have structure arguments");
+	}
+	if (f->getPortType (i)->arrayInfo()) {
+	  fatal_error ("External function calls cannot have array arguments");
+	}
+	extargs[i].width = ((BigInt *)vargs[i])->getWidth ();
+	extargs[i].v = ((BigInt *)vargs[i])->getVal (0);
+      }
+    }
+    extret = (*extcall) (nargs, extargs);
+    BigInt tmp;
+    tmp.setWidth (extret.width);
+    tmp.setVal (0, extret.v);
+    return tmp;
+  }
+
+  /*-- get a frame and bind arguments --*/
+  l = _getFnLayout (f, 0);
+  fr = _allocFrame (l);
+  _bind_fn_args (f, l, fr, vargs);
+  
+  act_chp *c = f->getlang()->getchp();
+  Scope *_tmp = _cureval;
+  stack_push (_statestk, fr->H);
+  _cureval = f->CurScope();
+  _run_chp (f, c->c);
+  _cureval = _tmp;
+  stack_pop (_statestk);
+
+  /* -- return result -- */
+  Assert (l->self != -1 && !l->multi[l->self], "What?");
+  ret = *((BigInt *)fr->slot[l->self]);
+
+  _releaseFrame (l, fr);
+
+  return ret;
+}
+
+
+// but at least 1
+static int _ceil_log2 (int w)
+{
+  int i;
 
   w--;
   i = 0;
@@ -3051,6 +3815,9 @@ BigInt ChpSim::exprEval (Expr *e)
 
   case E_FUNCTION:
     /* function is e->u.fn.s */
+    if (_ext_root && _extBatched (e, &l)) {
+      break;
+    }
     {
       int nargs;
       void **args;
@@ -3092,6 +3859,333 @@ BigInt ChpSim::exprEval (Expr *e)
   return l;
 }
 
+
+/*
+ * Evaluate a compiled expression. This performs the same BigInt
+ * operations as exprEval(), without the recursion. The stack is on the
+ * C stack unless the expression is deeper than CHPSIM_ESTACK.
+ */
+BigInt ChpSim::_ceval (struct chpsim_ecode *c)
+{
+  BigInt sstk[CHPSIM_ESTACK];
+  BigInt *stk = sstk;
+  int sp = 0;
+  struct chpsim_eop *op;
+
+  if (c->depth > CHPSIM_ESTACK) {
+    stk = new BigInt[c->depth];
+  }
+
+  for (int pc=0; pc < c->n; pc++) {
+    op = &c->op[pc];
+    switch (op->type) {
+    case CHPSIM_EOP_CONST:
+      stk[sp].setWidth (op->w);
+      stk[sp].setVal (0, op->v);
+      stk[sp].toDynamic ();
+      sp++;
+      break;
+
+    case CHPSIM_EOP_BIGCONST:
+      stk[sp] = *((BigInt *)op->e->u.ival.v_extra);
+      stk[sp].toDynamic ();
+      sp++;
+      break;
+
+    case CHPSIM_EOP_VARBOOL:
+      stk[sp] = varEval (op->x, 0);
+      stk[sp].setWidth (1);
+      stk[sp].toDynamic ();
+      sp++;
+      break;
+
+    case CHPSIM_EOP_VARINT:
+      stk[sp] = varEval (op->x, 1);
+      stk[sp].setWidth (op->w);
+      stk[sp].toDynamic ();
+      sp++;
+      break;
+
+    case CHPSIM_EOP_TREE:
+      stk[sp++] = exprEval (op->e);
+      break;
+
+    case CHPSIM_EOP_JZ:
+      {
+	BigInt zero;
+	zero.setWidth (1);
+	zero.setVal (0, 0);
+	sp--;
+	if (stk[sp] == zero) {
+	  pc = op->x - 1;
+	}
+      }
+      break;
+
+    case CHPSIM_EOP_JMP:
+      pc = op->x - 1;
+      break;
+
+    case E_NOT:
+    case E_COMPLEMENT:
+      if (op->w != -1) {
+	stk[sp-1].setWidth (op->w);
+      }
+      stk[sp-1] = ~stk[sp-1];
+      stk[sp-1].toDynamic ();
+      break;
+
+    case E_UMINUS:
+      if (op->w != -1) {
+	stk[sp-1].setWidth (op->w);
+      }
+      stk[sp-1] = -stk[sp-1];
+      stk[sp-1].toUnsigned ();
+      stk[sp-1].toDynamic ();
+      break;
+
+    case E_BUILTIN_BOOL:
+      if (stk[sp-1].getVal (0)) {
+	stk[sp-1].setVal (0, 1);
+      }
+      else {
+	stk[sp-1].setVal (0, 0);
+      }
+      stk[sp-1].setWidth (1);
+      stk[sp-1].toDynamic ();
+      break;
+
+    default:
+      {
+	/* binary operators */
+	BigInt &l = stk[sp-2];
+	BigInt &r = stk[sp-1];
+	int res = -1;
+	switch (op->type) {
+	case E_AND: l &= r; break;
+	case E_OR: l |= r; break;
+	case E_XOR: l ^= r; break;
+	case E_PLUS: l += r; break;
+	case E_MINUS:
+	  if (op->w != -1) {
+	    l.setWidth (op->w);
+	  }
+	  l -= r;
+	  break;
+	case E_MULT: l = l * r; break;
+	case E_DIV: l = l / r; break;
+	case E_MOD: l = l % r; break;
+	case E_LSL: l <<= r; break;
+	case E_LSR:
+	  l.toStatic ();
+	  l >>= r;
+	  break;
+	case E_ASR:
+	  l.toSigned ();
+	  l.toStatic ();
+	  l >>= r;
+	  l.toUnsigned ();
+	  break;
+	case E_LT: res = (l < r); break;
+	case E_GT: res = (l > r); break;
+	case E_LE: res = (l <= r); break;
+	case E_GE: res = (l >= r); break;
+	case E_EQ: res = (l == r); break;
+	case E_NE: res = (l != r); break;
+	default:
+	  fatal_error ("Unknown compiled expression op %d", op->type);
+	  break;
+	}
+	if (res != -1) {
+	  l.setWidth (1);
+	  l.setVal (0, res);
+	}
+	l.toDynamic ();
+	sp--;
+      }
+      break;
+    }
+  }
+  Assert (sp == 1, "Compiled expression: stack mismatch");
+  if (stk != sstk) {
+    BigInt ret = stk[0];
+    delete [] stk;
+    return ret;
+  }
+  return stk[0];
+}
+
+/*
+ * 64-bit evaluator for compiled expressions marked "fast". Returns 0
+ * if the expression cannot be evaluated this way (e.g. an X value), in
+ * which case the caller uses _ceval().
+ */
+int ChpSim::_cevalFast (struct chpsim_ecode *c, unsigned long *v, int *w)
+{
+  unsigned long stk[CHPSIM_ESTACK];
+  int wstk[CHPSIM_ESTACK];
+
+  if (c->depth > CHPSIM_ESTACK) {
+    unsigned long *bstk;
+    int *bwstk, ret;
+    MALLOC (bstk, unsigned long, c->depth);
+    MALLOC (bwstk, int, c->depth);
+    ret = _cevalFast (c, v, w, bstk, bwstk);
+    FREE (bstk);
+    FREE (bwstk);
+    return ret;
+  }
+  return _cevalFast (c, v, w, stk, wstk);
+}
+
+int ChpSim::_cevalFast (struct chpsim_ecode *c, unsigned long *v, int *w,
+			unsigned long *stk, int *wstk)
+{
+  int sp = 0;
+  struct chpsim_eop *op;
+
+  for (int pc=0; pc < c->n; pc++) {
+    op = &c->op[pc];
+    switch (op->type) {
+    case CHPSIM_EOP_CONST:
+      stk[sp] = op->v;
+      wstk[sp] = op->w;
+      sp++;
+      break;
+
+    case CHPSIM_EOP_VARBOOL:
+      stk[sp] = _sc->getBool (getGlobalOffset (op->x, 0));
+      if (stk[sp] == 2) {
+	return 0;
+      }
+      wstk[sp] = 1;
+      sp++;
+      break;
+
+    case CHPSIM_EOP_VARINT:
+      stk[sp] = _sc->getIntVal (getGlobalOffset (op->x, 1));
+      if (op->w < 64) {
+	stk[sp] &= ((1UL << op->w) - 1);
+      }
+      wstk[sp] = op->w;
+      sp++;
+      break;
+
+    case CHPSIM_EOP_JZ:
+      sp--;
+      if (stk[sp] == 0) {
+	pc = op->x - 1;
+      }
+      break;
+
+    case CHPSIM_EOP_JMP:
+      pc = op->x - 1;
+      break;
+
+    case E_NOT:
+    case E_COMPLEMENT:
+      if (op->w == -1 && wstk[sp-1] != 1) {
+	return 0;
+      }
+      stk[sp-1] = (~stk[sp-1]) & 1;
+      wstk[sp-1] = 1;
+      break;
+
+    case E_BUILTIN_BOOL:
+      stk[sp-1] = (stk[sp-1] != 0);
+      wstk[sp-1] = 1;
+      break;
+
+    default:
+      sp--;
+      switch (op->type) {
+      case E_AND: stk[sp-1] &= stk[sp]; break;
+      case E_OR: stk[sp-1] |= stk[sp]; break;
+      case E_XOR: stk[sp-1] ^= stk[sp]; break;
+      case E_LT: stk[sp-1] = (stk[sp-1] < stk[sp]); break;
+      case E_GT: stk[sp-1] = (stk[sp-1] > stk[sp]); break;
+      case E_LE: stk[sp-1] = (stk[sp-1] <= stk[sp]); break;
+      case E_GE: stk[sp-1] = (stk[sp-1] >= stk[sp]); break;
+      case E_EQ: stk[sp-1] = (stk[sp-1] == stk[sp]); break;
+      case E_NE: stk[sp-1] = (stk[sp-1] != stk[sp]); break;
+      default:
+	return 0;
+      }
+      if (op->type == E_AND || op->type == E_OR || op->type == E_XOR) {
+	if (wstk[sp-1] != wstk[sp]) {
+	  wstk[sp-1] = -1;
+	}
+      }
+      else {
+	wstk[sp-1] = 1;
+      }
+      break;
+    }
+  }
+  *v = stk[0];
+  *w = wstk[0];
+  return 1;
+}
+
+/*
+ * Evaluate e using its compiled form c if there is one. With
+ * sim.chp.compiled_expr = 2, the result is checked against exprEval().
+ */
+BigInt ChpSim::_evalCode (struct chpsim_ecode *c, Expr *e)
+{
+  BigInt v;
+
+  /* external calls in e can be batched; see _extBatched() */
+  _ext_root = e;
+  _ext_pos = 0;
+  if (!c) {
+    v = exprEval (e);
+    _ext_root = NULL;
+    return v;
+  }
+  v = _ceval (c);
+  _ext_root = NULL;
+  if (_sc->chpExprMode() == 2) {
+    BigInt chk = exprEval (e);
+    if (chk != v || chk.getWidth() != v.getWidth()) {
+      msgPrefix (actsim_log_fp());
+      actsim_log ("** ERROR ** compiled expression mismatch (tree: ");
+      chk.decPrint (actsim_log_fp());
+      actsim_log (", compiled: ");
+      v.decPrint (actsim_log_fp());
+      actsim_log (")\n");
+      actsim_log_flush ();
+    }
+  }
+  return v;
+}
+
+/*
+ * Returns 1 if the guard is true, 0 otherwise.
+ */
+int ChpSim::_evalGuard (struct chpsimcond *gc)
+{
+  if (gc->code && gc->code->fast) {
+    unsigned long v;
+    int w;
+    if (_cevalFast (gc->code, &v, &w)) {
+      if (_sc->chpExprMode() == 2) {
+	BigInt chk = exprEval (gc->g);
+	if ((chk.getVal (0) != 0) != (v != 0)) {
+	  msgPrefix (actsim_log_fp());
+	  actsim_log ("** ERROR ** compiled guard mismatch (tree: ");
+	  chk.decPrint (actsim_log_fp());
+	  actsim_log (", compiled: %lu)\n", v);
+	  actsim_log_flush ();
+	}
+      }
+      return (v != 0) ? 1 : 0;
+    }
+  }
+  BigInt res = _evalCode (gc->code, gc->g);
+  return (res.getVal (0) != 0) ? 1 : 0;
+}
+
 expr_multires ChpSim::varStruct (struct chpsimderef *d)
 {
   expr_multires res (d->d);
@@ -3125,12 +4219,9 @@ expr_multires ChpSim::varStruct (struct chpsimderef *d)
  */
 expr_multires ChpSim::funcStruct (Function *f, int nargs, void **vargs)
 {
-  struct Hashtable *lstate;
-  hash_bucket_t *b;
-  BigInt *x;
-  expr_multires *xm;
+  struct chpsim_fn_layout *l;
+  struct chpsim_fn_frame *fr;
   expr_multires ret;
-  ActInstiter it(f->CurScope());
   InstType *ret_type = f->getRetType ();
   Data *d;
 
@@ -3138,89 +4229,41 @@ expr_multires ChpSim::funcStruct (Function *f, int nargs, void **vargs)
   d = dynamic_cast<Data *> (ret_type->BaseType());
   Assert (d, "What?");
   
-  /*-- allocate state and bindings --*/
-  lstate = hash_new (4);
-
-  for (it = it.begin(); it != it.end(); it++) {
-    ValueIdx *vx = (*it);
-    if (TypeFactory::isParamType (vx->t)) continue;
-
-    b = hash_add (lstate, vx->getName());
-    if (TypeFactory::isStructure (vx->t) || vx->t->arrayInfo()) {
-      expr_multires *x2;
-      Data *xd = dynamic_cast<Data *> (vx->t->BaseType());
-      x2 = new expr_multires (xd, vx->t->arrayInfo());
-      b->v = x2;
-      if (!xd) {
-	x2->setAllWidths (TypeFactory::bitWidth (vx->t));
-      }
-    }
-    else {
-      NEW (x, BigInt);
-      new (x) BigInt;
-      x->setVal (0,0);
-      x->setWidth (TypeFactory::bitWidth (vx->t));
-      x->toStatic ();
-      b->v = x;
-    }
-  }
-
   if (nargs != f->getNumPorts()) {
     fatal_error ("Function `%s': invalid number of arguments", f->getName());
   }
 
-  for (int i=0; i < f->getNumPorts(); i++) {
-    int w;
-    b = hash_lookup (lstate, f->getPortName (i));
-    Assert (b, "What?");
-
-    if (TypeFactory::isStructure (f->getPortType (i)) ||
-	f->getPortType (i)->arrayInfo()) {
-      xm = (expr_multires *)b->v;
-      *xm = *((expr_multires *)vargs[i]);
-    }
-    else {
-      x = (BigInt *) b->v;
-      w = x->getWidth ();
-      *x = *((BigInt *)vargs[i]);
-      x->setWidth (w);
-      x->toStatic ();
-    }
-  }
-
   /* --- run body -- */
   if (f->isExternal()) {
-    fatal_error ("External function cannot return a structure!");
+    EXTFUNC_BATCH extbatch = _ext_lookup (f)->b;
+    if (!extbatch) {
+      fatal_error ("External function `%s' returns a structure; this requires `%s%s' (see actsim_ext.h).", f->getName(), f->getName(), ACT_EXT_BATCH_SUFFIX);
+    }
+    expr_multires tmp (d, NULL);
+    _ext_call_batch (extbatch, f, 1, nargs, &vargs, tmp.nvals, tmp.v);
+    return tmp;
   }
+
+  /*-- get a frame and bind arguments --*/
+  l = _getFnLayout (f, 1);
+  fr = _allocFrame (l);
+  _bind_fn_args (f, l, fr, vargs);
   
   act_chp *c = f->getlang()->getchp();
   Scope *_tmp = _cureval;
-  stack_push (_statestk, lstate);
+  stack_push (_statestk, fr->H);
   _cureval = f->CurScope();
   _run_chp (f, c->c);
   _cureval = _tmp;
   stack_pop (_statestk);
 
-  /* -- return result -- */
-  b = hash_lookup (lstate, "self");
-  ret = *((expr_multires *)b->v);
-
-  //printf ("ret: %d, %p\n", ret.nvals, ret.v);
-
-  for (it = it.begin(); it != it.end(); it++) {
-    ValueIdx *vx = (*it);
-    if (TypeFactory::isParamType (vx->t)) continue;
+  /* -- return result -- */
+  Assert (l->self != -1 && l->multi[l->self], "What?");
+  ret = *((expr_multires *)fr->slot[l->self]);
 
-    b = hash_lookup (lstate, vx->getName());
-    if (TypeFactory::isStructure (vx->t) || vx->t->arrayInfo()) {
-      expr_multires *x2 = (expr_multires *)b->v;
-      delete x2;
-    }
-    else {
-      FREE (b->v);
-    }
-  }
-  hash_free (lstate);
+  //printf ("ret: %d, %p\n", ret.nvals, ret.v);
+
+  _releaseFrame (l, fr);
 
   return ret;
 }
@@ -4143,7 +5186,7 @@ int ChpSim::_structure_assign (struct chpsimderef *d, expr_multires *v, void *ca
 
 void ChpSim::boolProp (int glob_off)
 {
-  SimDES **arr;
+  ActSimDES **arr;
   arr = _sc->getFO (glob_off, 0);
 
 #ifdef DUMP_ALL
@@ -4151,9 +5194,9 @@ void ChpSim::boolProp (int glob_off)
   printf ("  >>> propagate %d\n", _sc->numFanout (glob_off, 0));
 #endif
 #endif
-  for (int i=0; i < _sc->numFanout (glob_off, 0); i++) {
-    ActSimDES *p = dynamic_cast<ActSimDES *>(arr[i]);
-    Assert (p, "What?");
+  int nfanout = _sc->numFanout (glob_off, 0);
+  for (int i=0; i < nfanout; i++) {
+    ActSimDES *p = arr[i];
 #ifdef DUMP_ALL
 #if 0
       printf ("   prop: ");
@@ -4180,7 +5223,7 @@ void ChpSim::boolProp (int glob_off)
 
 void ChpSim::intProp (int glob_off)
 {
-  SimDES **arr;
+  ActSimDES **arr;
   arr = _sc->getFO (glob_off, 1);
 
 #ifdef DUMP_ALL
@@ -4188,9 +5231,9 @@ void ChpSim::intProp (int glob_off)
   printf ("  >>> propagate %d\n", _sc->numFanout (glob_off, 0));
 #endif
 #endif
-  for (int i=0; i < _sc->numFanout (glob_off, 1); i++) {
-    ActSimDES *p = dynamic_cast<ActSimDES *>(arr[i]);
-    Assert (p, "What?");
+  int nfanout = _sc->numFanout (glob_off, 1);
+  for (int i=0; i < nfanout; i++) {
+    ActSimDES *p = arr[i];
 #ifdef DUMP_ALL
 #if 0
       printf ("   prop: ");
@@ -4231,23 +5274,22 @@ int ChpSim::_chkWatchBreakPt (int verb,
 			      void *cause,  int flag)
 {
   int ret_break = 0;
+  int pr;
   if (!verb) {
     return ret_break;
   }
+  /* quiet watchpoints (trace_all) are only recorded, not displayed */
+  pr = (verb & 1) && !nm->quiet;
   if (type == 0) {
     /* bool */
     int oval = _sc->getBool (goff);
     if (oval != v.getVal (0)) {
       if (verb & 1) {
-	msgPrefix ();
-	printf ("%s := %c", nm->s, (v.getVal (0) == 2 ? 'X' : ((char)v.getVal (0) + '0')));
-	if (cause) {
-	  char buf[1024];
-	  ActSimDES *x = (ActSimDES *) cause;
-	  x->sPrintCause (buf, 1024);
-	  printf ("   [by %s]", buf);
+	if (pr) {
+	  msgPrefix ();
+	  printf ("%s := %c", nm->s, (v.getVal (0) == 2 ? 'X' : ((char)v.getVal (0) + '0')));
+	  _printCause (cause);
 	}
-	printf ("\n");
 	_sc->recordTrace (nm, type, ACT_CHAN_IDLE, v);
       }
       if (verb & 2) {
@@ -4258,22 +5300,18 @@ int ChpSim::_chkWatchBreakPt (int verb,
     }
   }
   else if (type == 1) {
-    BigInt *otmp = _sc->getInt (goff);
-    if (*otmp != v) {
+    BigInt otmp = _sc->getInt (goff);
+    if (otmp != v) {
       if (verb & 1) {
-	msgPrefix ();
-	printf ("%s := ", nm->s);
-	v.decPrint (stdout);
-	printf (" (0x");
-	v.hexPrint (stdout);
-	printf (")");
-	if (cause) {
-	  char buf[1024];
-	  ActSimDES *x = (ActSimDES *) cause;
-	  x->sPrintCause (buf, 1024);
-	  printf ("   [by %s]", buf);
+	if (pr) {
+	  msgPrefix ();
+	  printf ("%s := ", nm->s);
+	  v.decPrint (stdout);
+	  printf (" (0x");
+	  v.hexPrint (stdout);
+	  printf (")");
+	  _printCause (cause);
 	}
-	printf ("\n");
 	_sc->recordTrace (nm, type, ACT_CHAN_IDLE, v);
       }
       if (verb & 2) {
@@ -4291,33 +5329,37 @@ int ChpSim::_chkWatchBreakPt (int verb,
     if (verb & 1) {
       int umode;
       umode = (flag >> 1);
-      msgPrefix();
-      printf ("%s: recv", nm->s);
+      if (pr) {
+	msgPrefix();
+	printf ("%s: recv", nm->s);
+      }
 
       if (umode == 1) {
-	printf ("-blocked");
+	if (pr) {
+	  printf ("-blocked");
+	}
 	_sc->recordTrace (nm, 2, ACT_CHAN_RECV_BLOCKED, v);
       }
       else if (umode == 0 || umode == 2) {
 	if (umode == 2) {
-	  printf ("-wakeup");
+	  if (pr) {
+	    printf ("-wakeup");
+	  }
 	}
         else {
 	  _sc->recordTrace (nm, 2, ACT_CHAN_VALUE, v);
         }
-	printf (" value: ");
-	v.decPrint (stdout);
-	printf (" (0x");
-	v.hexPrint (stdout);
-	printf (")");
-      }
-      if (cause) {
-	char buf[1024];
-	ActSimDES *x = (ActSimDES *) cause;
-	x->sPrintCause (buf, 1024);
-	printf ("   [by %s]", buf);
+	if (pr) {
+	  printf (" value: ");
+	  v.decPrint (stdout);
+	  printf (" (0x");
+	  v.hexPrint (stdout);
+	  printf (")");
+	}
+      }
+      if (pr) {
+	_printCause (cause);
       }
-      printf ("\n");
     }
     if (verb & 2) {
       msgPrefix ();
@@ -4331,47 +5373,41 @@ int ChpSim::_chkWatchBreakPt (int verb,
     */
     if (verb & 1) {
       int umode;
-      msgPrefix ();
+      if (pr) {
+	msgPrefix ();
+      }
       umode = (flag >> 1);
       if (umode == 0 || umode == 1) {
-	printf ("%s : send%s", nm->s, umode == 1 ? "-blocked" : "");
-	if (!(flag & 1)) {
-	  /* not fragmented, display value */
-	  printf (" value: ");
-	  v.decPrint (stdout);
-	  printf (" (0x");
-	  v.hexPrint (stdout);
-	  printf (")");
-	}
-	if (cause) {
-	  char buf[1024];
-	  ActSimDES *x = (ActSimDES *) cause;
-	  x->sPrintCause (buf, 1024);
-	  printf ("   [by %s]", buf);
+	if (pr) {
+	  printf ("%s : send%s", nm->s, umode == 1 ? "-blocked" : "");
+	  if (!(flag & 1)) {
+	    /* not fragmented, display value */
+	    printf (" value: ");
+	    v.decPrint (stdout);
+	    printf (" (0x");
+	    v.hexPrint (stdout);
+	    printf (")");
+	  }
+	  _printCause (cause);
 	}
-	printf ("\n");
 	if (umode == 1) {
 	  _sc->recordTrace (nm, 2, ACT_CHAN_SEND_BLOCKED, v);
 	  ChanTraceDelayed *obj = new ChanTraceDelayed (nm, v);
-	  new Event (obj, SIM_EV_MKTYPE (0, 0), 1);
+	  ActSimEvents::mk (obj, SIM_EV_MKTYPE (0, 0), 1);
 	}
 	else {
 	  _sc->recordTrace (nm, 2, ACT_CHAN_VALUE, v);
 	  ChanTraceDelayed *obj = new ChanTraceDelayed (nm);
-	  new Event (obj, SIM_EV_MKTYPE (0, 0), 1);
+	  ActSimEvents::mk (obj, SIM_EV_MKTYPE (0, 0), 1);
 	}
       }
       else {
 	ChanTraceDelayed *obj = new ChanTraceDelayed (nm);
-	new Event (obj, SIM_EV_MKTYPE (0, 0), 1);
-	printf ("%s : send complete", nm->s);
-	if (cause) {
-	  char buf[1024];
-	  ActSimDES *x = (ActSimDES *) cause;
-	  x->sPrintCause (buf, 1024);
-	  printf ("   [by %s]", buf);
+	ActSimEvents::mk (obj, SIM_EV_MKTYPE (0, 0), 1);
+	if (pr) {
+	  printf ("%s : send complete", nm->s);
+	  _printCause (cause);
 	}
-	printf ("\n");
       }
 	
       if (verb & 2) {
@@ -4384,6 +5420,18 @@ int ChpSim::_chkWatchBreakPt (int verb,
   return ret_break;
 }
 
+/* print "[by <cause>]" if there is a cause, and end the line */
+void ChpSim::_printCause (void *cause)
+{
+  if (cause) {
+    char buf[1024];
+    ActSimDES *x = (ActSimDES *) cause;
+    x->sPrintCause (buf, 1024);
+    printf ("   [by %s]", buf);
+  }
+  printf ("\n");
+}
+
 
 
 /*
@@ -4400,6 +5448,9 @@ int ChpSim::chkWatchBreakPt (int type, int loff, int goff, const BigInt& v,
   int verb = 0;
   const ActSim::watchpt_bucket *nm;
   const char *nm2;
+  if (!_sc->isObserved (type, goff)) {
+    return 0;
+  }
   if ((nm = _sc->chkWatchPt (type == 3 ? 2 : type, goff))) {
     verb = 1;
   }
@@ -4424,6 +5475,9 @@ int ChpSim::chkWatchBreakPt (int type, int loff, int goff, const expr_multires&
   int ret_break = 0;
   const ActSim::watchpt_bucket *nm;
   const char *nm2;
+  if (!_sc->isObserved (type, goff)) {
+    return ret_break;
+  }
   if ((nm = _sc->chkWatchPt (type == 3 ? 2 : type, goff))) {
     verb = 1;
   }
@@ -4614,6 +5668,308 @@ void ChpSim::_zeroAllIntsChans (ChpSimGraph *g)
 
 
 
+void ChpSim::usedChannels (struct iHashtable *chans)
+{
+  if (_pc) {
+    _usedChannels (_g0, chans);
+    _clrhash ();
+  }
+}
+
+void ChpSim::_usedChannels (ChpSimGraph *g, struct iHashtable *chans)
+{
+  int cnt;
+  
+  if (!g || (!g->stmt && !g->next)) {
+    return;
+  }
+  if (_addhash (g)) {
+    return;
+  }
+  while (g && !g->stmt) {
+    g = g->next;
+  }
+  if (!g) {
+    return;
+  }
+
+  switch (g->stmt->type) {
+  case CHPSIM_FORK:
+    for (int i=0; i < g->stmt->u.fork; i++) {
+      if (g->all[i]) {
+	_usedChannels (g->all[i], chans);
+      }
+    }
+    break;
+
+  case CHPSIM_SEND:
+  case CHPSIM_RECV:
+    {
+      int off = getGlobalOffset (g->stmt->u.sendrecv.chvar, 2);
+      if (!ihash_lookup (chans, off)) {
+	ihash_add (chans, off);
+      }
+    }
+    break;
+
+  case CHPSIM_COND:
+  case CHPSIM_CONDARB:
+  case CHPSIM_LOOP:
+    cnt = 0;
+    for (struct chpsimcond *x = &g->stmt->u.cond.c; x; x = x->next) {
+      _usedChannels (g->all[cnt], chans);
+      cnt++;
+    }
+    break;
+
+  default:
+    break;
+  }
+  _usedChannels (g->next, chans);
+}
+
+
+/*-- checkpoint support --*/
+
+void ChpSim::_enumGraph (ChpSimGraph *g, struct pHashtable *H, list_t *l)
+{
+  phash_bucket_t *b;
+  int cnt;
+  
+  while (g) {
+    if (phash_lookup (H, g)) {
+      return;
+    }
+    b = phash_add (H, g);
+    b->i = list_length (l);
+    list_append (l, g);
+
+    if (g->stmt) {
+      switch (g->stmt->type) {
+      case CHPSIM_FORK:
+	for (int i=0; i < g->stmt->u.fork; i++) {
+	  _enumGraph (g->all[i], H, l);
+	}
+	break;
+
+      case CHPSIM_COND:
+      case CHPSIM_CONDARB:
+      case CHPSIM_LOOP:
+	cnt = 0;
+	for (struct chpsimcond *x = &g->stmt->u.cond.c; x; x = x->next) {
+	  _enumGraph (g->all[cnt], H, l);
+	  cnt++;
+	}
+	break;
+
+      default:
+	break;
+      }
+    }
+    g = g->next;
+  }
+}
+
+/* 
+   Number the nodes of the simulation graph in a fixed order. Returns
+   the array of nodes, and the node -> index map in *H.
+*/
+ChpSimGraph **ChpSim::_graphNodes (struct pHashtable **H, int *n)
+{
+  ChpSimGraph **nodes;
+  list_t *l = list_new ();
+  listitem_t *li;
+  int i;
+
+  *H = phash_new (16);
+  _enumGraph (_g0, *H, l);
+  *n = list_length (l);
+  if (*n > 0) {
+    MALLOC (nodes, ChpSimGraph *, *n);
+  }
+  else {
+    nodes = NULL;
+  }
+  i = 0;
+  for (li = list_first (l); li; li = list_next (li)) {
+    nodes[i++] = (ChpSimGraph *) list_value (li);
+  }
+  list_free (l);
+  return nodes;
+}
+
+void ChpSim::saveState (FILE *fp)
+{
+  struct pHashtable *H;
+  ChpSimGraph **nodes;
+  int n;
+
+  actsim_write_u32 (fp, _npc);
+  if (_npc > 0) {
+    nodes = _graphNodes (&H, &n);
+    actsim_write_u32 (fp, n);
+    actsim_write_u32 (fp, _pcused);
+    for (int i=0; i < _npc; i++) {
+      int idx = -1;
+      if (_pc[i]) {
+	phash_bucket_t *b = phash_lookup (H, _pc[i]);
+	Assert (b, "Program counter not in the simulation graph?");
+	idx = b->i;
+      }
+      actsim_write_u32 (fp, idx);
+    }
+    for (int i=0; i < _npc; i++) {
+      actsim_write_u32 (fp, _holes[i]);
+    }
+    actsim_write_u32 (fp, _maxcnt);
+    for (int i=0; i < _maxcnt; i++) {
+      actsim_write_u32 (fp, _tot[i]);
+    }
+    phash_free (H);
+    if (nodes) {
+      FREE (nodes);
+    }
+  }
+  actsim_write_u32 (fp, _maxstats);
+  for (int i=0; i < _maxstats; i++) {
+    actsim_write_u64 (fp, _stats[i]);
+  }
+  actsim_write_u64 (fp, _energy_cost);
+}
+
+void ChpSim::restoreState (FILE *fp)
+{
+  struct pHashtable *H;
+  ChpSimGraph **nodes;
+  int n, m;
+
+  m = actsim_read_u32 (fp);
+  if (m != _npc) {
+    fatal_error ("checkpoint: CHP program counter mismatch");
+  }
+  if (_npc > 0) {
+    nodes = _graphNodes (&H, &n);
+    m = actsim_read_u32 (fp);
+    if (m != n) {
+      fatal_error ("checkpoint: CHP program mismatch");
+    }
+    _pcused = actsim_read_u32 (fp);
+    for (int i=0; i < _npc; i++) {
+      int idx = actsim_read_u32 (fp);
+      if (idx < -1 || idx >= n) {
+	fatal_error ("checkpoint: corrupt program counter");
+      }
+      _pc[i] = (idx == -1 ? NULL : nodes[idx]);
+    }
+    for (int i=0; i < _npc; i++) {
+      _holes[i] = actsim_read_u32 (fp);
+    }
+    m = actsim_read_u32 (fp);
+    if (m != _maxcnt) {
+      fatal_error ("checkpoint: CHP program mismatch");
+    }
+    for (int i=0; i < _maxcnt; i++) {
+      _tot[i] = actsim_read_u32 (fp);
+    }
+    phash_free (H);
+    if (nodes) {
+      FREE (nodes);
+    }
+  }
+  m = actsim_read_u32 (fp);
+  if (m != _maxstats) {
+    fatal_error ("checkpoint: CHP statistics mismatch");
+  }
+  for (int i=0; i < _maxstats; i++) {
+    _stats[i] = actsim_read_u64 (fp);
+  }
+  _energy_cost = actsim_read_u64 (fp);
+}
+
+void ChpSim::detachWaits ()
+{
+  struct iHashtable *H;
+  ihash_bucket_t *b;
+  ihash_iter_t it;
+
+  while (sWaiting ()) {
+    sRemove ();
+  }
+  list_free (_stalled_pc);
+  _stalled_pc = list_new ();
+  if (_deadlock_pc) {
+    list_free (_deadlock_pc);
+    _deadlock_pc = NULL;
+  }
+  if (!_pc) {
+    return;
+  }
+
+  H = ihash_new (4);
+  usedChannels (H);
+  ihash_iter_init (H, &it);
+  while ((b = ihash_iter_next (H, &it))) {
+    act_channel_state *c = _sc->getChan (b->key);
+    if (c->w->isWaiting (this)) {
+      c->w->DelObject (this);
+    }
+    if (c->probe && c->probe->isWaiting (this)) {
+      c->probe->DelObject (this);
+    }
+  }
+  ihash_free (H);
+}
+
+void ChpSim::restoreWaits (bitset_t *sched)
+{
+  for (int pc=0; pc < _npc; pc++) {
+    if (!_pc[pc] || (sched && bitset_tst (sched, pc))) {
+      continue;
+    }
+    chpsimstmt *stmt = _pc[pc]->stmt;
+    if (stmt && (stmt->type == CHPSIM_SEND || stmt->type == CHPSIM_RECV)) {
+      int off = getGlobalOffset (stmt->u.sendrecv.chvar, 2);
+      act_channel_state *c = _sc->getChan (off);
+      if ((WAITING_SENDER (c) && c->send_here == pc+1) ||
+	  (WAITING_RECEIVER (c) && c->recv_here == pc+1)) {
+	if (!c->w->isWaiting (this)) {
+	  c->w->AddObject (this);
+	}
+	continue;
+      }
+    }
+    if (stmt && (stmt->type == CHPSIM_COND || stmt->type == CHPSIM_CONDARB)) {
+      chpsimcond *gc;
+      for (gc = &stmt->u.cond.c; gc; gc = gc->next) {
+	if (gc->g && _evalGuard (gc)) {
+	  break;
+	}
+      }
+      if (gc) {
+	/* the shared-variable wake-up was pending at the checkpoint */
+	ActSimEvents::mkWakeup (this, SIM_EV_MKTYPE (pc, 1), 0);
+      }
+      else if (_add_waitcond (&stmt->u.cond.c, pc) ||
+	       stmt->u.cond.is_shared) {
+	sStall ();
+	list_iappend (_stalled_pc, pc);
+      }
+      else if (!_probe) {
+	/* no probes or shared variables: only gc-retry wakes it up */
+	if (!_deadlock_pc) {
+	  _deadlock_pc = list_new ();
+	}
+	list_iappend (_deadlock_pc, pc);
+      }
+      continue;
+    }
+    msgPrefix (actsim_log_fp());
+    actsim_log ("Warning: restore: thread %d is neither scheduled nor blocked\n", pc);
+    actsim_log_flush ();
+  }
+}
+
+
 void ChpSim::awakenDeadlockedGC ()
 {
   if (_deadlock_pc) {
@@ -4621,7 +5977,7 @@ void ChpSim::awakenDeadlockedGC ()
     while (!list_isempty (_deadlock_pc)) {
       x = list_delete_ihead (_deadlock_pc);
       if (_pc[x]) {
-	new Event (this, SIM_EV_MKTYPE (x,0), 0);
+	ActSimEvents::mk (this, SIM_EV_MKTYPE (x,0), 0);
       }
     }
   }
@@ -4698,3 +6054,140 @@ int ChpSim::jumpTo (const char *l)
   _pc[slot] = (ChpSimGraph *) b->v;
   return 1;
 }
+
+
+/*------------------------------------------------------------------------
+ *
+ *  CHP run queue
+ *
+ *------------------------------------------------------------------------
+ */
+ChpSimRunQueue::ChpSimRunQueue ()
+{
+  A_INIT (_heap);
+  _seq = 0;
+  _next = 0;
+  _ev = NULL;
+  _nrun = 0;
+}
+
+ChpSimRunQueue::~ChpSimRunQueue ()
+{
+  A_FREE (_heap);
+}
+
+static inline bool _rq_before (const struct chpsim_rq_entry *a,
+			       const struct chpsim_rq_entry *b)
+{
+  return (a->t < b->t) || (a->t == b->t && a->seq < b->seq);
+}
+
+void ChpSimRunQueue::_push (struct chpsim_rq_entry *e)
+{
+  int i, p;
+
+  A_NEW (_heap, struct chpsim_rq_entry);
+  i = A_LEN (_heap);
+  A_INC (_heap);
+  while (i > 0) {
+    p = (i-1)/2;
+    if (!_rq_before (e, &_heap[p])) {
+      break;
+    }
+    _heap[i] = _heap[p];
+    i = p;
+  }
+  _heap[i] = *e;
+}
+
+void ChpSimRunQueue::_pop ()
+{
+  struct chpsim_rq_entry last;
+  int i, c, n;
+
+  Assert (A_LEN (_heap) > 0, "Pop from empty run queue");
+  n = A_LEN (_heap) - 1;
+  last = _heap[n];
+  A_LEN_RAW (_heap) = n;
+  i = 0;
+  while ((c = 2*i+1) < n) {
+    if (c+1 < n && _rq_before (&_heap[c+1], &_heap[c])) {
+      c++;
+    }
+    if (!_rq_before (&_heap[c], &last)) {
+      break;
+    }
+    _heap[i] = _heap[c];
+    i = c;
+  }
+  if (n > 0) {
+    _heap[i] = last;
+  }
+}
+
+/*
+ * Make sure the global event queue has exactly one event for us, due
+ * at time t.
+ */
+void ChpSimRunQueue::_arm (unsigned long t)
+{
+  if (_ev) {
+    ActSimEvents::cancel (_ev);
+  }
+  _ev = ActSimEvents::mk (this, 0, t - SimDES::CurTimeLo ());
+  _next = t;
+}
+
+void ChpSimRunQueue::schedule (ChpSim *c, int type, int delay)
+{
+  struct chpsim_rq_entry e;
+
+  e.t = SimDES::CurTimeLo () + delay;
+  e.seq = _seq++;
+  e.c = c;
+  e.type = type;
+  _push (&e);
+  if (!_ev || e.t < _next) {
+    _arm (e.t);
+  }
+}
+
+int ChpSimRunQueue::Step (Event *ev)
+{
+  unsigned long now = SimDES::CurTimeLo ();
+
+  ActSimEvents::fire ();
+
+  /* entries scheduled while we run are due at now or later, so the
+     outstanding event must not be re-armed in the middle of the loop */
+  _ev = ev;
+  _next = now;
+  while (A_LEN (_heap) > 0 && _heap[0].t <= now) {
+    struct chpsim_rq_entry e = _heap[0];
+    _pop ();
+    _nrun++;
+    if (ActSimProfile::on ()) {
+      ActSimProfile::enter (e.c);
+    }
+    if (!e.c->_step (e.type, NULL)) {
+      /* breakpoint: the rest of this time step runs when we resume */
+      _ev = NULL;
+      _arm (now);
+      return 0;
+    }
+  }
+  _ev = NULL;
+  if (A_LEN (_heap) > 0) {
+    _arm (_heap[0].t);
+  }
+  return 1;
+}
+
+void ChpSimRunQueue::clear ()
+{
+  if (_ev) {
+    ActSimEvents::cancel (_ev);
+    _ev = NULL;
+  }
+  A_LEN_RAW (_heap) = 0;
+}
@@ -29,8 +29,40 @@
 
 /*--- CHP simulation data structures ---*/
 
+/*
+ * Compiled expressions: a postfix program over a value stack. Operators
+ * use the Expr type (E_AND, etc.); leaves and control flow use the
+ * CHPSIM_EOP_ codes below. Sub-expressions that are not compiled are
+ * evaluated with exprEval() via CHPSIM_EOP_TREE.
+ */
+#define CHPSIM_EOP_CONST    -1	/* constant v, width w */
+#define CHPSIM_EOP_BIGCONST -2	/* wide constant in e */
+#define CHPSIM_EOP_VARBOOL  -3	/* Boolean variable x */
+#define CHPSIM_EOP_VARINT   -4	/* integer variable x, width w */
+#define CHPSIM_EOP_TREE     -5	/* exprEval (e) */
+#define CHPSIM_EOP_JZ       -6	/* pop; jump to x if zero */
+#define CHPSIM_EOP_JMP      -7	/* jump to x */
+
+#define CHPSIM_ESTACK 8		/* deeper expressions allocate their stack */
+
+struct chpsim_eop {
+  int type;
+  int w;			/* width; -1 if not known */
+  int x;			/* variable or jump target */
+  unsigned long v;		/* constant value */
+  Expr *e;
+};
+
+struct chpsim_ecode {
+  int n;			/* # of operations */
+  int depth;			/* max stack depth */
+  unsigned int fast:1;		/* can use the 64-bit evaluator */
+  struct chpsim_eop *op;
+};
+
 struct chpsimcond {
   Expr *g;
+  struct chpsim_ecode *code;	/* compiled guard, if any */
   struct chpsimcond *next;
 };
 
@@ -100,7 +132,10 @@ struct chpsimstmt {
 				   */
       unsigned int is_struct:1;	// 1 if structure, 0 otherwise
       unsigned int is_int:1;	/* 1 if int, 0 if bool */
+      unsigned int is_local:1;	/* 1 if only local variables are used,
+				   so the statement can be coalesced */
       Expr *e;
+      struct chpsim_ecode *code; /* compiled e, if any */
       struct chpsimderef d;	/* variable deref */
     } assign;			/* var := e */
     struct {
@@ -113,6 +148,7 @@ struct chpsimstmt {
 				 // 2 if bidir and struct
       int width;		 // channel width
       Expr *e;			// outgoing expression, if any
+      struct chpsim_ecode *code; // compiled e, if any
       struct chpsimderef *d;	// variable, if any
     } sendrecv;
   } u;
@@ -162,6 +198,8 @@ class ChpSimGraph {
   void printStmt (FILE *fp, Process *p);
 
   static chpsimgraph_info *buildChpSimGraph (ActSimCore *, act_chp_lang_t *);
+  static struct chpsim_ecode *compileExpr (ActSimCore *, Expr *);
+  static void freeExpr (struct chpsim_ecode *);
   static int max_pending_count;
   static int max_stats;
   static struct Hashtable *labels;
@@ -185,6 +223,29 @@ private:
 
 /* --- each unique instance has a ChpSim object associated with it --- */
 
+/*
+ * Local state for a CHP function call. The layout (one slot per
+ * non-parameter instance in the function scope) is computed once per
+ * function; frames are recycled through a free list so that repeated
+ * calls do not allocate. Recursive calls use separate frames.
+ */
+struct chpsim_fn_frame {
+  struct Hashtable *H;		/* name -> slot value, used by the body */
+  void **slot;			/* BigInt * or expr_multires * */
+  struct chpsim_fn_frame *next;	/* free list */
+};
+
+struct chpsim_fn_layout {
+  int nslots;
+  const char **name;		/* slot names */
+  unsigned char *multi;		/* 1 if slot is an expr_multires */
+  unsigned char *isport;	/* 1 if slot is a port */
+  void **init;			/* initial value for each slot */
+  int *port;			/* port i -> slot */
+  int self;			/* slot for the return value, -1 if none */
+  struct chpsim_fn_frame *free;	/* frames not in use */
+};
+
 class ChpSim : public ActSimObj {
  public:
   ChpSim (chpsimgraph_info *, act_chp_lang_t *, ActSimCore *sim, Process *p);
@@ -192,6 +253,8 @@ class ChpSim : public ActSimObj {
   ~ChpSim ();
 
   int Step (Event *ev);		/* run a step of the simulation */
+  int _step (int ev_type, void *cause); /* body of Step(); also called
+					   from the CHP run queue */
 
   void reStart (ChpSimGraph *g, int maxcnt);
   
@@ -226,6 +289,23 @@ class ChpSim : public ActSimObj {
   void setHseMode() { _hse_mode = 1; }
   int isHseMode() { return _hse_mode; }
 
+  /* add the global offset of every channel used to chans */
+  void usedChannels (struct iHashtable *chans);
+
+  /*
+    Checkpoint support. Program counters are saved as indices into
+    the simulation graph. detachWaits() removes this process from all
+    wait lists before a restore; restoreWaits() re-registers the
+    program counters that are blocked on a channel or a guard (those
+    not in sched); a guard that is already true gets the wake-up it
+    was waiting for.
+  */
+  void saveState (FILE *fp);
+  void restoreState (FILE *fp);
+  void detachWaits ();
+  void restoreWaits (bitset_t *sched);
+  int numPCs () { return _npc; }
+
   void sPrintCause (char *buf, int sz) {
     if (_npc == 0) {
       snprintf (buf, sz, "chan-method");
@@ -243,6 +323,8 @@ class ChpSim : public ActSimObj {
   struct Hashtable *_labels;	/* label map */
   
   ChpSimGraph **_pc;		/* current PC state of simulation */
+  ChpSimGraph *_g0;		/* start of the program */
+  int _maxcnt;			/* size of the _tot array */
   int *_holes;			/* available slots in the _pc array */
   int *_tot;			/* current pending concurrent count */
 
@@ -262,8 +344,26 @@ class ChpSim : public ActSimObj {
   void _compute_used_variables_helper (Expr *e);
   struct iHashtable *_tmpused;
 
+  /* zero-delay local assignments that may be coalesced in this
+     instance: statement -> 1 if no other process reads any of its
+     variables */
+  struct pHashtable *_coal_ok;
+  int _coalesce_ok (struct chpsimstmt *stmt);
+  int _private_var (int loc, int type);
+  int _private_expr (Expr *e);
+
+  /* channel payload buffers; these are swapped with the channel
+     state, so steady-state transfers do not allocate */
+  expr_multires _vs, _xchg;
+
   list_t *_statestk;
   Scope *_cureval;
+  struct iHashtable *_fnlayout;	// Function -> chpsim_fn_layout
+
+  struct chpsim_fn_layout *_getFnLayout (Function *f, int is_struct);
+  struct chpsim_fn_frame *_allocFrame (struct chpsim_fn_layout *l);
+  void _releaseFrame (struct chpsim_fn_layout *l, struct chpsim_fn_frame *fr);
+  void _freeFnLayouts ();
   act_channel_state *_frag_ch;	// fragmented channel
 
 
@@ -271,6 +371,18 @@ class ChpSim : public ActSimObj {
   int _maxstats;
   int _hse_mode;		// is this a HSE?
 
+  Expr *_ext_root;		// expression being evaluated by _evalCode()
+  int _ext_pos;			// next batched external call result
+  expr_multires _ext_ret;	// results of the batched external calls
+  int _extBatched (Expr *e, BigInt *res);
+
+  BigInt _ceval (struct chpsim_ecode *c);
+  int _cevalFast (struct chpsim_ecode *c, unsigned long *v, int *w);
+  int _cevalFast (struct chpsim_ecode *c, unsigned long *v, int *w,
+		  unsigned long *stk, int *wstk);
+  BigInt _evalCode (struct chpsim_ecode *c, Expr *e);
+  int _evalGuard (struct chpsimcond *gc);
+  
   BigInt funcEval (Function *, int, void **);
   BigInt varEval (int id, int type);
   expr_multires varChanEvalStruct (int id, int type);
@@ -303,6 +415,7 @@ class ChpSim : public ActSimObj {
 
   int _chkWatchBreakPt (int verb, const ActSim::watchpt_bucket *nm,
 			const char *nm2, int type, int loff, int goff, const BigInt &v, void *cause, int flag = 0);
+  void _printCause (void *cause);
 
   int _updatepc (int pc);
   int _add_waitcond (chpsimcond *gc, int pc, int undo = 0);
@@ -311,10 +424,66 @@ class ChpSim : public ActSimObj {
 
   int _nextEvent (int pc, int bw_delay);
   void _initEvent ();
+  void _schedule (int type, int delay);
+  int _assign (chpsimstmt *stmt, void *cause);
   void _zeroAllIntsChans (ChpSimGraph *g);
+  void _usedChannels (ChpSimGraph *g, struct iHashtable *chans);
+  void _enumGraph (ChpSimGraph *g, struct pHashtable *H, list_t *l);
+  ChpSimGraph **_graphNodes (struct pHashtable **H, int *n);
   void _zeroStructure (struct chpsimderef *d);
 
 };
 
 
+/*
+  Run queue for CHP-only designs (sim.chp.run_queue = 1).
+
+  Process steps are kept in a binary heap ordered by (time, sequence
+  number) instead of being allocated as individual events in the
+  global event queue. The run queue itself has at most one event
+  outstanding in the global queue: when it fires, every entry that is
+  due at the current time is executed, and the event is re-armed for
+  the next entry. Entries at the same time are executed in the order
+  they were scheduled.
+*/
+struct chpsim_rq_entry {
+  unsigned long t;		/* absolute time (low word) */
+  unsigned long seq;		/* tie-breaker: FIFO order */
+  ChpSim *c;			/* process */
+  int type;			/* event type (pc + flags) */
+};
+
+class ChpSimRunQueue : public ActSimDES {
+ public:
+  ChpSimRunQueue ();
+  ~ChpSimRunQueue ();
+
+  void schedule (ChpSim *c, int type, int delay);
+  int Step (Event *ev);
+
+  /* entries, in heap order; used by checkpoint and pending */
+  int length () { return A_LEN (_heap); }
+  const struct chpsim_rq_entry *entry (int i) { return &_heap[i]; }
+
+  void clear ();		/* drop all entries (restore) */
+
+  void sPrintCause (char *buf, int sz) {
+    snprintf (buf, sz, "chp-run-queue");
+  }
+
+  unsigned long numRun () { return _nrun; }
+
+ private:
+  A_DECL (struct chpsim_rq_entry, _heap);
+  unsigned long _seq;		/* next sequence number */
+  unsigned long _next;		/* time of the outstanding event */
+  Event *_ev;			/* outstanding event, if any */
+  unsigned long _nrun;		/* # of entries executed */
+
+  void _push (struct chpsim_rq_entry *e);
+  void _pop ();
+  void _arm (unsigned long t);
+};
+
+
 #endif /* __ACT_CHP_SIM_H__ */
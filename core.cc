@@ -23,6 +23,8 @@
 #include "chpsim.h"
 #include "prssim.h"
 #include "xycesim.h"
+#include "tracewr.h"
+#include "nattrace.h"
 #include <time.h>
 #include <math.h>
 #include <ctype.h>
@@ -121,6 +123,16 @@ ActSimCore::ActSimCore (Process *p, SDF *sdf)
     _trfn[i] = NULL;
     _tr[i] = NULL;
   }
+  _trw = NULL;
+  _ntr = NULL;
+  _tr_tm = NULL;
+  _tr_tmsz = 0;
+  _tr_tmlen = 0;
+  _tr_tmlo = 0;
+  _tr_tmvalid = 0;
+  _tr_ftm = 0;
+  _tr_val = NULL;
+  _tr_valsz = 0;
   
   _black_box_mode = config_get_int ("net.black_box_mode");
 
@@ -208,7 +220,7 @@ ActSimCore::ActSimCore (Process *p, SDF *sdf)
 
   if (nfo_len > 0) {
     MALLOC (nfo, int, nfo_len);
-    MALLOC (fo, SimDES **, nfo_len);
+    MALLOC (fo, ActSimDES **, nfo_len);
     for (int i=0; i < nfo_len; i++) {
       nfo[i] = 0;
       fo[i] = NULL;
@@ -219,6 +231,8 @@ ActSimCore::ActSimCore (Process *p, SDF *sdf)
     fo = NULL;
   }
   hfo = NULL;
+  fo_idx = NULL;
+  fo_csr = NULL;
 
   _seed = 0;
   _rand_min = 1;
@@ -236,12 +250,47 @@ ActSimCore::ActSimCore (Process *p, SDF *sdf)
 
   _W = ihash_new (4);
   _B = ihash_new (4);
+  _obs[0] = bitset_new (state->numBools() > 0 ? state->numBools() : 1);
+  _obs[1] = bitset_new (state->numInts() > 0 ? state->numInts() : 1);
+  _obs[2] = bitset_new (state->numChans() > 0 ? state->numChans() : 1);
 
   _multi_driver = phash_new (4);
   _global_multi = NULL;
 
+  /* this has to be set before the prs objects are created */
+  _prs_compiled_eval = 1;
+  if (config_exists ("sim.prs.compiled_eval") &&
+      (config_get_int ("sim.prs.compiled_eval") == 0)) {
+    _prs_compiled_eval = 0;
+  }
+  _chp_expr_mode = 1;
+  if (config_exists ("sim.chp.compiled_expr")) {
+    int m = config_get_int ("sim.chp.compiled_expr");
+    _chp_expr_mode = (m < 0 ? 0 : (m > 2 ? 2 : m));
+  }
+  _chp_rq = NULL;
+  _n_non_chp = 0;
+  _chp_coalesce = 0;
+  if (config_exists ("sim.chp.coalesce")) {
+    _chp_coalesce = config_get_int ("sim.chp.coalesce");
+    if (_chp_coalesce < 0) {
+      _chp_coalesce = 0;
+    }
+  }
+
   _initSim();
 
+  /* the CHP run queue is only used when there is nothing but CHP */
+  if (config_exists ("sim.chp.run_queue") &&
+      config_get_int ("sim.chp.run_queue") == 1) {
+    if (_n_non_chp > 0) {
+      warning ("sim.chp.run_queue: design has %d non-CHP simulation object%s; using the event queue", _n_non_chp, _n_non_chp == 1 ? "" : "s");
+    }
+    else {
+      _chp_rq = new ChpSimRunQueue ();
+    }
+  }
+
   /* add in handlers for the exclhi/excllo directives in prs bodies */
   _register_prssim_with_excl (&I);
 
@@ -329,12 +378,22 @@ ActSimCore::~ActSimCore()
     phash_free (ewidths);
   }
 
+  if (_chp_rq) {
+    delete _chp_rq;
+  }
+
   if (state) {
     delete state;
   }
 
   /*-- fanout tables --*/
-  if (nfo) {
+  if (fo_idx) {
+    FREE (fo_idx);
+    if (fo_csr) {
+      FREE (fo_csr);
+    }
+  }
+  else if (nfo) {
     Assert (fo, "What?");
     for (int i=0; i < nfo_len; i++) {
       if (nfo[i] > 0) {
@@ -345,7 +404,11 @@ ActSimCore::~ActSimCore()
 	Assert (!fo[i], "Hmm");
       }
     }
+  }
+  if (fo) {
     FREE (fo);
+  }
+  if (nfo) {
     FREE (nfo);
   }
   if (hfo) {
@@ -355,6 +418,17 @@ ActSimCore::~ActSimCore()
   /*-- chp objects --*/
   list_free (_chp_sim_objects);
 
+  /*-- drain queued trace records before the watchpoints go away --*/
+  if (_trw) {
+    delete _trw;
+    _trw = NULL;
+  }
+  if (_ntr) {
+    _ntr->close ();
+    delete _ntr;
+    _ntr = NULL;
+  }
+
   ihash_bucket_t *b;
   ihash_iter_t it;
   ihash_iter_init (_W, &it);
@@ -367,6 +441,9 @@ ActSimCore::~ActSimCore()
     FREE (b->v);
   }
   ihash_free (_B);
+  for (int i=0; i < 3; i++) {
+    bitset_free (_obs[i]);
+  }
 
   /*-- instance tables --*/
   _delete_sim_objs (&I, 0);
@@ -377,6 +454,12 @@ ActSimCore::~ActSimCore()
       act_trace_close (_tr[i]);
     }
   }
+  if (_tr_tm) {
+    FREE (_tr_tm);
+  }
+  if (_tr_val) {
+    FREE (_tr_val);
+  }
 
   /*-- delete SDF, if it exists --*/
   if (_sdf) {
@@ -616,6 +699,7 @@ PrsSim *ActSimCore::_add_prs (act_prs *p)
   }
   
   /* need prs simulation graph */
+  _n_non_chp++;
   PrsSim *x = new PrsSim (pgi->prs, this, _curproc);
   x->setName (_curinst);
   x->setOffsets (&_curoffset);
@@ -630,6 +714,7 @@ PrsSim *ActSimCore::_add_prs (act_prs *p)
  */
 XyceSim *ActSimCore::_add_xyce ()
 {
+  _n_non_chp++;
   XyceSim *x = new XyceSim (this, _curproc);
   x->setName (_curinst);
   x->setOffsets (&_curoffset);
@@ -1904,8 +1989,14 @@ int ActSimCore::getLocalOffset (ActId *id, stateinfo_t *si, int *type, int *widt
 /*
  * Add fanout object
  */
-void ActSimCore::incFanout (int off, int type, SimDES *who)
+void ActSimCore::incFanout (int off, int type, ActSimDES *who)
 {
+  if (fo_idx) {
+    /* fanout added after the table was packed: go back to the
+       per-variable arrays; they are not packed again */
+    _unpackFanout ();
+  }
+  
   if (type == 0) {
     /* bool */
     Assert (off >=0 && off < nint_start, "What?");
@@ -1918,7 +2009,7 @@ void ActSimCore::incFanout (int off, int type, SimDES *who)
   
   if (nfo[off] == 0) {
     /* first entry! */
-    NEW (fo[off], SimDES *);
+    NEW (fo[off], ActSimDES *);
   }
   else if (nfo[off] >= 8) {
     for (int i=nfo[off]-1; i >= 0 && i >= nfo[off]-10; i--) {
@@ -1939,7 +2030,7 @@ void ActSimCore::incFanout (int off, int type, SimDES *who)
     }
     if (nfo[off] == b->i) {
       b->i = b->i*2;
-      REALLOC (fo[off], SimDES *, b->i);
+      REALLOC (fo[off], ActSimDES *, b->i);
     }
   }
   else {
@@ -1948,12 +2039,69 @@ void ActSimCore::incFanout (int off, int type, SimDES *who)
 	return;
       }
     }
-    REALLOC (fo[off], SimDES *, nfo[off]+1);
+    REALLOC (fo[off], ActSimDES *, nfo[off]+1);
   }
   fo[off][nfo[off]] = who;
   nfo[off]++;
 }
 
+/*
+ * Pack the per-variable fanout arrays into one CSR table so that the
+ * propagation loops walk a single contiguous array.
+ */
+void ActSimCore::_packFanout ()
+{
+  int tot = 0;
+
+  Assert (!fo_idx, "What?");
+  MALLOC (fo_idx, int, nfo_len+1);
+  for (int i=0; i < nfo_len; i++) {
+    fo_idx[i] = tot;
+    tot += nfo[i];
+  }
+  fo_idx[nfo_len] = tot;
+
+  if (tot > 0) {
+    MALLOC (fo_csr, ActSimDES *, tot);
+  }
+  else {
+    fo_csr = NULL;
+  }
+  for (int i=0; i < nfo_len; i++) {
+    for (int j=0; j < nfo[i]; j++) {
+      fo_csr[fo_idx[i]+j] = fo[i][j];
+    }
+    if (fo[i]) {
+      FREE (fo[i]);
+      fo[i] = NULL;
+    }
+  }
+  if (hfo) {
+    ihash_free (hfo);
+    hfo = NULL;
+  }
+}
+
+void ActSimCore::_unpackFanout ()
+{
+  Assert (fo_idx, "What?");
+  for (int i=0; i < nfo_len; i++) {
+    nfo[i] = fo_idx[i+1] - fo_idx[i];
+    if (nfo[i] > 0) {
+      MALLOC (fo[i], ActSimDES *, nfo[i]);
+      for (int j=0; j < nfo[i]; j++) {
+	fo[i][j] = fo_csr[fo_idx[i]+j];
+      }
+    }
+  }
+  FREE (fo_idx);
+  fo_idx = NULL;
+  if (fo_csr) {
+    FREE (fo_csr);
+    fo_csr = NULL;
+  }
+}
+
 
 
 /*------------------------------------------------------------------------
@@ -2148,28 +2296,83 @@ void ActSimCore::_add_hazard (int *ids, int sz)
  *------------------------------------------------------------------------
  */
 
+/*
+ * Scratch space for trace records, so that recording a change does
+ * not allocate. The time is converted once per timestep: simulation
+ * time never goes backward within a run, so an unchanged low word
+ * means an unchanged time.
+ */
+void ActSimCore::_traceTime ()
+{
+  unsigned long lo = SimDES::CurTimeLo ();
+  if (_tr_tmvalid && lo == _tr_tmlo) {
+    return;
+  }
+  BigInt tm = SimDES::CurTime();
+  _tr_tmlen = tm.getLen ();
+  if (_tr_tmlen > _tr_tmsz) {
+    if (_tr_tmsz == 0) {
+      MALLOC (_tr_tm, unsigned long, _tr_tmlen);
+    }
+    else {
+      REALLOC (_tr_tm, unsigned long, _tr_tmlen);
+    }
+    _tr_tmsz = _tr_tmlen;
+  }
+  for (int i=0; i < _tr_tmlen; i++) {
+    _tr_tm[i] = tm.getVal (i);
+  }
+  _tr_ftm = curTimeMetricUnits ();
+  _tr_tmlo = lo;
+  _tr_tmvalid = 1;
+}
+
+unsigned long *ActSimCore::_traceVal (int n)
+{
+  if (n > _tr_valsz) {
+    if (_tr_valsz == 0) {
+      MALLOC (_tr_val, unsigned long, n);
+    }
+    else {
+      REALLOC (_tr_val, unsigned long, n);
+    }
+    _tr_valsz = n;
+  }
+  return _tr_val;
+}
+
 void ActSimCore::recordTrace (const watchpt_bucket *w, int type, 
 			      act_chan_state_t state, const BigInt &val)
 {
+  if (w->nid >= 0 && _ntr) {
+    recordNativeTrace (w, type, state, val);
+  }
   if (w->ignore_fmt == ~0U) {
     return;
   }
-  
-  float cur_time = curTimeMetricUnits();
 
-  BigInt tm = SimDES::CurTime();
-  int len = tm.getLen();
-  unsigned long v;
-  unsigned long *ptm;
-  if (len == 1) {
-    v = tm.getVal (0);
-    ptm = &v;
-  }
-  else {
-    MALLOC (ptm, unsigned long, len);
-    for (int i=0; i < len; i++) {
-      ptm[i] = tm.getVal (i);
+  _traceTime ();
+
+  int len = _tr_tmlen;
+  unsigned long *ptm = _tr_tm;
+  float cur_time = _tr_ftm;
+
+  if (_trw) {
+    if (len == 1 &&
+	(type == 0 || ACT_TRACE_WIDE_NUM (val.getWidth()) <= 1)) {
+      actsim_trace_rec r;
+      r.w = w;
+      r.tm = ptm[0];
+      r.ftm = cur_time;
+      r.val = val.getVal (0);
+      r.type = type;
+      r.state = state;
+      _trw->push (&r);
+      return;
     }
+    /* too wide to queue: keep the output in order */
+    _trw->flush ();
+    _trw->noteSync ();
   }
   
   if (type == 0) {
@@ -2211,8 +2414,7 @@ void ActSimCore::recordTrace (const watchpt_bucket *w, int type,
       }
     }
     else {
-      unsigned long *valp;
-      MALLOC (valp, unsigned long, val.getLen());
+      unsigned long *valp = _traceVal (val.getLen());
       for (int i=0; i < val.getLen(); i++) {
 	valp[i] = val.getVal (i);
       }
@@ -2228,14 +2430,13 @@ void ActSimCore::recordTrace (const watchpt_bucket *w, int type,
 	  }
 	}
       }
-      FREE (valp);
     }
   }
   else if (type == 2) {
-    if (ACT_TRACE_WIDE_NUM (val.getWidth()) > 1) {
-      unsigned long *valp;
-      MALLOC (valp, unsigned long, ACT_TRACE_WIDE_NUM (val.getWidth()));
-      for (int i=0; i < ACT_TRACE_WIDE_NUM(val.getWidth()); i++) {
+    int nw = ACT_TRACE_WIDE_NUM (val.getWidth());
+    if (nw > 1) {
+      unsigned long *valp = _traceVal (nw);
+      for (int i=0; i < nw; i++) {
 	if (i < val.getLen()) {
 	  valp[i] = val.getVal (i);
 	}
@@ -2247,19 +2448,14 @@ void ActSimCore::recordTrace (const watchpt_bucket *w, int type,
 	if (!((w->ignore_fmt >> fmt) & 1)) {
 	  if (act_trace_has_alt (_trfn[fmt])) {
 	    act_trace_wide_chan_change_alt (_tr[fmt], w->node[fmt], len, ptm,
-					    state,
-					    ACT_TRACE_WIDE_NUM (val.getWidth()),
-					    valp);
+					    state, nw, valp);
 	  }
 	  else {
 	    act_trace_wide_chan_change (_tr[fmt], w->node[fmt], cur_time,
-					state,
-					ACT_TRACE_WIDE_NUM (val.getWidth()),
-					valp);
+					state, nw, valp);
 	  }
 	}
       }
-      FREE (valp);
     }
     else {
       for (int fmt = 0; fmt < TRACE_NUM_FORMATS; fmt++) {
@@ -2276,9 +2472,324 @@ void ActSimCore::recordTrace (const watchpt_bucket *w, int type,
       }
     }
   }
-  if (len > 1) {
-    FREE (ptm);
+}
+
+/*
+ * Called from the trace writer thread (or directly, if there is no
+ * writer) for a change whose time and value fit in one word.
+ */
+void ActSimCore::writeTraceRec (const actsim_trace_rec *r)
+{
+  const watchpt_bucket *w = r->w;
+  unsigned long v = r->val;
+
+  if (r->type == 0) {
+    if (v == 0) {
+      v = ACT_SIG_BOOL_FALSE;
+    }
+    else if (v == 1) {
+      v = ACT_SIG_BOOL_TRUE;
+    }
+    else if (v == 2) {
+      v = ACT_SIG_BOOL_X;
+    }
+  }
+  for (int fmt=0; fmt < TRACE_NUM_FORMATS; fmt++) {
+    if ((w->ignore_fmt >> fmt) & 1) {
+      continue;
+    }
+    if (r->type == 2) {
+      if (act_trace_has_alt (_trfn[fmt])) {
+	act_trace_chan_change_alt (_tr[fmt], w->node[fmt], 1,
+				   (unsigned long *)&r->tm,
+				   (act_chan_state_t) r->state, v);
+      }
+      else {
+	act_trace_chan_change (_tr[fmt], w->node[fmt], r->ftm,
+			       (act_chan_state_t) r->state, v);
+      }
+    }
+    else {
+      if (act_trace_has_alt (_trfn[fmt])) {
+	act_trace_digital_change_alt (_tr[fmt], w->node[fmt], 1,
+				      (unsigned long *)&r->tm, v);
+      }
+      else {
+	act_trace_digital_change (_tr[fmt], w->node[fmt], r->ftm, v);
+      }
+    }
+  }
+}
+
+void ActSimCore::flushTrace ()
+{
+  if (_trw) {
+    _trw->flush ();
+  }
+}
+
+/*
+ * The trace files are shared with the parent after a fork, and the
+ * trace writer thread only exists in the parent. The child drops all
+ * of them without writing anything: the writer object is leaked
+ * rather than deleted, since its thread cannot be joined, and all
+ * watchpoints stop recording.
+ */
+void ActSimCore::detachTraces ()
+{
+  ihash_bucket_t *b;
+  ihash_iter_t it;
+
+  _trw = NULL;
+  _ntr = NULL;
+  for (int i=0; i < TRACE_NUM_FORMATS; i++) {
+    _tr[i] = NULL;
+  }
+  ihash_iter_init (_W, &it);
+  while ((b = ihash_iter_next (_W, &it))) {
+    watchpt_bucket *w = (watchpt_bucket *) b->v;
+    w->ignore_fmt = ~0U;
+    w->nid = -1;
+  }
+}
+
+void ActSimCore::printTraceStats (FILE *fp, int verbose)
+{
+  if (!_trw) {
+    fprintf (fp, "Asynchronous trace writer is not running.\n");
+    return;
+  }
+  _trw->flush ();
+  _trw->printStats (fp, verbose);
+}
+
+/*
+ * trace_all: a single native trace file that records every selected
+ * signal. Signals are tracked through the watchpoint table; a signal
+ * that is not otherwise being watched gets a "quiet" watchpoint that
+ * records changes but does not display them.
+ */
+int ActSimCore::openTraceAll (const char *file)
+{
+  if (_ntr) {
+    return 0;
+  }
+  _ntr = new ActNativeTraceWriter ();
+  if (!_ntr->open (file, _int_to_float_timescale)) {
+    delete _ntr;
+    _ntr = NULL;
+    return 0;
+  }
+  return 1;
+}
+
+int ActSimCore::addTraceAll (int type, unsigned long off, const char *name)
+{
+  ihash_bucket_t *b;
+  watchpt_bucket *w;
+  int width;
+
+  Assert (_ntr, "addTraceAll() without openTraceAll()");
+  if (type == 3) { type = 2; }
+
+  b = ihash_lookup (_W, ((unsigned long)type) | (off << 2));
+  if (b) {
+    w = (watchpt_bucket *) b->v;
+    if (w->nid >= 0) {
+      /* an alias of a signal we already have */
+      return 0;
+    }
+  }
+  else {
+    addWatchPt (type, off, name);
+    b = ihash_lookup (_W, ((unsigned long)type) | (off << 2));
+    w = (watchpt_bucket *) b->v;
+    w->quiet = 1;
+  }
+
+  if (type == 0) {
+    width = 1;
+  }
+  else if (type == 1) {
+    width = getIntWidth (off);
+  }
+  else {
+    width = getChan (off)->width;
+  }
+  w->nid = _ntr->addSignal (name, type, width);
+  if (type != 0) {
+    _traceVal (ACT_TRACE_WIDE_NUM (width));
+  }
+  return 1;
+}
+
+static int _bool_cmp (const void *a, const void *b)
+{
+  unsigned long x = (*(ihash_bucket_t **)a)->key;
+  unsigned long y = (*(ihash_bucket_t **)b)->key;
+  return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+/*
+ * The watched Booleans, sorted by offset, so that a dump of their
+ * values reads each word of the state once. Returns the number of
+ * entries; the array is freed by the caller.
+ */
+static int _sorted_bool_watch (struct iHashtable *W, ihash_bucket_t ***res)
+{
+  ihash_bucket_t *b;
+  ihash_iter_t it;
+  int n = 0;
+
+  *res = NULL;
+  if (!W || W->n == 0) {
+    return 0;
+  }
+  MALLOC (*res, ihash_bucket_t *, W->n);
+  ihash_iter_init (W, &it);
+  while ((b = ihash_iter_next (W, &it))) {
+    if ((b->key & 0x3) == 0) {
+      (*res)[n++] = b;
+    }
+  }
+  qsort (*res, n, sizeof (ihash_bucket_t *), _bool_cmp);
+  return n;
+}
+
+/* Boolean <off>, using the cached state word *cw */
+static inline int _word_bool (ActSimState *st, unsigned long off, int *cw,
+			      unsigned long *v, unsigned long *xv)
+{
+  unsigned long m = ACT_BOOL_MASK (off);
+  if (*cw != (int)ACT_BOOL_WORD (off)) {
+    *cw = ACT_BOOL_WORD (off);
+    *v = st->getBoolWord (*cw);
+    *xv = st->getXWord (*cw);
+  }
+  if (*xv & m) {
+    return 2;
+  }
+  return (*v & m) ? 1 : 0;
+}
+
+void ActSimCore::beginTraceAll ()
+{
+  ihash_bucket_t *b;
+  ihash_iter_t it;
+  watchpt_bucket *w;
+
+  Assert (_ntr, "beginTraceAll() without openTraceAll()");
+  _ntr->start ();
+
+  ihash_bucket_t **bl;
+  int nb = _sorted_bool_watch (_W, &bl);
+  int cw = -1;
+  unsigned long bv = 0, bxv = 0;
+  for (int i=0; i < nb; i++) {
+    w = (watchpt_bucket *) bl[i]->v;
+    if (w->nid >= 0) {
+      BigInt v;
+      v = _word_bool (state, bl[i]->key >> 2, &cw, &bv, &bxv);
+      recordNativeTrace (w, 0, ACT_CHAN_IDLE, v);
+    }
+  }
+  if (bl) {
+    FREE (bl);
+  }
+
+  ihash_iter_init (_W, &it);
+  while ((b = ihash_iter_next (_W, &it))) {
+    unsigned long off = b->key;
+    int type = off & 0x3;
+    off >>= 2;
+
+    w = (watchpt_bucket *) b->v;
+    if (w->nid < 0 || type == 0) {
+      continue;
+    }
+    if (type == 1) {
+      recordNativeTrace (w, 1, ACT_CHAN_IDLE, getInt (off));
+    }
+    else {
+      act_channel_state *ch = getChan (off);
+      act_chan_state_t state;
+      BigInt v;
+      v = 0;
+      if (WAITING_SENDER (ch)) {
+	state = ACT_CHAN_SEND_BLOCKED;
+      }
+      else if (WAITING_RECEIVER (ch)) {
+	state = ACT_CHAN_RECV_BLOCKED;
+      }
+      else {
+	state = ACT_CHAN_IDLE;
+      }
+      recordNativeTrace (w, 2, state, v);
+    }
+  }
+}
+
+void ActSimCore::closeTraceAll ()
+{
+  ihash_bucket_t *b;
+  ihash_iter_t it;
+  watchpt_bucket *w;
+  A_DECL (unsigned long, del);
+
+  if (!_ntr) {
+    return;
+  }
+  _ntr->close ();
+  delete _ntr;
+  _ntr = NULL;
+
+  A_INIT (del);
+  ihash_iter_init (_W, &it);
+  while ((b = ihash_iter_next (_W, &it))) {
+    w = (watchpt_bucket *) b->v;
+    w->nid = -1;
+    if (w->quiet) {
+      A_NEW (del, unsigned long);
+      A_NEXT (del) = b->key;
+      A_INC (del);
+    }
+  }
+  for (int i=0; i < A_LEN (del); i++) {
+    delWatchPt (del[i] & 0x3, del[i] >> 2);
+  }
+  A_FREE (del);
+}
+
+void ActSimCore::printTraceAllStats (FILE *fp)
+{
+  if (!_ntr) {
+    fprintf (fp, "trace_all is not active.\n");
+    return;
+  }
+  _ntr->printStats (fp);
+}
+
+void ActSimCore::recordNativeTrace (const watchpt_bucket *w, int type,
+				    act_chan_state_t state,
+				    const BigInt &val)
+{
+  unsigned long *valp;
+  int nw;
+
+  _traceTime ();
+
+  if (type == 0) {
+    unsigned long v = val.getVal (0);
+    _ntr->change (_tr_tm[0], w->nid, state, 1, &v);
+    return;
+  }
+
+  nw = val.getLen ();
+  valp = _traceVal (nw);
+  for (int i=0; i < nw; i++) {
+    valp[i] = val.getVal (i);
   }
+  _ntr->change (_tr_tm[0], w->nid, state, nw, valp);
 }
 
 int ActSimCore::initTrace (int fmt, const char *file)
@@ -2288,6 +2799,10 @@ int ActSimCore::initTrace (int fmt, const char *file)
 
   Assert (0 <= fmt && fmt < TRACE_NUM_FORMATS, "Illegal format!");
 
+  /* everything queued for the old trace file is written first */
+  flushTrace ();
+  _tr_tmvalid = 0;
+
   if (_tr[fmt]) {
     act_trace_close (_tr[fmt]);
   }
@@ -2326,11 +2841,21 @@ int ActSimCore::initTrace (int fmt, const char *file)
   if (!_tr[fmt]) {
     return 0;
   }
+
+  if (!_trw && config_exists ("sim.trace_async") &&
+      config_get_int ("sim.trace_async") == 1) {
+    int nrecs = 65536;
+    if (config_exists ("sim.trace_buffer")) {
+      nrecs = config_get_int ("sim.trace_buffer");
+    }
+    _trw = new ActSimTraceWriter (this, nrecs);
+  }
   
   if (_W) {
     ihash_bucket_t *b;
     watchpt_bucket *w;
     ihash_iter_t it;
+    int maxw = 1;
 
     ihash_iter_init (_W, &it);
     while ((b = ihash_iter_next (_W, &it))) {
@@ -2339,21 +2864,32 @@ int ActSimCore::initTrace (int fmt, const char *file)
       off >>= 2;
 
       w = (watchpt_bucket *) b->v;
+      if (w->quiet) {
+	/* only present for trace_all */
+	continue;
+      }
       w->ignore_fmt &= ~(1 << fmt);
       if (type == 0) {
 	w->node[fmt] = act_trace_add_signal (_tr[fmt], ACT_SIG_BOOL, w->s, 0);
       }
       else if (type == 1) {
-	BigInt *tmp = getInt (off);
 	w->node[fmt] = act_trace_add_signal (_tr[fmt], ACT_SIG_INT, w->s,
-					     tmp->getWidth());
+					     getIntWidth (off));
+	if (ACT_TRACE_WIDE_NUM (getIntWidth (off)) > maxw) {
+	  maxw = ACT_TRACE_WIDE_NUM (getIntWidth (off));
+	}
       }
       else if (type == 2) {
 	act_channel_state *ch = getChan (off);
 	w->node[fmt] = act_trace_add_signal (_tr[fmt], ACT_SIG_CHAN, w->s,
 					     ch->width);
+	if (ACT_TRACE_WIDE_NUM (ch->width) > maxw) {
+	  maxw = ACT_TRACE_WIDE_NUM (ch->width);
+	}
       }
     }
+    /* size the scratch value buffer for the widest traced signal */
+    _traceVal (maxw);
 
     // now dump current  value
     BigInt tm = SimDES::CurTime();
@@ -2372,6 +2908,38 @@ int ActSimCore::initTrace (int fmt, const char *file)
     }
     
     act_trace_init_start (_tr[fmt]);
+
+    /* Booleans first, a word at a time */
+    ihash_bucket_t **bl;
+    int nb = _sorted_bool_watch (_W, &bl);
+    int cw = -1;
+    unsigned long bv = 0, bxv = 0;
+    for (int i=0; i < nb; i++) {
+      w = (watchpt_bucket *) bl[i]->v;
+      if (w->quiet) {
+	continue;
+      }
+      int v = _word_bool (state, bl[i]->key >> 2, &cw, &bv, &bxv);
+      if (v == 0) {
+	v = ACT_SIG_BOOL_FALSE;
+      }
+      else if (v == 1) {
+	v = ACT_SIG_BOOL_TRUE;
+      }
+      else {
+	v = ACT_SIG_BOOL_X;
+      }
+      if (act_trace_has_alt (_trfn[fmt])) {
+	act_trace_digital_change_alt (_tr[fmt], w->node[fmt], tmlen, ptm, v);
+      }
+      else {
+	act_trace_digital_change (_tr[fmt], w->node[fmt], cur_time, v);
+      }
+    }
+    if (bl) {
+      FREE (bl);
+    }
+
     ihash_iter_init (_W, &it);
     while ((b = ihash_iter_next (_W, &it))) {
       unsigned long off = b->key;
@@ -2379,50 +2947,35 @@ int ActSimCore::initTrace (int fmt, const char *file)
       off >>= 2;
 
       w = (watchpt_bucket *) b->v;
-      if (type == 0) {
-	int v = getBool (off);
-	if (v == 0) {
-	  v = ACT_SIG_BOOL_FALSE;
-	}
-	else if (v == 1) {
-	  v = ACT_SIG_BOOL_TRUE;
-	}
-	else if (v == 2) {
-	  v = ACT_SIG_BOOL_X;
-	}
-	if (act_trace_has_alt (_trfn[fmt])) {
-	  act_trace_digital_change_alt (_tr[fmt], w->node[fmt], tmlen, ptm, v);
-	}
-	else {
-	  act_trace_digital_change (_tr[fmt], w->node[fmt], cur_time, v);
-	}
+      if (w->quiet || type == 0) {
+	continue;
       }
-      else if (type == 1) {
-	BigInt *tmp = getInt (off);
-	if (ACT_TRACE_WIDE_NUM (tmp->getWidth()) <= 1) {
+      if (type == 1) {
+	if (ACT_TRACE_WIDE_NUM (getIntWidth (off)) <= 1) {
 	  if (act_trace_has_alt (_trfn[fmt])) {
 	    act_trace_digital_change_alt (_tr[fmt], w->node[fmt], tmlen, ptm,
-				      tmp->getVal (0));
+				      getIntVal (off));
 	  }
 	  else {
 	    act_trace_digital_change (_tr[fmt], w->node[fmt], cur_time,
-				      tmp->getVal (0));
+				      getIntVal (off));
 	  }
 	}
 	else {
+	  const BigInt &tmp = getWideInt (off);
 	  unsigned long *v;
-	  MALLOC (v, unsigned long, tmp->getLen());
-	  for (int i=0; i < tmp->getLen(); i++) {
-	    v[i] = tmp->getVal (i);
+	  MALLOC (v, unsigned long, tmp.getLen());
+	  for (int i=0; i < tmp.getLen(); i++) {
+	    v[i] = tmp.getVal (i);
 	  }
 	  if (act_trace_has_alt (_trfn[fmt])) {
 	    act_trace_wide_digital_change_alt (_tr[fmt], w->node[fmt],
 					       tmlen, ptm, 
-					       tmp->getLen(), v);
+					       tmp.getLen(), v);
 	  }
 	  else {
 	    act_trace_wide_digital_change (_tr[fmt], w->node[fmt], cur_time,
-					   tmp->getLen(), v);
+					   tmp.getLen(), v);
 	  }
 	  FREE (v);
 	}
@@ -25,11 +25,15 @@
 #include <unistd.h>
 #include <string.h>
 #include <signal.h>
+#include <sys/time.h>
+#include <sys/wait.h>
 #include <act/act.h>
 #include <act/passes.h>
 #include <common/config.h>
 #include "actsim.h"
 #include "chpsim.h"
+#include "prssim.h"
+#include "nattrace.h"
 #include <lisp.h>
 #include <lispCli.h>
 #include <ctype.h>
@@ -61,6 +65,12 @@ static void usage (char *name)
   fprintf (stderr, " -S <sdf>  : use delay from the specified SDF file.\n");
   fprintf (stderr, " -p <proc> : set <proc> as the top-level for simulation.\n");
   fprintf (stderr, " -m        : monitor exclusive high/low spec constraints.\n");
+  fprintf (stderr, "\n");
+  fprintf (stderr, "       %s [options] -b <list> [-j <n>] <actfile>\n", name);
+  fprintf (stderr, " -b <list> : batch mode; run each test in <list>. Each line is\n");
+  fprintf (stderr, "             <process> [<script> [<expected stdout>]]\n");
+  fprintf (stderr, " -j <n>    : run up to <n> batch tests in parallel.\n");
+  fprintf (stderr, "             The output of failing tests is shown after the summary.\n");
   exit (1);
 }
 
@@ -162,8 +172,24 @@ int process_advance (int argc, char **argv)
 
 int process_initialize (int argc, char **argv)
 {
+  int rq = 0;
+  int lev = 0;
+  while (argc > 2 && argv[1][0] == '-') {
+    if (strcmp (argv[1], "-q") == 0) {
+      rq = 1;
+    }
+    else if (strcmp (argv[1], "-l") == 0) {
+      lev = 1;
+    }
+    else {
+      break;
+    }
+    argv[1] = argv[0];
+    argc--;
+    argv++;
+  }
   if (argc != 2) {
-    fprintf (stderr, "Usage: %s <process>\n", argv[0]);
+    fprintf (stderr, "Usage: %s [-q] [-l] <process>\n", argv[0]);
     return LISP_RET_ERROR;
   }
   Process *p = glob_act->findProcess (argv[1]);
@@ -182,8 +208,20 @@ int process_initialize (int argc, char **argv)
   SimDES::Init ();
   glob_sp = new ActStatePass (glob_act);
   glob_sp->run (p);
+
+  /* -q and -l only apply to this initialization */
+  int prev_rq = config_get_int ("sim.chp.run_queue");
+  int prev_lev = config_get_int ("sim.reset_levelized");
+  if (rq) {
+    config_set_int ("sim.chp.run_queue", 1);
+  }
+  if (lev) {
+    config_set_int ("sim.reset_levelized", 1);
+  }
   glob_sim = new ActSim (p);
   glob_sim->runInit ();
+  config_set_int ("sim.chp.run_queue", prev_rq);
+  config_set_int ("sim.reset_levelized", prev_lev);
   return LISP_RET_TRUE;
 }
 
@@ -800,11 +838,13 @@ int process_set (int argc, char **argv)
     if ((nm = glob_sim->chkWatchPt (0, offset))) {
       int oval = glob_sim->getBool (offset);
       if (oval != val) {
-	BigInt tm = SimDES::CurTime();
-	printf ("[");
-	tm.decPrint (stdout, 20);
-	printf ("] <[env]> ");
-	printf ("%s := %c\n", nm->s, (val == 2 ? 'X' : ((char)val + '0')));
+	if (!nm->quiet) {
+	  BigInt tm = SimDES::CurTime();
+	  printf ("[");
+	  tm.decPrint (stdout, 20);
+	  printf ("] <[env]> ");
+	  printf ("%s := %c\n", nm->s, (val == 2 ? 'X' : ((char)val + '0')));
+	}
 
 	BigInt tmpv;
 	tmpv = val;
@@ -815,14 +855,14 @@ int process_set (int argc, char **argv)
     glob_sim->setBool (offset, val);
   }
   else if (type == 1) {
-    BigInt *otmp = glob_sim->getInt (offset);
+    BigInt otmp = glob_sim->getInt (offset);
     BigInt rd = BigInt::sscan (argv[2]);
     if (rd.isNegative()) {
       fprintf (stderr, "Integers are unsigned.\n");
       return LISP_RET_ERROR;
     }
     BigInt before = rd;
-    rd.setWidth (otmp->getWidth());
+    rd.setWidth (otmp.getWidth());
     if (before != rd) {
       fprintf(stderr, "Value does not fit into variable's bitwidth.\n");
       return LISP_RET_ERROR;
@@ -830,16 +870,18 @@ int process_set (int argc, char **argv)
 
     const ActSim::watchpt_bucket *nm;
     if ((nm = glob_sim->chkWatchPt (1, offset))) {
-      if (*otmp != rd) {
-	BigInt tm = SimDES::CurTime();
-	printf ("[");
-	tm.decPrint (stdout, 20);
-	printf ("] <[env]> ");
-	printf ("%s := ", nm->s);
-	rd.decPrint (stdout);
-	printf (" (0x");
-	rd.hexPrint (stdout);
-	printf (")\n");
+      if (otmp != rd) {
+	if (!nm->quiet) {
+	  BigInt tm = SimDES::CurTime();
+	  printf ("[");
+	  tm.decPrint (stdout, 20);
+	  printf ("] <[env]> ");
+	  printf ("%s := ", nm->s);
+	  rd.decPrint (stdout);
+	  printf (" (0x");
+	  rd.hexPrint (stdout);
+	  printf (")\n");
+	}
 
 	glob_sim->recordTrace (nm, type, ACT_CHAN_IDLE, rd);
       }
@@ -850,13 +892,11 @@ int process_set (int argc, char **argv)
     fatal_error ("Should not be here");
   }
 
-  SimDES **arr;
+  ActSimDES **arr;
   arr = glob_sim->getFO (offset, type);
   glob_dummy->setGid (offset);
   for (int i=0; i < glob_sim->numFanout (offset, type); i++) {
-    ActSimDES *p = dynamic_cast <ActSimDES *> (arr[i]);
-    Assert (p, "Hmm?");
-    p->propagate (glob_dummy);
+    arr[i]->propagate (glob_dummy);
   }
   return LISP_RET_TRUE;
 }
@@ -1002,15 +1042,11 @@ int process_assert (int argc, char **argv)
     }
   }
   else if (type == 1) {
-    BigInt *ival = glob_sim->getInt (offset);
-    if (!ival) {
-      printf ("%s: couldn't get integer `%s'?\n", argv[0], argv[1]);
-      return LISP_RET_ERROR;
-    }
-    if (*ival == expected_val) assert_false = false;
+    BigInt ival = glob_sim->getInt (offset);
+    if (ival == expected_val) assert_false = false;
     else {
       printf("Warning: WRONG ASSERT:\t\"%s\" has value ", argv[1]);
-      ival->decPrint (stdout);
+      ival.decPrint (stdout);
       printf("and not");
       expected_val.decPrint (stdout);
       printf("\n");
@@ -1095,28 +1131,24 @@ int process_get (int argc, char **argv)
     }
   }
   else if (type == 1) {
-    BigInt *ival = glob_sim->getInt (offset);
-    if (!ival) {
-      printf ("%s: couldn't get integer `%s'?\n", argv[0], argv[1]);
-      return LISP_RET_ERROR;
-    }
-    if (ival->getLen() > 1) {
+    if (glob_sim->isWideInt (offset)) {
+      const BigInt &ival = glob_sim->getWideInt (offset);
       is_list = true;
       LispSetReturnListStart ();
-      for (int i=0; i < ival->getLen(); i++) {
-	LispAppendReturnInt (ival->getVal (i));
+      for (int i=0; i < ival.getLen(); i++) {
+	LispAppendReturnInt (ival.getVal (i));
       }
       LispSetReturnListEnd ();
       if (argc == 2) {
 	printf ("%s: ", argv[1]);
-	ival->decPrint (stdout);
+	ival.decPrint (stdout);
 	printf ("  (0x");
-	ival->hexPrint (stdout);
+	ival.hexPrint (stdout);
 	printf (")\n");
       }
     }
     else {
-      val = ival->getVal (0);
+      val = glob_sim->getIntVal (offset);
       LispSetReturnInt (val);
       if (argc == 2) {
 	printf ("%s: %lu  (0x%lx)\n", argv[1], val, val);
@@ -1149,6 +1181,105 @@ int process_get (int argc, char **argv)
   return is_list ? LISP_RET_LIST : LISP_RET_INT;
 }
 
+/*
+ * mget of a Boolean bus, written as name[lo..hi]. When the elements
+ * are consecutive in the state vector they are read a word at a time.
+ * Returns -1 if <s> is not a range, 0 on error, 1 on success.
+ */
+static int mget_bus (char *s)
+{
+  char *lb, *dd;
+  int lo, hi, n;
+  int type, off;
+  int *offs;
+  char *buf;
+  int len;
+  int contig;
+
+  len = strlen (s);
+  if (len < 6 || s[len-1] != ']') {
+    return -1;
+  }
+  lb = strrchr (s, '[');
+  if (!lb || !(dd = strstr (lb, ".."))) {
+    return -1;
+  }
+  if (sscanf (lb+1, "%d", &lo) != 1 || sscanf (dd+2, "%d", &hi) != 1
+      || lo < 0 || hi < lo) {
+    fprintf (stderr, "mget: bad range in `%s'\n", s);
+    return 0;
+  }
+  n = hi - lo + 1;
+  MALLOC (offs, int, n);
+  MALLOC (buf, char, len + 24);
+  contig = 1;
+  for (int i=0; i < n; i++) {
+    snprintf (buf, len + 24, "%.*s[%d]", (int)(lb - s), s, lo + i);
+    if (!id_to_siminfo_glob (buf, &type, &off, NULL)) {
+      FREE (offs);
+      FREE (buf);
+      return 0;
+    }
+    if (type != 0) {
+      fprintf (stderr, "mget: `%s' is not a Boolean\n", buf);
+      FREE (offs);
+      FREE (buf);
+      return 0;
+    }
+    offs[i] = off;
+    if (i > 0 && off != offs[0] + i) {
+      contig = 0;
+    }
+  }
+  FREE (buf);
+
+  ActSimState *st = glob_sim->getState ();
+  char *bits;
+  unsigned long hex = 0;
+  int hasx = 0;
+
+  MALLOC (bits, char, n + 1);
+  bits[n] = '\0';
+  for (int i=0; i < n; i += ACT_BOOL_WORDBITS) {
+    int k = n - i < ACT_BOOL_WORDBITS ? n - i : ACT_BOOL_WORDBITS;
+    unsigned long v = 0, xv = 0;
+    if (contig) {
+      st->getBoolRange (offs[i], k, &v, &xv);
+    }
+    else {
+      for (int j=0; j < k; j++) {
+	int b = st->getBool (offs[i+j]);
+	if (b == 2) {
+	  xv |= ACT_BOOL_MASK (j);
+	}
+	else if (b == 1) {
+	  v |= ACT_BOOL_MASK (j);
+	}
+      }
+    }
+    if (i == 0) {
+      hex = v;
+    }
+    if (xv) {
+      hasx = 1;
+    }
+    /* most significant (highest index) element first */
+    for (int j=0; j < k; j++) {
+      bits[n-1-(i+j)] = (xv & ACT_BOOL_MASK (j)) ? 'X' :
+	((v & ACT_BOOL_MASK (j)) ? '1' : '0');
+    }
+  }
+  if (!hasx && n <= ACT_BOOL_WORDBITS) {
+    printf ("%s: %s  (0x%lx)\n", s, bits, hex);
+  }
+  else {
+    printf ("%s: %s\n", s, bits);
+  }
+  FREE (bits);
+  FREE (offs);
+  return 1;
+}
+
 int process_mget (int argc, char **argv)
 {
   if (argc < 2) {
@@ -1159,6 +1290,13 @@ int process_mget (int argc, char **argv)
   int type, offset;
 
   for (int i=1; i < argc; i++) {
+    int r = mget_bus (argv[i]);
+    if (r == 0) {
+      return LISP_RET_ERROR;
+    }
+    else if (r == 1) {
+      continue;
+    }
     if (!id_to_siminfo_glob (argv[i], &type, &offset, NULL)) {
       return LISP_RET_ERROR;
     }
@@ -1182,9 +1320,8 @@ int process_mget (int argc, char **argv)
       }
     }
     else if (type == 1) {
-      BigInt *ival;
-      ival = glob_sim->getInt (offset);
-      printf ("%s: %lu  (0x%lx)\n", argv[i], ival->getVal(0), ival->getVal (0));
+      unsigned long ival = glob_sim->getIntVal (offset);
+      printf ("%s: %lu  (0x%lx)\n", argv[i], ival, ival);
     }
   }
   return LISP_RET_TRUE;
@@ -1293,6 +1430,46 @@ int process_logfile (int argc, char **argv)
   return LISP_RET_TRUE;
 }
 
+int process_checkpoint (int argc, char **argv)
+{
+  if (argc != 2) {
+    fprintf (stderr, "Usage: %s <file>\n", argv[0]);
+    return LISP_RET_ERROR;
+  }
+  if (!glob_sim) { 
+    fprintf (stderr, "%s: No simulation?\n", argv[0]);
+    return LISP_RET_ERROR;
+  }
+  FILE *fp = fopen (argv[1], "wb");
+  if (!fp) {
+    fprintf (stderr, "%s: could not open file `%s'\n", argv[0], argv[1]);
+    return LISP_RET_ERROR;
+  }
+  glob_sim->saveSim (fp);
+  fclose (fp);
+  return LISP_RET_TRUE;
+}
+
+int process_restore (int argc, char **argv)
+{
+  if (argc != 2) {
+    fprintf (stderr, "Usage: %s <file>\n", argv[0]);
+    return LISP_RET_ERROR;
+  }
+  if (!glob_sim) { 
+    fprintf (stderr, "%s: No simulation?\n", argv[0]);
+    return LISP_RET_ERROR;
+  }
+  FILE *fp = fopen (argv[1], "rb");
+  if (!fp) {
+    fprintf (stderr, "%s: could not open file `%s'\n", argv[0], argv[1]);
+    return LISP_RET_ERROR;
+  }
+  int ok = glob_sim->restoreSim (fp);
+  fclose (fp);
+  return ok ? LISP_RET_TRUE : LISP_RET_ERROR;
+}
+
 int process_filter (int argc, char **argv)
 {
   if (argc != 2) {
@@ -1489,6 +1666,12 @@ int process_status (int argc, char **argv)
     fprintf (stderr, "Usage: %s 0|1|X\n", argv[0]);
     return LISP_RET_ERROR;
   }
+
+  /* quick check on the packed state before walking the design */
+  if (glob_sim->getState()->countBools (val) == 0) {
+    return LISP_RET_TRUE;
+  }
+  
   _compute_status (glob_sim->getInstTable(), val);
 
   /* now dump status for all the primary I/O pins and globals */
@@ -1732,103 +1915,1107 @@ int process_pending (int argc, char **argv)
 }
 
 
-struct LispCliCommand Cmds[] = {
-  { NULL, "Initialization and setup", NULL },
-
-  { "echo", "[-n] args - display to screen", process_echo },
-  { "error", "<str> - report error and abort execution", process_error },
-  
-  { "initialize", "<proc> - initialize simulation for <proc>",
-    process_initialize },
-
-  { "mode", "reset|run - set running mode", process_mode },
-  
-  { "random", "[-u] [min max] - randomize timings; -u only randomizes unspecified times", process_random },
-  { "random_seed", "<val> - set random number seed", process_random_seed },
-  { "norandom", "- deterministic timing", process_norandom },
-  { "random_choice", "on|off - randomize non-deterministic choices", process_random_choice },
+int process_evstats (int argc, char **argv)
+{
+  if (argc != 1 && argc != 2) {
+    fprintf (stderr, "Usage: %s [-c]\n", argv[0]);
+    return LISP_RET_ERROR;
+  }
+  if (argc == 2) {
+    if (strcmp (argv[1], "-c") != 0) {
+      fprintf (stderr, "Usage: %s [-c]\n", argv[0]);
+      return LISP_RET_ERROR;
+    }
+    ActSimEvents::Clear ();
+    return LISP_RET_TRUE;
+  }
+  ActSimEvents::Print (stdout);
+  return LISP_RET_TRUE;
+}
 
-#if 0
-  { "dumptc", "<file> - dump transition counts to a file", process_dumptc },
-#endif
 
-  { NULL, "Running simulation", NULL },
+int process_trstats (int argc, char **argv)
+{
+  if (argc > 2 || (argc == 2 && strcmp (argv[1], "-v") != 0)) {
+    fprintf (stderr, "Usage: %s [-v]\n", argv[0]);
+    return LISP_RET_ERROR;
+  }
+  if (!glob_sim) {
+    fprintf (stderr, "%s: no simulation\n", argv[0]);
+    return LISP_RET_ERROR;
+  }
+  glob_sim->printTraceStats (stdout, argc == 2);
+  return LISP_RET_TRUE;
+}
 
-  { "step", "[n] - run the next [n] events", process_step },
-  { "advance", "<delay> - run for <delay> time", process_advance },
-  { "cycle", "- run until simulation stops", process_cycle },
+int process_profile (int argc, char **argv)
+{
+  int top = 10;
+  int events_only = 0;
+  char *folded = NULL;
 
-  { "pending", "- dump pending events", process_pending },
-  
-  { "set", "<name> <val> - set a variable to a value", process_set },
-  { "gc-retry", "<name> - re-try guards in a deadlocked process", process_wakeup },
-  { "skip-comm", "<name> - skip the communication action", process_skipcomm },
-  
-  { "get", "<name> [#f] - get value of a variable; optional arg turns off display", process_get },
-  { "mget", "<name1> <name2> ... - multi-get value of a variable", process_mget },
-  { "chcount", "<name> [#f] - return the number of completed actions on named channel", process_chcount },
+  if (argc < 2) {
+    fprintf (stderr, "Usage: %s start|stop|clear|report [-top N] [-events] [-folded <file>]\n", argv[0]);
+    return LISP_RET_ERROR;
+  }
+  if (!glob_sim) {
+    fprintf (stderr, "%s: no simulation\n", argv[0]);
+    return LISP_RET_ERROR;
+  }
+  if (strcmp (argv[1], "start") == 0 && argc == 2) {
+    ActSimProfile::Start ();
+  }
+  else if (strcmp (argv[1], "stop") == 0 && argc == 2) {
+    ActSimProfile::Stop ();
+  }
+  else if (strcmp (argv[1], "clear") == 0 && argc == 2) {
+    ActSimProfile::Clear (glob_sim->getInstTable ());
+  }
+  else if (strcmp (argv[1], "report") == 0) {
+    int i;
+    for (i=2; i < argc; i++) {
+      if (strcmp (argv[i], "-events") == 0) {
+	events_only = 1;
+      }
+      else if (i == argc-1) {
+	break;
+      }
+      else if (strcmp (argv[i], "-top") == 0) {
+	top = atoi (argv[++i]);
+      }
+      else if (strcmp (argv[i], "-folded") == 0) {
+	folded = argv[++i];
+      }
+      else {
+	break;
+      }
+    }
+    if (i != argc || top < 0) {
+      fprintf (stderr, "Usage: %s report [-top N] [-events] [-folded <file>]\n", argv[0]);
+      return LISP_RET_ERROR;
+    }
+    if (folded) {
+      FILE *fp = fopen (folded, "w");
+      if (!fp) {
+	fprintf (stderr, "%s: could not open `%s' for writing\n", argv[0],
+		 folded);
+	return LISP_RET_ERROR;
+      }
+      ActSimProfile::Folded (fp, glob_sim->getInstTable (), events_only);
+      fclose (fp);
+    }
+    else {
+      ActSimProfile::Report (stdout, glob_sim->getInstTable (), top,
+			     events_only);
+    }
+  }
+  else {
+    fprintf (stderr, "Usage: %s start|stop|clear|report [-top N] [-events] [-folded <file>]\n", argv[0]);
+    return LISP_RET_ERROR;
+  }
+  return LISP_RET_TRUE;
+}
 
-  { "watch", "<n1> <n2> ... - add watchpoint for <n1> etc.", process_watch },
-  { "unwatch", "<n1> <n2> ... - delete watchpoint for <n1> etc.", process_unwatch },
-  { "breakpt", "<n> - toggle breakpoint for <n>", process_breakpt },
-  { "break", "<n> - toggle breakpoint for <n>", process_breakpt },
-  { "assert", "<name> <value> - compares the value of a variable or the channel status to a wanted value - exists sim if exit-on-warn is set", process_assert },
 
-  { "break-on-warn", "- stop simulation on warning", process_break_on_warn },
-  { "exit-on-warn", "- like break-on-warn, but exit", process_exit_on_warn },
-  { "resume-on-warn", "- continue simulation on warning", process_resume_on_warn },
+/*
+ * trace_all: walk the instance table and trace every bool, int, and
+ * channel found.
+ */
+struct trace_all_info {
+  regex_t re;
+  int has_re;
+  int count;
+};
 
-  { "status", "0|1|X - list all nodes with specified value", process_status },
+/*
+ * Silent version of id_obj_to_siminfo(): names are generated from the
+ * design, and ones that don't exist in the simulation (optimized away,
+ * no state) are just skipped.
+ */
+static int trace_all_lookup (ActSimObj *obj, ActId *id,
+			     int *ptype, int *poffset)
+{
+  stateinfo_t *si;
+  act_connection *c;
 
-  { "timescale", "<t> - set time scale to <t> picoseconds for tracing", process_timescale },
-  { "get_sim_time", "- returns current simulation time in picoseconds", process_get_sim_time },
-  { "get_sim_itime", "- returns current simulation time (integer)", process_get_sim_itime },
-  { "vcd_start", "<file> - Create Verilog change dump for all watched values", process_createvcd },
-  { "vcd_stop", "- Stop VCD generation", process_stopvcd },
-  { "trace_start", "[-fmt] <file> - Create trace file in specified format for all watched values", process_createalint },
-  { "trace_stop", "[-fmt] - Stop trace file generation for specified format", process_stopalint },
-  { "lxt2_start", "<file> - Create LXT2 format trace file for all watched values", process_createlxt2 },
-  { "lxt2_stop", "- Stop LXT2 trace file generation", process_stoplxt2 },
+  si = glob_sp->getStateInfo (obj->getProc());
+  if (!si) {
+    return 0;
+  }
+  if (!si->bnl->cur->FullLookup (id, NULL)) {
+    return 0;
+  }
+  if (!id->validateDeref (si->bnl->cur)) {
+    return 0;
+  }
+  c = id->Canonical (si->bnl->cur, true);
+  if (!c) {
+    return 0;
+  }
+  if (!glob_sp->getTypeOffset (si, c, poffset, ptype, NULL)) {
+    return 0;
+  }
+  return 1;
+}
 
+static void trace_all_add (struct trace_all_info *ti, ActSimObj *obj,
+			   const char *prefix, ActId *id)
+{
+  char buf[10240];
+  int type, off, len;
 
-#if 0  
-  { NULL, "Production rule tracing", NULL },
+  len = snprintf (buf, 10240, "%s", prefix);
+  id->sPrint (buf + len, 10240 - len);
+  if (ti->has_re && regexec (&ti->re, buf, 0, NULL, 0) != 0) {
+    return;
+  }
+  if (trace_all_lookup (obj, id, &type, &off)) {
+    if (type == 3) {
+      type = 2;
+    }
+    ti->count += glob_sim->addTraceAll (type,
+					obj->getGlobalOffset (off, type), buf);
+  }
+}
 
-  { "fanin", "<n> - list fanin for <n>", process_fanin },
-  { "fanin-get", "<n> - list fanin with values for <n>", process_fanin_get },
-  { "fanout", "<n> - list fanout for <n>", process_fanout },
-  
-#endif  
+/*
+ * Every bool/int/chan in scope <sc>. <id> is the name of the
+ * enclosing user-defined type (NULL at the process level), with <tl>
+ * its last component.
+ */
+static void trace_all_scope (struct trace_all_info *ti, ActSimObj *obj,
+			     const char *prefix, ActId *id, ActId *tl,
+			     Scope *sc)
+{
+  ActInstiter it(sc);
 
-  { NULL, "Process and CHP commands", NULL },
+  for (it = it.begin(); it != it.end(); it++) {
+    ValueIdx *vx = (*it);
+    UserDef *ux;
+    ActId *cur, *root;
+    int leaf;
 
-#if 0
-  { "send", "<chan> <val> - send a value on a channel", process_send },
-  { "recv", "<chan> [#f] - receive a value from a channel; optional arg turns off display", process_recv },
-#endif
+    if (TypeFactory::isProcessType (vx->t) ||
+	TypeFactory::isParamType (vx->t)) {
+      continue;
+    }
+    leaf = TypeFactory::isBoolType (vx->t) || TypeFactory::isIntType (vx->t)
+      || TypeFactory::isChanType (vx->t);
+    if (TypeFactory::isBoolType (vx->t) || TypeFactory::isIntType (vx->t)) {
+      ux = NULL;
+    }
+    else {
+      /* fields of user-defined data and channel types */
+      ux = dynamic_cast<UserDef *> (vx->t->BaseType());
+    }
+    if (!leaf && !ux) {
+      continue;
+    }
 
-  { "filter", "<regexp> - only show log messages that match regexp", process_filter },
-  { "logfile", "<file> - dump actsim log output to a log file <file>", process_logfile },
-  
-  { "procinfo", "<filename> [<inst-name>] - save the program counter for a process to file (- for stdout)", process_procinfo },
-  { "energy", "[-v] <filename> [<inst-name>] - save energy usage to file (- for stdout)", process_getenergy },
-  { "coverage", "<filename> [<inst-name>] - report coverage for guards", process_coverage },
-  { "goto", "[<inst-name>] <label> - for a single-threaded state, jump to label", process_goto }
-};
+    cur = new ActId (vx->getName());
+    if (tl) {
+      tl->Append (cur);
+      root = id;
+    }
+    else {
+      root = cur;
+    }
+
+    if (vx->t->arrayInfo()) {
+      Arraystep *as = vx->t->arrayInfo()->stepper();
+      int idx = 0;
+      while (!as->isend()) {
+	if (vx->isPrimary (idx)) {
+	  Array *a = as->toArray ();
+	  cur->setArray (a);
+	  if (leaf) {
+	    trace_all_add (ti, obj, prefix, root);
+	  }
+	  if (ux) {
+	    trace_all_scope (ti, obj, prefix, root, cur, ux->CurScope());
+	  }
+	  cur->setArray (NULL);
+	  delete a;
+	}
+	idx++;
+	as->step();
+      }
+      delete as;
+    }
+    else {
+      if (leaf) {
+	trace_all_add (ti, obj, prefix, root);
+      }
+      if (ux) {
+	trace_all_scope (ti, obj, prefix, root, cur, ux->CurScope());
+      }
+    }
 
-/* -- access top-level Act  -- */
-Act *actsim_Act()
-{
-  return glob_act;
+    if (tl) {
+      tl->prune ();
+    }
+    delete cur;
+  }
 }
 
-Process *actsim_top()
+static void trace_all_walk (struct trace_all_info *ti, ActInstTable *I,
+			    const char *prefix, int depth)
+{
+  char buf[10240];
+  
+  if (I->obj && I->obj->getProc()) {
+    trace_all_scope (ti, I->obj, prefix, NULL, NULL,
+		     I->obj->getProc()->CurScope());
+  }
+  if (depth == 0 || !I->H) {
+    return;
+  }
+  hash_bucket_t *b;
+  hash_iter_t it;
+  hash_iter_init (I->H, &it);
+  while ((b = hash_iter_next (I->H, &it))) {
+    snprintf (buf, 10240, "%s%s.", prefix, b->key);
+    trace_all_walk (ti, (ActInstTable *)b->v, buf,
+		    depth < 0 ? depth : depth - 1);
+  }
+}
+
+int process_trace_all (int argc, char **argv)
+{
+  struct trace_all_info ti;
+  int depth = -1;
+  char *inst = NULL;
+  char *re = NULL;
+  char prefix[10240];
+  int i;
+
+  if (!glob_sim) {
+    fprintf (stderr, "%s: no simulation\n", argv[0]);
+    return LISP_RET_ERROR;
+  }
+  for (i=1; i < argc-1; i += 2) {
+    if (strcmp (argv[i], "-depth") == 0) {
+      depth = atoi (argv[i+1]);
+    }
+    else if (strcmp (argv[i], "-filter") == 0) {
+      re = argv[i+1];
+    }
+    else if (strcmp (argv[i], "-inst") == 0) {
+      inst = argv[i+1];
+    }
+    else {
+      break;
+    }
+  }
+  if (i != argc-1 || depth < -1) {
+    fprintf (stderr, "Usage: %s [-depth N] [-filter regex] [-inst name] <file>\n", argv[0]);
+    return LISP_RET_ERROR;
+  }
+  if (glob_sim->isTraceAll ()) {
+    fprintf (stderr, "%s: already active; use trace_all_stop first.\n",
+	     argv[0]);
+    return LISP_RET_ERROR;
+  }
+
+  ActInstTable *I = glob_sim->getInstTable ();
+  prefix[0] = '\0';
+  if (inst) {
+    ActId *id = my_parse_id (inst);
+    if (!id) {
+      fprintf (stderr, "Could not parse `%s' into an instance name\n", inst);
+      return LISP_RET_ERROR;
+    }
+    I = find_table (id, I);
+    delete id;
+    if (!I) {
+      fprintf (stderr, "Could not find instance `%s'\n", inst);
+      return LISP_RET_ERROR;
+    }
+    snprintf (prefix, 10240, "%s.", inst);
+  }
+
+  ti.count = 0;
+  ti.has_re = 0;
+  if (re) {
+    if (regcomp (&ti.re, re, REG_EXTENDED|REG_NOSUB) != 0) {
+      fprintf (stderr, "%s: illegal regular expression `%s'\n", argv[0], re);
+      return LISP_RET_ERROR;
+    }
+    ti.has_re = 1;
+  }
+
+  if (!glob_sim->openTraceAll (argv[argc-1])) {
+    fprintf (stderr, "%s: could not create `%s'\n", argv[0], argv[argc-1]);
+    if (ti.has_re) {
+      regfree (&ti.re);
+    }
+    return LISP_RET_ERROR;
+  }
+  trace_all_walk (&ti, I, prefix, depth);
+  glob_sim->beginTraceAll ();
+  if (ti.has_re) {
+    regfree (&ti.re);
+  }
+  printf ("Tracing %d signals to `%s'\n", ti.count, argv[argc-1]);
+  return LISP_RET_TRUE;
+}
+
+int process_trace_all_stop (int argc, char **argv)
+{
+  if (argc != 1 && argc != 2) {
+    fprintf (stderr, "Usage: %s [-s]\n", argv[0]);
+    return LISP_RET_ERROR;
+  }
+  if (argc == 2 && strcmp (argv[1], "-s") != 0) {
+    fprintf (stderr, "Usage: %s [-s]\n", argv[0]);
+    return LISP_RET_ERROR;
+  }
+  if (!glob_sim || !glob_sim->isTraceAll ()) {
+    fprintf (stderr, "%s: trace_all is not active\n", argv[0]);
+    return LISP_RET_ERROR;
+  }
+  if (argc == 2) {
+    glob_sim->printTraceAllStats (stdout);
+  }
+  glob_sim->closeTraceAll ();
+  return LISP_RET_TRUE;
+}
+
+
+/*
+ * Look up a signal in a closed native trace file, using its index.
+ */
+int process_trace_query (int argc, char **argv)
+{
+  int ret;
+
+  if (argc != 4 && argc != 5) {
+    fprintf (stderr, "Usage: %s <file> <name> <t> | <t0> <t1>\n", argv[0]);
+    return LISP_RET_ERROR;
+  }
+  if (argc == 4) {
+    ret = nattrace_query (stdout, argv[1], argv[2],
+			  strtoul (argv[3], NULL, 0), 0, 0);
+  }
+  else {
+    ret = nattrace_query (stdout, argv[1], argv[2],
+			  strtoul (argv[3], NULL, 0),
+			  strtoul (argv[4], NULL, 0), 1);
+  }
+  if (ret < 0) {
+    return LISP_RET_ERROR;
+  }
+  return ret ? LISP_RET_TRUE : LISP_RET_FALSE;
+}
+
+
+static void _prs_classes (ActInstTable *x, int *kind, int *gen)
+{
+  if (!x) {
+    return;
+  }
+  if (x->obj) {
+    PrsSim *ps = dynamic_cast <PrsSim *> (x->obj);
+    if (ps) {
+      for (int i=0; i < PRSSIM_NKINDS; i++) {
+	kind[i] += ps->numKind (i);
+      }
+      *gen += ps->numGeneric ();
+    }
+  }
+  if (x->H) {
+    hash_bucket_t *b;
+    hash_iter_t i;
+    hash_iter_init (x->H, &i);
+    while ((b = hash_iter_next (x->H, &i))) {
+      _prs_classes ((ActInstTable *) b->v, kind, gen);
+    }
+  }
+}
+
+int process_prs_classes (int argc, char **argv)
+{
+  static const char *names[PRSSIM_NKINDS] = {
+    "static (fixed delay)",
+    "weak pull, fixed delay",
+    "delay table",
+    "pass/transmission gate"
+  };
+  int kind[PRSSIM_NKINDS];
+  int gen = 0, tot = 0;
+  ActInstTable *inst;
+
+  if (argc != 1 && argc != 2) {
+    fprintf (stderr, "Usage: %s [<instance-name>]\n", argv[0]);
+    return LISP_RET_ERROR;
+  }
+  if (argc == 2) {
+    ActId *id = my_parse_id (argv[1]);
+    if (id == NULL) {
+      fprintf (stderr, "Could not parse `%s' into an instance name\n",
+	       argv[1]);
+      return LISP_RET_ERROR;
+    }
+    inst = find_table (id, glob_sim->getInstTable());
+    delete id;
+    if (!inst) {
+      fprintf (stderr, "%s: could not find instance `%s'\n", argv[0], argv[1]);
+      return LISP_RET_ERROR;
+    }
+  }
+  else {
+    inst = glob_sim->getInstTable ();
+  }
+  for (int i=0; i < PRSSIM_NKINDS; i++) {
+    kind[i] = 0;
+  }
+  _prs_classes (inst, kind, &gen);
+  for (int i=0; i < PRSSIM_NKINDS; i++) {
+    printf ("  %-24s: %d\n", names[i], kind[i]);
+    tot += kind[i];
+  }
+  printf ("Gates: %d (%d specialized)\n", tot, tot - gen);
+  return LISP_RET_TRUE;
+}
+
+
+/*
+ * Run what-if experiments from the current simulation point. Each
+ * branch is a forked copy of the simulator that runs a script (or
+ * inline commands with -e); the output of each branch is collected
+ * and displayed in order once all the branches have completed.
+ */
+struct fork_branch {
+  const char *name;		// script name or inline commands
+  int inline_cmds;		// 1 if name contains commands
+  pid_t pid;
+  FILE *out;			// captured output
+  int fd[2];			// stats pipe
+  int done;			// 1 once the branch has been reaped
+  int status;
+  double wall;
+  unsigned long events;
+};
+
+static void _fork_child (struct fork_branch *b)
+{
+  struct timeval t0, t1;
+  FILE *fp;
+  unsigned long ev0;
+  
+  close (b->fd[0]);
+  /* the trace files and the trace writer thread belong to the parent */
+  glob_sim->detachTraces ();
+  fflush (stdout);
+  fflush (stderr);
+  dup2 (fileno (b->out), 1);
+  dup2 (fileno (b->out), 2);
+
+  if (b->inline_cmds) {
+    char *buf = Strdup (b->name);
+    for (char *t = buf; *t; t++) {
+      if (*t == ';') *t = '\n';
+    }
+    fp = fmemopen (buf, strlen (buf), "r");
+  }
+  else {
+    fp = fopen (b->name, "r");
+  }
+  if (!fp) {
+    fprintf (stderr, "fork: could not open `%s'\n", b->name);
+    _exit (1);
+  }
+
+  gettimeofday (&t0, NULL);
+  ev0 = ActSimEvents::numExecuted ();
+  while (!LispCliRun (fp)) {
+    if (LispInterruptExecution) {
+      break;
+    }
+  }
+  fclose (fp);
+  gettimeofday (&t1, NULL);
+
+  b->wall = (t1.tv_sec - t0.tv_sec) + (t1.tv_usec - t0.tv_usec)*1e-6;
+  b->events = ActSimEvents::numExecuted () - ev0;
+  fflush (stdout);
+  fflush (stderr);
+  if (write (b->fd[1], &b->wall, sizeof (double)) != sizeof (double) ||
+      write (b->fd[1], &b->events, sizeof (unsigned long)) !=
+      sizeof (unsigned long)) {
+    _exit (1);
+  }
+  _exit (0);
+}
+
+int process_fork (int argc, char **argv)
+{
+  A_DECL (struct fork_branch, br);
+  int maxjobs, running, next;
+  
+  if (!glob_sim) { 
+    fprintf (stderr, "%s: No simulation?\n", argv[0]);
+    return LISP_RET_ERROR;
+  }
+
+  A_INIT (br);
+  for (int i=1; i < argc; i++) {
+    A_NEW (br, struct fork_branch);
+    if (strcmp (argv[i], "-e") == 0) {
+      if (i+1 == argc) {
+	fprintf (stderr, "%s: -e needs a command string\n", argv[0]);
+	A_FREE (br);
+	return LISP_RET_ERROR;
+      }
+      i++;
+      A_NEXT (br).inline_cmds = 1;
+    }
+    else {
+      A_NEXT (br).inline_cmds = 0;
+    }
+    A_NEXT (br).name = argv[i];
+    A_NEXT (br).pid = -1;
+    A_NEXT (br).out = NULL;
+    A_NEXT (br).done = 0;
+    A_NEXT (br).status = -1;
+    A_NEXT (br).wall = 0;
+    A_NEXT (br).events = 0;
+    A_INC (br);
+  }
+  if (A_LEN (br) == 0) {
+    fprintf (stderr, "Usage: %s <script>|-e <cmds> ...\n", argv[0]);
+    A_FREE (br);
+    return LISP_RET_ERROR;
+  }
+
+  maxjobs = sysconf (_SC_NPROCESSORS_ONLN);
+  if (maxjobs < 1) {
+    maxjobs = 1;
+  }
+
+  fflush (stdout);
+  fflush (stderr);
+  running = 0;
+  next = 0;
+  while (next < A_LEN (br) || running > 0) {
+    if (next < A_LEN (br) && running < maxjobs) {
+      struct fork_branch *b = &br[next++];
+      b->out = tmpfile ();
+      if (!b->out || pipe (b->fd) != 0) {
+	fprintf (stderr, "%s: could not create branch `%s'\n", argv[0],
+		 b->name);
+	if (b->out) {
+	  fclose (b->out);
+	  b->out = NULL;
+	}
+	continue;
+      }
+      b->pid = fork ();
+      if (b->pid == 0) {
+	_fork_child (b);
+      }
+      close (b->fd[1]);
+      if (b->pid < 0) {
+	fprintf (stderr, "%s: fork failed for `%s'\n", argv[0], b->name);
+	close (b->fd[0]);
+	continue;
+      }
+      running++;
+    }
+    else {
+      /* only reap our own branches: wait for the oldest one */
+      int status;
+      struct fork_branch *b = NULL;
+      for (int i=0; i < next; i++) {
+	if (br[i].pid > 0 && !br[i].done) {
+	  b = &br[i];
+	  break;
+	}
+      }
+      Assert (b, "Running branch count is inconsistent");
+      if (waitpid (b->pid, &status, 0) != b->pid) {
+	break;
+      }
+      b->done = 1;
+      b->status = WIFEXITED (status) ? WEXITSTATUS (status) : -1;
+      if (read (b->fd[0], &b->wall, sizeof (double)) != sizeof (double) ||
+	  read (b->fd[0], &b->events, sizeof (unsigned long)) !=
+	  sizeof (unsigned long)) {
+	b->wall = 0;
+	b->events = 0;
+      }
+      close (b->fd[0]);
+      running--;
+    }
+  }
+
+  for (int i=0; i < A_LEN (br); i++) {
+    printf ("--- branch %d: %s%s\n", i, br[i].inline_cmds ? "-e " : "",
+	    br[i].name);
+    if (br[i].out) {
+      char buf[1024];
+      size_t sz;
+      rewind (br[i].out);
+      while ((sz = fread (buf, 1, sizeof (buf), br[i].out)) > 0) {
+	fwrite (buf, 1, sz, stdout);
+      }
+      fclose (br[i].out);
+    }
+    printf ("--- branch %d: status %d, %.3f s, %lu events\n", i,
+	    br[i].status, br[i].wall, br[i].events);
+  }
+  A_FREE (br);
+  return LISP_RET_TRUE;
+}
+
+struct LispCliCommand Cmds[] = {
+  { NULL, "Initialization and setup", NULL },
+
+  { "echo", "[-n] args - display to screen", process_echo },
+  { "error", "<str> - report error and abort execution", process_error },
+  
+  { "initialize", "[-q] [-l] <proc> - initialize simulation for <proc> (-q: use the CHP run queue; -l: levelized reset)",
+    process_initialize },
+
+  { "mode", "reset|run - set running mode", process_mode },
+  
+  { "random", "[-u] [min max] - randomize timings; -u only randomizes unspecified times", process_random },
+  { "random_seed", "<val> - set random number seed", process_random_seed },
+  { "norandom", "- deterministic timing", process_norandom },
+  { "random_choice", "on|off - randomize non-deterministic choices", process_random_choice },
+
+#if 0
+  { "dumptc", "<file> - dump transition counts to a file", process_dumptc },
+#endif
+
+  { NULL, "Running simulation", NULL },
+
+  { "step", "[n] - run the next [n] events", process_step },
+  { "advance", "<delay> - run for <delay> time", process_advance },
+  { "cycle", "- run until simulation stops", process_cycle },
+
+  { "pending", "- dump pending events", process_pending },
+  { "event-stats", "[-c] - show event scheduling statistics (wake-ups from wait objects are not counted); -c clears them", process_evstats },
+  { "profile", "start|stop|clear|report [-top N] [-events] [-folded <file>] - per-instance event/time profile; -events leaves out timing; -folded writes flame graph stacks", process_profile },
+  { "prs-classes", "[<inst-name>] - histogram of production rule gate classes", process_prs_classes },
+  
+  { "set", "<name> <val> - set a variable to a value", process_set },
+  { "gc-retry", "<name> - re-try guards in a deadlocked process", process_wakeup },
+  { "skip-comm", "<name> - skip the communication action", process_skipcomm },
+  
+  { "get", "<name> [#f] - get value of a variable; optional arg turns off display", process_get },
+  { "mget", "<name1> <name2> ... - multi-get value of a variable; a Boolean bus can be written as name[lo..hi]", process_mget },
+  { "chcount", "<name> [#f] - return the number of completed actions on named channel", process_chcount },
+
+  { "watch", "<n1> <n2> ... - add watchpoint for <n1> etc.", process_watch },
+  { "unwatch", "<n1> <n2> ... - delete watchpoint for <n1> etc.", process_unwatch },
+  { "breakpt", "<n> - toggle breakpoint for <n>", process_breakpt },
+  { "break", "<n> - toggle breakpoint for <n>", process_breakpt },
+  { "assert", "<name> <value> - compares the value of a variable or the channel status to a wanted value - exists sim if exit-on-warn is set", process_assert },
+
+  { "break-on-warn", "- stop simulation on warning", process_break_on_warn },
+  { "exit-on-warn", "- like break-on-warn, but exit", process_exit_on_warn },
+  { "resume-on-warn", "- continue simulation on warning", process_resume_on_warn },
+
+  { "status", "0|1|X - list all nodes with specified value", process_status },
+
+  { "fork", "<script>|-e <cmds> ... - run each script (or ;-separated commands) in a forked copy of the simulation", process_fork },
+  { "checkpoint", "<file> - save the simulation state to <file>", process_checkpoint },
+  { "restore", "<file> - restore the simulation state from <file>", process_restore },
+
+  { "timescale", "<t> - set time scale to <t> picoseconds for tracing", process_timescale },
+  { "get_sim_time", "- returns current simulation time in picoseconds", process_get_sim_time },
+  { "get_sim_itime", "- returns current simulation time (integer)", process_get_sim_itime },
+  { "vcd_start", "<file> - Create Verilog change dump for all watched values", process_createvcd },
+  { "vcd_stop", "- Stop VCD generation", process_stopvcd },
+  { "trace_start", "[-fmt] <file> - Create trace file in specified format for all watched values", process_createalint },
+  { "trace_stop", "[-fmt] - Stop trace file generation for specified format", process_stopalint },
+  { "lxt2_start", "<file> - Create LXT2 format trace file for all watched values", process_createlxt2 },
+  { "lxt2_stop", "- Stop LXT2 trace file generation", process_stoplxt2 },
+  { "trace-stats", "[-v] - show statistics for the background trace writer (sim.trace_async); -v adds the timing-dependent counters", process_trstats },
+  { "trace_all", "[-depth N] [-filter regex] [-inst name] <file> - trace every bool/int/chan into a native trace file", process_trace_all },
+  { "trace_all_stop", "[-s] - stop trace_all; -s prints statistics", process_trace_all_stop },
+  { "trace_query", "<file> <name> <t> | <t0> <t1> - value of <name> at time <t>, or its changes in [t0,t1], from a closed trace_all file", process_trace_query },
+
+
+#if 0  
+  { NULL, "Production rule tracing", NULL },
+
+  { "fanin", "<n> - list fanin for <n>", process_fanin },
+  { "fanin-get", "<n> - list fanin with values for <n>", process_fanin_get },
+  { "fanout", "<n> - list fanout for <n>", process_fanout },
+  
+#endif  
+
+  { NULL, "Process and CHP commands", NULL },
+
+#if 0
+  { "send", "<chan> <val> - send a value on a channel", process_send },
+  { "recv", "<chan> [#f] - receive a value from a channel; optional arg turns off display", process_recv },
+#endif
+
+  { "filter", "<regexp> - only show log messages that match regexp", process_filter },
+  { "logfile", "<file> - dump actsim log output to a log file <file>", process_logfile },
+  
+  { "procinfo", "<filename> [<inst-name>] - save the program counter for a process to file (- for stdout)", process_procinfo },
+  { "energy", "[-v] <filename> [<inst-name>] - save energy usage to file (- for stdout)", process_getenergy },
+  { "coverage", "<filename> [<inst-name>] - report coverage for guards", process_coverage },
+  { "goto", "[<inst-name>] <label> - for a single-threaded state, jump to label", process_goto }
+};
+
+/* -- access top-level Act  -- */
+Act *actsim_Act()
+{
+  return glob_act;
+}
+
+Process *actsim_top()
 {
   return glob_top;
 }
 
 int debug_metrics;
 
+/*
+ * Design-level passes for a top-level process: CHP function inlining
+ * (if requested) and the state pass.
+ */
+static void prepare_sim (Process *p, int do_inline)
+{
+  /* inline if specified */
+  if (do_inline) {
+    ActCHPFuncInline *ip = new ActCHPFuncInline (glob_act);
+    ip->run (p);
+  }
+  
+  glob_top = p;
+
+  /* do stuff here */
+  if (glob_sp) {
+    delete glob_sp;
+  }
+  glob_sp = new ActStatePass (glob_act);
+  glob_sp->run (p);
+}
+
+/* create the simulation; prepare_sim() must have been run for p */
+static void create_sim (Process *p, int monitors)
+{
+  /* check if we have an SDF file specified */
+  SDF *sdf_data = NULL;
+  if (config_exists ("sim.sdf_file")) {
+    sdf_data = new SDF (config_get_int ("sim.sdf_mangled_names") ? true : false);
+    if (!sdf_data->Read (config_get_string ("sim.sdf_file"))) {
+      warning ("SDF file `%s': reading failed; omitting.",
+	       config_get_string ("sim.sdf_file"));
+      delete sdf_data;
+      sdf_data = NULL;
+    }
+  }
+  
+  if (monitors) {
+    ActExclMonitor::enable = true;
+  }
+  else {
+    ActExclMonitor::enable = false;
+  }
+
+  glob_sim = new ActSim (p, sdf_data);
+  glob_dummy = new DummyObject ();
+  glob_sim->runInit ();
+  ActExclConstraint::_sc = glob_sim;
+}
+
+static void build_sim (Process *p, int do_inline, int monitors)
+{
+  prepare_sim (p, do_inline);
+  create_sim (p, monitors);
+}
+
+
+/*------------------------------------------------------------------------
+ *
+ *  Batch mode: the design is read and expanded once. The state pass
+ *  is run once per distinct top-level process, in the parent; each
+ *  test then runs in a forked child that builds its own simulation.
+ *
+ *------------------------------------------------------------------------
+ */
+struct batch_test {
+  char *proc;			// top-level process
+  char *script;			// script (NULL = "cycle")
+  char *expect;			// expected stdout (optional)
+  Process *p;			// expanded process, NULL if not found
+  pid_t pid;
+  int fd[2];			// stats pipe
+  int done;			// 1 once the branch has been reaped
+  int status;
+  int pass;
+  double wall;
+  unsigned long events;
+};
+
+static int _same_file (FILE *a, const char *fname)
+{
+  FILE *b = fopen (fname, "r");
+  int ca, cb;
+  if (!b) {
+    return 0;
+  }
+  rewind (a);
+  do {
+    ca = fgetc (a);
+    cb = fgetc (b);
+  } while (ca == cb && ca != EOF);
+  fclose (b);
+  return (ca == cb) ? 1 : 0;
+}
+
+static void _dump_file (FILE *fp)
+{
+  char buf[1024];
+  size_t sz;
+  rewind (fp);
+  while ((sz = fread (buf, 1, sizeof (buf), fp)) > 0) {
+    fwrite (buf, 1, sz, stdout);
+  }
+}
+
+static void _batch_child (struct batch_test *t, int monitors,
+			  FILE *out, FILE *err)
+{
+  struct timeval t0, t1;
+  FILE *fp;
+
+  close (t->fd[0]);
+  fflush (stdout);
+  fflush (stderr);
+  dup2 (fileno (out), 1);
+  dup2 (fileno (err), 2);
+
+  if (t->script) {
+    fp = fopen (t->script, "r");
+    if (!fp) {
+      fprintf (stderr, "Could not open script `%s'\n", t->script);
+      _exit (1);
+    }
+  }
+  else {
+    static char cyc[] = "cycle\n";
+    fp = fmemopen (cyc, strlen (cyc), "r");
+  }
+
+  gettimeofday (&t0, NULL);
+  create_sim (t->p, monitors);
+  LispInit ();
+  LispCliInit (NULL, ".actsim_history", "actsim> ", Cmds,
+	       sizeof (Cmds)/sizeof (Cmds[0]));
+  while (!LispCliRun (fp)) {
+    if (LispInterruptExecution) {
+      break;
+    }
+  }
+  fclose (fp);
+  gettimeofday (&t1, NULL);
+
+  t->wall = (t1.tv_sec - t0.tv_sec) + (t1.tv_usec - t0.tv_usec)*1e-6;
+  t->events = ActSimEvents::numExecuted ();
+
+  /* this flushes and closes any trace files the script opened */
+  delete glob_sim;
+  glob_sim = NULL;
+
+  fflush (stdout);
+  fflush (stderr);
+  if (write (t->fd[1], &t->wall, sizeof (double)) != sizeof (double) ||
+      write (t->fd[1], &t->events, sizeof (unsigned long)) !=
+      sizeof (unsigned long)) {
+    _exit (1);
+  }
+  _exit (0);
+}
+
+static int run_batch (const char *list, int jobs, int do_inline, int monitors)
+{
+  A_DECL (struct batch_test, tests);
+  FILE *lfp;
+  char buf[10240];
+  int next, running, nfail;
+
+  lfp = fopen (list, "r");
+  if (!lfp) {
+    fatal_error ("Could not open batch file `%s'", list);
+  }
+  A_INIT (tests);
+  while (fgets (buf, 10240, lfp)) {
+    char *f[3];
+    int n = 0;
+    char *tok = strtok (buf, " \t\n");
+    if (!tok || tok[0] == '#') {
+      continue;
+    }
+    while (tok && n < 3) {
+      f[n++] = tok;
+      tok = strtok (NULL, " \t\n");
+    }
+    A_NEW (tests, struct batch_test);
+    A_NEXT (tests).proc = Strdup (f[0]);
+    A_NEXT (tests).script = (n > 1 ? Strdup (f[1]) : NULL);
+    A_NEXT (tests).expect = (n > 2 ? Strdup (f[2]) : NULL);
+    A_NEXT (tests).p = NULL;
+    A_NEXT (tests).pid = -1;
+    A_NEXT (tests).done = 0;
+    A_NEXT (tests).status = -1;
+    A_NEXT (tests).pass = 0;
+    A_NEXT (tests).wall = 0;
+    A_NEXT (tests).events = 0;
+    A_INC (tests);
+  }
+  fclose (lfp);
+
+  if (jobs < 1) {
+    jobs = 1;
+  }
+
+  FILE **out, **err;
+  MALLOC (out, FILE *, A_LEN (tests) + 1);
+  MALLOC (err, FILE *, A_LEN (tests) + 1);
+  for (int i=0; i < A_LEN (tests); i++) {
+    struct batch_test *t = &tests[i];
+    out[i] = NULL;
+    err[i] = NULL;
+    t->p = glob_act->findProcess (t->proc, true);
+    if (t->p && !t->p->isExpanded()) {
+      t->p = t->p->Expand (ActNamespace::Global(), t->p->CurScope(), 0, NULL);
+    }
+    if (!t->p) {
+      err[i] = tmpfile ();
+      if (err[i]) {
+	fprintf (err[i], "Could not find process `%s'\n", t->proc);
+      }
+      t->done = 1;
+    }
+  }
+
+  fflush (stdout);
+  fflush (stderr);
+  for (int g=0; g < A_LEN (tests); g++) {
+    Process *p = tests[g].p;
+    if (!p || tests[g].pid != -1) {
+      continue;
+    }
+    /*-- all the tests for p: the state pass runs once, here --*/
+    prepare_sim (p, do_inline);
+    fflush (stdout);
+    fflush (stderr);
+    next = g;
+    running = 0;
+    while (1) {
+      while (next < A_LEN (tests) && tests[next].p != p) {
+	next++;
+      }
+      if (next < A_LEN (tests) && running < jobs) {
+	struct batch_test *t = &tests[next];
+	out[next] = tmpfile ();
+	err[next] = tmpfile ();
+	if (!out[next] || !err[next] || pipe (t->fd) != 0) {
+	  fatal_error ("batch: could not create test `%s'", t->proc);
+	}
+	t->pid = fork ();
+	if (t->pid == 0) {
+	  _batch_child (t, monitors, out[next], err[next]);
+	}
+	close (t->fd[1]);
+	if (t->pid < 0) {
+	  close (t->fd[0]);
+	  t->done = 1;
+	}
+	else {
+	  running++;
+	}
+	next++;
+      }
+      else if (running > 0) {
+	/* only reap our own tests: wait for the oldest one */
+	struct batch_test *t = NULL;
+	int status, i;
+	for (i=0; i < A_LEN (tests); i++) {
+	  if (tests[i].pid > 0 && !tests[i].done) {
+	    t = &tests[i];
+	    break;
+	  }
+	}
+	Assert (t, "Running test count is inconsistent");
+	if (waitpid (t->pid, &status, 0) != t->pid) {
+	  fatal_error ("batch: lost test `%s'", t->proc);
+	}
+	t->done = 1;
+	t->status = WIFEXITED (status) ? WEXITSTATUS (status) : -1;
+	if (read (t->fd[0], &t->wall, sizeof (double)) != sizeof (double) ||
+	    read (t->fd[0], &t->events, sizeof (unsigned long)) !=
+	    sizeof (unsigned long)) {
+	  t->wall = 0;
+	  t->events = 0;
+	}
+	close (t->fd[0]);
+	t->pass = (t->status == 0);
+	if (t->pass && t->expect) {
+	  t->pass = _same_file (out[i], t->expect);
+	}
+	if (t->pass) {
+	  /* only the output of failing tests is kept */
+	  fclose (out[i]);
+	  fclose (err[i]);
+	  out[i] = NULL;
+	  err[i] = NULL;
+	}
+	running--;
+      }
+      else {
+	break;
+      }
+    }
+  }
+
+  /*-- summary: one tab-separated line per test --*/
+  nfail = 0;
+  printf ("#test\tprocess\tscript\tresult\tstatus\tevents\twall\n");
+  for (int i=0; i < A_LEN (tests); i++) {
+    struct batch_test *t = &tests[i];
+    printf ("%d\t%s\t%s\t%s\t%d\t%lu\t%.3f\n", i, t->proc,
+	    t->script ? t->script : "-", t->pass ? "PASS" : "FAIL",
+	    t->status, t->events, t->wall);
+    if (!t->pass) {
+      nfail++;
+    }
+  }
+  printf ("#total %d, failed %d\n", A_LEN (tests), nfail);
+
+  /*-- output of the failing tests --*/
+  for (int i=0; i < A_LEN (tests); i++) {
+    struct batch_test *t = &tests[i];
+    if (!t->pass) {
+      if (out[i]) {
+	printf ("#--- test %d: stdout\n", i);
+	_dump_file (out[i]);
+	fclose (out[i]);
+      }
+      if (err[i]) {
+	printf ("#--- test %d: stderr\n", i);
+	_dump_file (err[i]);
+	fclose (err[i]);
+      }
+    }
+    FREE (t->proc);
+    if (t->script) FREE (t->script);
+    if (t->expect) FREE (t->expect);
+  }
+  FREE (out);
+  FREE (err);
+  A_FREE (tests);
+  return nfail > 0 ? 1 : 0;
+}
+
 int main (int argc, char **argv)
 {
   const char *metrics_tech_name;
@@ -1839,6 +3026,13 @@ int main (int argc, char **argv)
   config_set_default_int ("sim.chp.default_area", 0);
   config_set_default_int ("sim.chp.debug_metrics", 0);
   config_set_default_int ("sim.chp.detailed_delay_annotation", 0);
+  config_set_default_int ("sim.prs.compiled_eval", 1);
+  config_set_default_int ("sim.chp.compiled_expr", 1);
+  config_set_default_int ("sim.chp.run_queue", 0);
+  config_set_default_int ("sim.chp.coalesce", 0);
+  config_set_default_int ("sim.reset_levelized", 0);
+  config_set_default_int ("sim.trace_async", 0);
+  config_set_default_int ("sim.trace_buffer", 65536);
   config_set_int ("net.emit_parasitics", 1);
 
   /* initialize ACT library */
@@ -1858,8 +3052,20 @@ int main (int argc, char **argv)
   double d;
   int do_inline = 0;
   int monitors = 0;
-  while ((ch = getopt (argc, argv, "mS:p:nit:")) != -1) {
+  char *batch = NULL;
+  int jobs = 1, jobs_set = 0;
+  while ((ch = getopt (argc, argv, "mS:p:nit:b:j:")) != -1) {
     switch (ch) {
+    case 'b':
+      batch = optarg;
+      break;
+
+    case 'j':
+      jobs = atoi (optarg);
+      jobs_set = 1;
+      break;
+      
+
     case 'm':
       monitors = 1;
       break;
@@ -1898,7 +3104,16 @@ int main (int argc, char **argv)
   }
 
   /* some usage check */
-  if (optind != argc-2) {
+  if (jobs_set && !batch) {
+    fprintf (stderr, "-j is only used in batch mode (-b)\n");
+    usage (argv[0]);
+  }
+  if (batch) {
+    if (procname || optind != argc-1) {
+      usage (argv[0]);
+    }
+  }
+  else if (optind != argc-2) {
     if (!procname || optind != argc-1) {
       usage (argv[0]);
     }
@@ -1929,6 +3144,10 @@ int main (int argc, char **argv)
   //ActCellPass *cp = new ActCellPass (a);
   //cp->run();
  
+  if (batch) {
+    return run_batch (batch, jobs, do_inline, monitors);
+  }
+
   /* find the process specified on the command line */
   Process *p = glob_act->findProcess (procname, true);
 
@@ -1945,42 +3164,7 @@ int main (int argc, char **argv)
     fatal_error ("Process `%s' is not expanded.", procname);
   }
 
-  /* inline if specified */
-  if (do_inline) {
-    ActCHPFuncInline *ip = new ActCHPFuncInline (glob_act);
-    ip->run (p);
-  }
-  
-  glob_top = p;
-
-  /* do stuff here */
-  glob_sp = new ActStatePass (glob_act);
-  glob_sp->run (p);
-
-  /* check if we have an SDF file specified */
-  SDF *sdf_data = NULL;
-  if (config_exists ("sim.sdf_file")) {
-    sdf_data = new SDF (config_get_int ("sim.sdf_mangled_names") ? true : false);
-    if (!sdf_data->Read (config_get_string ("sim.sdf_file"))) {
-      warning ("SDF file `%s': reading failed; omitting.",
-	       config_get_string ("sim.sdf_file"));
-      delete sdf_data;
-      sdf_data = NULL;
-    }
-  }
-  
-  if (monitors) {
-    ActExclMonitor::enable = true;
-  }
-  else {
-    ActExclMonitor::enable = false;
-  }
-
-  glob_sim = new ActSim (p, sdf_data);
-  glob_dummy = new DummyObject ();
-  glob_sim->runInit ();
-  ActExclConstraint::_sc = glob_sim;
-
+  build_sim (p, do_inline, monitors);
 
   signal (SIGINT, signal_handler);
 
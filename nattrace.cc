@@ -0,0 +1,1177 @@
+/*************************************************************************
+ *
+ *  Copyright (c) 2024 Rajit Manohar
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA  02110-1301, USA.
+ *
+ **************************************************************************
+ */
+#include <string.h>
+#include <zlib.h>
+#include <act/tracelib.h>
+#include "nattrace.h"
+
+/* # of 64-bit words for a signal */
+#define NATTRACE_WORDS(w) ((w) <= 64 ? 1 : ((w) + 63)/64)
+
+
+/*------------------------------------------------------------------------
+ *
+ *  Writer
+ *
+ *------------------------------------------------------------------------
+ */
+
+ActNativeTraceWriter::ActNativeTraceWriter ()
+{
+  _fp = NULL;
+  _timescale = 1;
+  A_INIT (_sig);
+  _raw = NULL;
+  _rawlen = 0;
+  _rawmax = 0;
+  _z = NULL;
+  _zmax = 0;
+  _tfirst = 0;
+  _tprev = 0;
+  _nrec = 0;
+  _cur = NULL;
+  _curoff = NULL;
+  _curst = NULL;
+  _lastsec = NULL;
+  A_INIT (_sec);
+  A_INIT (_post);
+  _ndata = 0;
+  _nchanges = 0;
+  _nsections = 0;
+  _nkeys = 0;
+  _rawbytes = 0;
+  _filebytes = 0;
+}
+
+ActNativeTraceWriter::~ActNativeTraceWriter ()
+{
+  close ();
+  for (int i=0; i < A_LEN (_sig); i++) {
+    FREE (_sig[i].name);
+  }
+  A_FREE (_sig);
+}
+
+int ActNativeTraceWriter::open (const char *file, double timescale)
+{
+  Assert (!_fp, "Trace file already open");
+  _fp = fopen (file, "wb");
+  if (!_fp) {
+    return 0;
+  }
+  _timescale = timescale;
+  return 1;
+}
+
+int ActNativeTraceWriter::addSignal (const char *name, int type, int width)
+{
+  A_NEW (_sig, struct nattrace_signal);
+  A_NEXT (_sig).name = Strdup (name);
+  A_NEXT (_sig).type = type;
+  A_NEXT (_sig).width = width;
+  A_INC (_sig);
+  return A_LEN (_sig) - 1;
+}
+
+void ActNativeTraceWriter::_write (const void *buf, int len)
+{
+  if (fwrite (buf, 1, len, _fp) != (size_t) len) {
+    fatal_error ("Failed to write trace file");
+  }
+  _filebytes += len;
+}
+
+void ActNativeTraceWriter::_writeVarint (unsigned long v)
+{
+  unsigned char buf[10];
+  int n = 0;
+  do {
+    buf[n] = v & 0x7f;
+    v >>= 7;
+    if (v) {
+      buf[n] |= 0x80;
+    }
+    n++;
+  } while (v);
+  _write (buf, n);
+}
+
+void ActNativeTraceWriter::start ()
+{
+  unsigned char c;
+  int nw;
+
+  Assert (_fp, "What?");
+  _write (NATTRACE_MAGIC, 8);
+  c = NATTRACE_VERSION;
+  _write (&c, 1);
+  _write (&_timescale, sizeof (double));
+  _writeVarint (A_LEN (_sig));
+  for (int i=0; i < A_LEN (_sig); i++) {
+    int len = strlen (_sig[i].name);
+    c = _sig[i].type;
+    _write (&c, 1);
+    _writeVarint (_sig[i].width);
+    _writeVarint (len);
+    _write (_sig[i].name, len);
+  }
+
+  _rawmax = NATTRACE_BLOCK + 1024;
+  MALLOC (_raw, unsigned char, _rawmax);
+  _zmax = compressBound (_rawmax);
+  MALLOC (_z, unsigned char, _zmax);
+  _rawlen = 0;
+  _nrec = 0;
+
+  /* current values, for keyframes */
+  nw = 0;
+  if (A_LEN (_sig) > 0) {
+    MALLOC (_curoff, int, A_LEN (_sig));
+    MALLOC (_curst, unsigned char, A_LEN (_sig));
+    MALLOC (_lastsec, int, A_LEN (_sig));
+  }
+  for (int i=0; i < A_LEN (_sig); i++) {
+    _curoff[i] = nw;
+    _curst[i] = 0;
+    _lastsec[i] = -1;
+    nw += NATTRACE_WORDS (_sig[i].width);
+  }
+  if (nw > 0) {
+    MALLOC (_cur, unsigned long, nw);
+    for (int i=0; i < nw; i++) {
+      _cur[i] = 0;
+    }
+  }
+}
+
+void ActNativeTraceWriter::_need (int n)
+{
+  if (_rawlen + n > _rawmax) {
+    _rawmax = _rawlen + n + NATTRACE_BLOCK;
+    REALLOC (_raw, unsigned char, _rawmax);
+  }
+}
+
+void ActNativeTraceWriter::_putByte (unsigned char c)
+{
+  _raw[_rawlen++] = c;
+}
+
+void ActNativeTraceWriter::_put (unsigned long v)
+{
+  do {
+    unsigned char c = v & 0x7f;
+    v >>= 7;
+    if (v) {
+      c |= 0x80;
+    }
+    _raw[_rawlen++] = c;
+  } while (v);
+}
+
+/* value part of a record; the caller has made space */
+void ActNativeTraceWriter::_putValue (int id, int state, int nw,
+				      const unsigned long *v)
+{
+  /* drop leading zero words */
+  while (nw > 1 && v[nw-1] == 0) {
+    nw--;
+  }
+  switch (_sig[id].type) {
+  case NATTRACE_BOOL:
+    _putByte (v[0]);
+    break;
+
+  case NATTRACE_CHAN:
+    _putByte (state);
+    /* fall through */
+  case NATTRACE_INT:
+    _put (nw);
+    for (int i=0; i < nw; i++) {
+      _put (v[i]);
+    }
+    break;
+
+  default:
+    fatal_error ("What?");
+    break;
+  }
+}
+
+void ActNativeTraceWriter::change (unsigned long tm, int id, int state,
+				   int nw, const unsigned long *v)
+{
+  Assert (_raw, "Trace not started");
+  Assert (0 <= id && id < A_LEN (_sig), "Illegal signal id");
+
+  if (_nrec > 0 && tm < _tprev) {
+    /* time went backward (checkpoint restore): start a new section */
+    _flushSection ();
+  }
+  if (_nrec == 0) {
+    _tfirst = tm;
+    _tprev = tm;
+  }
+
+  /* worst case record size */
+  _need (10 + 10 + 1 + 10 + 10*nw);
+  _put (tm - _tprev);
+  _put (id);
+  _putValue (id, state, nw, v);
+
+  /* remember the value for the next keyframe */
+  int cw = NATTRACE_WORDS (_sig[id].width);
+  for (int i=0; i < cw; i++) {
+    _cur[_curoff[id] + i] = (i < nw ? v[i] : 0);
+  }
+  _curst[id] = state;
+
+  /* the section being built is the next entry in the section table */
+  if (_lastsec[id] != A_LEN (_sec)) {
+    _lastsec[id] = A_LEN (_sec);
+    A_NEW (_post, unsigned long);
+    A_NEXT (_post) = (((unsigned long)A_LEN (_sec)) << 32) | id;
+    A_INC (_post);
+  }
+
+  _tprev = tm;
+  _nrec++;
+  _nchanges++;
+
+  if (_rawlen >= NATTRACE_BLOCK) {
+    _flushSection ();
+  }
+}
+
+/* compress _raw and write it out as a section */
+void ActNativeTraceWriter::_writeSection (int tag, unsigned long tfirst,
+					  unsigned long tlast,
+					  unsigned long nrec)
+{
+  unsigned long zlen;
+  unsigned char c = tag;
+
+  if (compressBound (_rawlen) > _zmax) {
+    _zmax = compressBound (_rawlen);
+    REALLOC (_z, unsigned char, _zmax);
+  }
+  zlen = _zmax;
+  if (compress2 (_z, &zlen, _raw, _rawlen, Z_DEFAULT_COMPRESSION) != Z_OK) {
+    fatal_error ("Trace compression failed");
+  }
+
+  if (tag == NATTRACE_SEC_DATA || tag == NATTRACE_SEC_KEY) {
+    A_NEW (_sec, struct nattrace_section);
+    A_NEXT (_sec).off = _filebytes;
+    A_NEXT (_sec).tfirst = tfirst;
+    A_NEXT (_sec).tlast = tlast;
+    A_NEXT (_sec).tag = tag;
+    A_INC (_sec);
+  }
+
+  _write (&c, 1);
+  _writeVarint (tfirst);
+  _writeVarint (tlast);
+  _writeVarint (nrec);
+  _writeVarint (_rawlen);
+  _writeVarint (zlen);
+  _write (_z, zlen);
+
+  _rawbytes += _rawlen;
+  _rawlen = 0;
+}
+
+void ActNativeTraceWriter::_flushSection ()
+{
+  if (_nrec == 0) {
+    return;
+  }
+  _writeSection (NATTRACE_SEC_DATA, _tfirst, _tprev, _nrec);
+  _nsections++;
+  _nrec = 0;
+
+  _ndata++;
+  if ((_ndata % NATTRACE_KEYFRAME) == 0) {
+    _writeKeyframe ();
+  }
+}
+
+/* snapshot of all signals, as of the last record written */
+void ActNativeTraceWriter::_writeKeyframe ()
+{
+  Assert (_rawlen == 0, "What?");
+  for (int i=0; i < A_LEN (_sig); i++) {
+    int nw = NATTRACE_WORDS (_sig[i].width);
+    _need (1 + 10 + 10*nw);
+    _putValue (i, _curst[i], nw, _cur + _curoff[i]);
+  }
+  _writeSection (NATTRACE_SEC_KEY, _tprev, _tprev, A_LEN (_sig));
+  _nkeys++;
+}
+
+void ActNativeTraceWriter::_writeIndex ()
+{
+  unsigned long idxoff, prev;
+  unsigned long *cnt;
+  unsigned char c;
+  int i, j;
+
+  idxoff = _filebytes;
+
+  Assert (_rawlen == 0, "What?");
+  _need (10 + A_LEN (_sec)*(1 + 30));
+  _put (A_LEN (_sec));
+  for (i=0; i < A_LEN (_sec); i++) {
+    _putByte (_sec[i].tag);
+    _put (_sec[i].off);
+    _put (_sec[i].tfirst);
+    _put (_sec[i].tlast);
+  }
+
+  /* _post is sorted by section; group it by signal */
+  MALLOC (cnt, unsigned long, A_LEN (_sig) + 1);
+  for (i=0; i <= A_LEN (_sig); i++) {
+    cnt[i] = 0;
+  }
+  for (i=0; i < A_LEN (_post); i++) {
+    cnt[(_post[i] & 0xffffffffUL) + 1]++;
+  }
+  _need (10*A_LEN (_sig));
+  for (i=0; i < A_LEN (_sig); i++) {
+    _put (cnt[i+1]);
+  }
+  for (i=0; i < A_LEN (_sig); i++) {
+    cnt[i+1] += cnt[i];
+  }
+  if (A_LEN (_post) > 0) {
+    unsigned long *sorted;
+    MALLOC (sorted, unsigned long, A_LEN (_post));
+    for (i=0; i < A_LEN (_post); i++) {
+      sorted[cnt[_post[i] & 0xffffffffUL]++] = _post[i] >> 32;
+    }
+    /* cnt[k] is now the end of signal k's list */
+    _need (10*A_LEN (_post));
+    j = 0;
+    prev = 0;
+    for (i=0; i < A_LEN (_post); i++) {
+      while (i >= (int)cnt[j]) {
+	j++;
+	prev = 0;
+      }
+      _put (sorted[i] - prev);
+      prev = sorted[i];
+    }
+    FREE (sorted);
+  }
+  FREE (cnt);
+  _writeSection (NATTRACE_SEC_INDEX,
+		 A_LEN (_sec) > 0 ? _sec[0].tfirst : 0,
+		 A_LEN (_sec) > 0 ? _sec[A_LEN (_sec)-1].tlast : 0,
+		 A_LEN (_sec));
+
+  /* trailer */
+  c = NATTRACE_SEC_TRAILER;
+  _write (&c, 1);
+  for (i=0; i < 4; i++) {
+    _writeVarint (0);
+  }
+  _writeVarint (16);
+  _write (&idxoff, 8);
+  _write (NATTRACE_TRAILER_MAGIC, 8);
+}
+
+void ActNativeTraceWriter::close ()
+{
+  if (_fp) {
+    if (_raw) {
+      _flushSection ();
+      _writeIndex ();
+    }
+    fclose (_fp);
+    _fp = NULL;
+  }
+  if (_raw) {
+    FREE (_raw);
+    _raw = NULL;
+  }
+  if (_z) {
+    FREE (_z);
+    _z = NULL;
+  }
+  if (_cur) {
+    FREE (_cur);
+    _cur = NULL;
+  }
+  if (_curoff) {
+    FREE (_curoff);
+    FREE (_curst);
+    FREE (_lastsec);
+    _curoff = NULL;
+    _curst = NULL;
+    _lastsec = NULL;
+  }
+  A_FREE (_sec);
+  A_INIT (_sec);
+  A_FREE (_post);
+  A_INIT (_post);
+}
+
+void ActNativeTraceWriter::printStats (FILE *fp)
+{
+  fprintf (fp, "Signals          : %d\n", A_LEN (_sig));
+  fprintf (fp, "Changes          : %lu\n", _nchanges);
+  fprintf (fp, "Sections         : %lu (%lu keyframes)\n",
+	   _nsections, _nkeys);
+  fprintf (fp, "Bytes (raw/file) : %lu / %lu\n", _rawbytes, _filebytes);
+}
+
+
+/*------------------------------------------------------------------------
+ *
+ *  Reader
+ *
+ *------------------------------------------------------------------------
+ */
+
+static void _buf_init (struct nattrace_buf *b)
+{
+  b->raw = NULL;
+  b->rawlen = 0;
+  b->rawmax = 0;
+  b->pos = 0;
+  b->tprev = 0;
+}
+
+static void _buf_free (struct nattrace_buf *b)
+{
+  if (b->raw) {
+    FREE (b->raw);
+  }
+  _buf_init (b);
+}
+
+ActNativeTraceReader::ActNativeTraceReader ()
+{
+  _fp = NULL;
+  _timescale = 1;
+  A_INIT (_sig);
+  _names = NULL;
+  _start = 0;
+  _fsize = 0;
+  _buf_init (&_seq);
+  _buf_init (&_q);
+  _z = NULL;
+  _zmax = 0;
+  _val = NULL;
+  _valmax = 0;
+  A_INIT (_sec);
+  _post = NULL;
+  _postidx = NULL;
+  _qdone = 1;
+}
+
+ActNativeTraceReader::~ActNativeTraceReader ()
+{
+  close ();
+}
+
+void ActNativeTraceReader::close ()
+{
+  if (_fp) {
+    fclose (_fp);
+    _fp = NULL;
+  }
+  for (int i=0; i < A_LEN (_sig); i++) {
+    FREE (_sig[i].name);
+  }
+  A_FREE (_sig);
+  A_INIT (_sig);
+  if (_names) {
+    hash_free (_names);
+    _names = NULL;
+  }
+  _buf_free (&_seq);
+  _buf_free (&_q);
+  if (_z) {
+    FREE (_z);
+    _z = NULL;
+  }
+  if (_val) {
+    FREE (_val);
+    _val = NULL;
+  }
+  A_FREE (_sec);
+  A_INIT (_sec);
+  if (_post) {
+    FREE (_post);
+    _post = NULL;
+  }
+  if (_postidx) {
+    FREE (_postidx);
+    _postidx = NULL;
+  }
+  _zmax = 0;
+  _valmax = 0;
+  _qdone = 1;
+}
+
+int ActNativeTraceReader::_readVarint (unsigned long *v)
+{
+  int c, sh = 0;
+  *v = 0;
+  do {
+    c = getc (_fp);
+    if (c == EOF || sh > 63) {
+      return 0;
+    }
+    *v |= ((unsigned long)(c & 0x7f)) << sh;
+    sh += 7;
+  } while (c & 0x80);
+  return 1;
+}
+
+int ActNativeTraceReader::open (const char *file)
+{
+  char magic[8];
+  unsigned char c;
+  unsigned long nsig;
+
+  close ();
+  _fp = fopen (file, "rb");
+  if (!_fp) {
+    return 0;
+  }
+  if (fread (magic, 1, 8, _fp) != 8 ||
+      strncmp (magic, NATTRACE_MAGIC, 8) != 0 ||
+      fread (&c, 1, 1, _fp) != 1 ||
+      c < 1 || c > NATTRACE_VERSION ||
+      fread (&_timescale, sizeof (double), 1, _fp) != 1 ||
+      !_readVarint (&nsig)) {
+    close ();
+    return 0;
+  }
+  _names = hash_new (32);
+  for (unsigned long i=0; i < nsig; i++) {
+    unsigned long w, len;
+    int t = getc (_fp);
+    if (t == EOF || !_readVarint (&w) || !_readVarint (&len)) {
+      close ();
+      return 0;
+    }
+    A_NEW (_sig, struct nattrace_signal);
+    MALLOC (A_NEXT (_sig).name, char, len + 1);
+    if (fread (A_NEXT (_sig).name, 1, len, _fp) != len) {
+      FREE (A_NEXT (_sig).name);
+      close ();
+      return 0;
+    }
+    A_NEXT (_sig).name[len] = '\0';
+    A_NEXT (_sig).type = t;
+    A_NEXT (_sig).width = w;
+    if (!hash_lookup (_names, A_NEXT (_sig).name)) {
+      hash_bucket_t *b = hash_add (_names, A_NEXT (_sig).name);
+      b->i = A_LEN (_sig);
+    }
+    A_INC (_sig);
+  }
+  _start = ftell (_fp);
+  fseek (_fp, 0, SEEK_END);
+  _fsize = ftell (_fp);
+
+  /* section table: from the index if there is one, else by scanning */
+  if (!_readIndex ()) {
+    _scanSections ();
+  }
+  fseek (_fp, _start, SEEK_SET);
+  return 1;
+}
+
+int ActNativeTraceReader::findSignal (const char *name)
+{
+  hash_bucket_t *b;
+  if (!_names) {
+    return -1;
+  }
+  b = hash_lookup (_names, name);
+  if (!b) {
+    return -1;
+  }
+  return b->i;
+}
+
+int ActNativeTraceReader::_readHeader (int *tag,
+				       unsigned long *tfirst,
+				       unsigned long *tlast,
+				       unsigned long *nrec,
+				       unsigned long *rawlen,
+				       unsigned long *zlen)
+{
+  *tag = getc (_fp);
+  if (*tag == EOF) {
+    return 0;
+  }
+  if (!_readVarint (tfirst) || !_readVarint (tlast) ||
+      !_readVarint (nrec) || !_readVarint (rawlen) ||
+      !_readVarint (zlen)) {
+    return 0;
+  }
+  return 1;
+}
+
+/* read and decompress section data at the current file position */
+int ActNativeTraceReader::_readBody (struct nattrace_buf *b,
+				     unsigned long rawlen,
+				     unsigned long zlen)
+{
+  if (zlen > _zmax) {
+    _zmax = zlen;
+    if (!_z) {
+      MALLOC (_z, unsigned char, _zmax);
+    }
+    else {
+      REALLOC (_z, unsigned char, _zmax);
+    }
+  }
+  if (rawlen > b->rawmax) {
+    b->rawmax = rawlen;
+    if (!b->raw) {
+      MALLOC (b->raw, unsigned char, b->rawmax);
+    }
+    else {
+      REALLOC (b->raw, unsigned char, b->rawmax);
+    }
+  }
+  if (fread (_z, 1, zlen, _fp) != zlen) {
+    warning ("Truncated trace file");
+    return 0;
+  }
+  unsigned long len = rawlen;
+  if (uncompress (b->raw, &len, _z, zlen) != Z_OK || len != rawlen) {
+    warning ("Corrupt section in trace file");
+    return 0;
+  }
+  b->rawlen = rawlen;
+  b->pos = 0;
+  return 1;
+}
+
+/* next data section for next() */
+int ActNativeTraceReader::_readSection ()
+{
+  int tag;
+  unsigned long tfirst, tlast, nrec, rawlen, zlen;
+
+  while (1) {
+    if (!_readHeader (&tag, &tfirst, &tlast, &nrec, &rawlen, &zlen)) {
+      if (tag != EOF) {
+	warning ("Truncated trace file");
+      }
+      return 0;
+    }
+    if (tag != NATTRACE_SEC_DATA) {
+      fseek (_fp, zlen, SEEK_CUR);
+      continue;
+    }
+    if (!_readBody (&_seq, rawlen, zlen)) {
+      return 0;
+    }
+    _seq.tprev = tfirst;
+    return 1;
+  }
+}
+
+/* load section <i> of the section table, keeping the file position */
+int ActNativeTraceReader::_loadSection (int i, struct nattrace_buf *b)
+{
+  long pos = ftell (_fp);
+  int tag, ret;
+  unsigned long tfirst, tlast, nrec, rawlen, zlen;
+
+  fseek (_fp, _sec[i].off, SEEK_SET);
+  ret = 0;
+  if (_readHeader (&tag, &tfirst, &tlast, &nrec, &rawlen, &zlen) &&
+      tag == _sec[i].tag) {
+    ret = _readBody (b, rawlen, zlen);
+    b->tprev = tfirst;
+  }
+  fseek (_fp, pos, SEEK_SET);
+  return ret;
+}
+
+/*
+ * No index (version 1, or the trace was not closed): build the
+ * section table from the section headers.
+ */
+void ActNativeTraceReader::_scanSections ()
+{
+  int tag;
+  unsigned long tfirst, tlast, nrec, rawlen, zlen;
+
+  fseek (_fp, _start, SEEK_SET);
+  while (1) {
+    long off = ftell (_fp);
+    if (!_readHeader (&tag, &tfirst, &tlast, &nrec, &rawlen, &zlen)) {
+      break;
+    }
+    if (ftell (_fp) + (long)zlen > _fsize) {
+      break;
+    }
+    if (tag == NATTRACE_SEC_DATA || tag == NATTRACE_SEC_KEY) {
+      A_NEW (_sec, struct nattrace_section);
+      A_NEXT (_sec).off = off;
+      A_NEXT (_sec).tfirst = tfirst;
+      A_NEXT (_sec).tlast = tlast;
+      A_NEXT (_sec).tag = tag;
+      A_INC (_sec);
+    }
+    fseek (_fp, zlen, SEEK_CUR);
+  }
+}
+
+int ActNativeTraceReader::_readIndex ()
+{
+  unsigned char buf[16];
+  unsigned long idxoff, nsec, n;
+  int tag;
+  unsigned long tfirst, tlast, nrec, rawlen, zlen;
+  struct nattrace_buf b;
+  int i;
+
+  if (_fsize < _start + 22) {
+    return 0;
+  }
+  fseek (_fp, _fsize - 16, SEEK_SET);
+  if (fread (buf, 1, 16, _fp) != 16 ||
+      strncmp ((char *)buf + 8, NATTRACE_TRAILER_MAGIC, 8) != 0) {
+    return 0;
+  }
+  memcpy (&idxoff, buf, 8);
+  if ((long)idxoff < _start || (long)idxoff >= _fsize) {
+    return 0;
+  }
+  fseek (_fp, idxoff, SEEK_SET);
+  if (!_readHeader (&tag, &tfirst, &tlast, &nrec, &rawlen, &zlen) ||
+      tag != NATTRACE_SEC_INDEX) {
+    return 0;
+  }
+  _buf_init (&b);
+  if (!_readBody (&b, rawlen, zlen)) {
+    _buf_free (&b);
+    return 0;
+  }
+
+  nsec = _get (&b);
+  for (unsigned long k=0; k < nsec; k++) {
+    A_NEW (_sec, struct nattrace_section);
+    A_NEXT (_sec).tag = _getByte (&b);
+    A_NEXT (_sec).off = _get (&b);
+    A_NEXT (_sec).tfirst = _get (&b);
+    A_NEXT (_sec).tlast = _get (&b);
+    A_INC (_sec);
+  }
+
+  MALLOC (_postidx, unsigned long, A_LEN (_sig) + 1);
+  _postidx[0] = 0;
+  for (i=0; i < A_LEN (_sig); i++) {
+    _postidx[i+1] = _postidx[i] + _get (&b);
+  }
+  n = _postidx[A_LEN (_sig)];
+  MALLOC (_post, unsigned int, n > 0 ? n : 1);
+  for (i=0; i < A_LEN (_sig); i++) {
+    unsigned long prev = 0;
+    for (unsigned long k=_postidx[i]; k < _postidx[i+1]; k++) {
+      prev += _get (&b);
+      if (prev >= nsec) {
+	fatal_error ("Corrupt index in trace file");
+      }
+      _post[k] = prev;
+    }
+  }
+  _buf_free (&b);
+  return 1;
+}
+
+unsigned long ActNativeTraceReader::_get (struct nattrace_buf *b)
+{
+  unsigned long v = 0;
+  int sh = 0;
+  unsigned char c;
+  do {
+    if (b->pos >= b->rawlen || sh > 63) {
+      fatal_error ("Corrupt record in trace file");
+    }
+    c = b->raw[b->pos++];
+    v |= ((unsigned long)(c & 0x7f)) << sh;
+    sh += 7;
+  } while (c & 0x80);
+  return v;
+}
+
+unsigned char ActNativeTraceReader::_getByte (struct nattrace_buf *b)
+{
+  if (b->pos >= b->rawlen) {
+    fatal_error ("Corrupt record in trace file");
+  }
+  return b->raw[b->pos++];
+}
+
+/* value of signal <id> into c, using the reader's value buffer */
+void ActNativeTraceReader::_getValue (struct nattrace_buf *b, int id,
+				      struct nattrace_change *c)
+{
+  unsigned long nw;
+
+  c->id = id;
+  c->state = 0;
+  switch (_sig[id].type) {
+  case NATTRACE_BOOL:
+    nw = 1;
+    break;
+
+  case NATTRACE_CHAN:
+    c->state = _getByte (b);
+    /* fall through */
+  case NATTRACE_INT:
+    nw = _get (b);
+    break;
+
+  default:
+    fatal_error ("Unknown signal type in trace file");
+    nw = 0;
+    break;
+  }
+  if (nw == 0 || nw > (1UL << 20)) {
+    fatal_error ("Corrupt record in trace file");
+  }
+  if ((int)nw > _valmax) {
+    _valmax = nw;
+    if (!_val) {
+      MALLOC (_val, unsigned long, _valmax);
+    }
+    else {
+      REALLOC (_val, unsigned long, _valmax);
+    }
+  }
+  if (_sig[id].type == NATTRACE_BOOL) {
+    _val[0] = _getByte (b);
+  }
+  else {
+    for (unsigned long i=0; i < nw; i++) {
+      _val[i] = _get (b);
+    }
+  }
+  c->nw = nw;
+  c->v = _val;
+}
+
+/* next record in a data section */
+int ActNativeTraceReader::_decode (struct nattrace_buf *b,
+				   struct nattrace_change *c)
+{
+  unsigned long id;
+
+  if (b->pos >= b->rawlen) {
+    return 0;
+  }
+  c->tm = b->tprev + _get (b);
+  id = _get (b);
+  if (id >= (unsigned long) A_LEN (_sig)) {
+    fatal_error ("Corrupt record in trace file");
+  }
+  _getValue (b, id, c);
+  b->tprev = c->tm;
+  return 1;
+}
+
+int ActNativeTraceReader::next (struct nattrace_change *c)
+{
+  while (_seq.pos >= _seq.rawlen) {
+    if (!_readSection ()) {
+      return 0;
+    }
+  }
+  return _decode (&_seq, c);
+}
+
+/* last section that starts at or before tm, -1 if none */
+int ActNativeTraceReader::_lastSection (unsigned long tm)
+{
+  int lo = 0, hi = A_LEN (_sec);
+  while (lo < hi) {
+    int mid = (lo + hi)/2;
+    if (_sec[mid].tfirst <= tm) {
+      lo = mid + 1;
+    }
+    else {
+      hi = mid;
+    }
+  }
+  return lo - 1;
+}
+
+/* last change of <id> at or before <tm> in data section <i> */
+int ActNativeTraceReader::_lastChange (int i, int id, unsigned long tm,
+				       struct nattrace_change *c)
+{
+  struct nattrace_change tmp;
+  unsigned long pos, tprev;
+  int found;
+
+  if (!_loadSection (i, &_q)) {
+    return 0;
+  }
+  found = 0;
+  pos = 0;
+  tprev = _q.tprev;
+  while (1) {
+    unsigned long p = _q.pos, t = _q.tprev;
+    if (!_decode (&_q, &tmp) || tmp.tm > tm) {
+      break;
+    }
+    if (tmp.id == id) {
+      pos = p;
+      tprev = t;
+      found = 1;
+    }
+  }
+  if (!found) {
+    return 0;
+  }
+  /* values share one buffer, so decode the record found again */
+  _q.pos = pos;
+  _q.tprev = tprev;
+  return _decode (&_q, c);
+}
+
+int ActNativeTraceReader::valueAt (int id, unsigned long tm,
+				   struct nattrace_change *c)
+{
+  int s, k;
+
+  Assert (0 <= id && id < A_LEN (_sig), "Illegal signal id");
+  s = _lastSection (tm);
+  if (s < 0) {
+    return 0;
+  }
+
+  if (_post) {
+    /* latest section at or before s that changes id */
+    unsigned long lo = _postidx[id], hi = _postidx[id+1];
+    while (lo < hi) {
+      unsigned long mid = (lo + hi)/2;
+      if ((int)_post[mid] <= s) {
+	lo = mid + 1;
+      }
+      else {
+	hi = mid;
+      }
+    }
+    /* the last candidate may only have changes after tm */
+    while (lo > _postidx[id]) {
+      lo--;
+      if (_lastChange (_post[lo], id, tm, c)) {
+	return 1;
+      }
+    }
+    return 0;
+  }
+
+  /* no index: search back to the closest keyframe */
+  for (k = s; k >= 0 && _sec[k].tag != NATTRACE_SEC_KEY; k--) {
+    if (_lastChange (k, id, tm, c)) {
+      return 1;
+    }
+  }
+  if (k < 0 || !_loadSection (k, &_q)) {
+    return 0;
+  }
+  for (int i=0; i <= id; i++) {
+    _getValue (&_q, i, c);
+  }
+  c->tm = _sec[k].tfirst;
+  return 1;
+}
+
+void ActNativeTraceReader::changesStart (int id, unsigned long t0,
+					 unsigned long t1)
+{
+  Assert (0 <= id && id < A_LEN (_sig), "Illegal signal id");
+  _qid = id;
+  _qt0 = t0;
+  _qt1 = t1;
+  _qdone = 0;
+  _q.pos = 0;
+  _q.rawlen = 0;
+
+  /* first section (or posting) that ends at or after t0 */
+  if (_post) {
+    unsigned long lo = _postidx[id], hi = _postidx[id+1];
+    while (lo < hi) {
+      unsigned long mid = (lo + hi)/2;
+      if (_sec[_post[mid]].tlast < t0) {
+	lo = mid + 1;
+      }
+      else {
+	hi = mid;
+      }
+    }
+    _qnext = lo;
+  }
+  else {
+    int lo = 0, hi = A_LEN (_sec);
+    while (lo < hi) {
+      int mid = (lo + hi)/2;
+      if (_sec[mid].tlast < t0) {
+	lo = mid + 1;
+      }
+      else {
+	hi = mid;
+      }
+    }
+    _qnext = lo;
+  }
+}
+
+int ActNativeTraceReader::changesNext (struct nattrace_change *c)
+{
+  while (!_qdone) {
+    if (_q.pos >= _q.rawlen) {
+      int s;
+      if (_post) {
+	if (_qnext >= (long)_postidx[_qid+1]) {
+	  break;
+	}
+	s = _post[_qnext++];
+      }
+      else {
+	if (_qnext >= A_LEN (_sec)) {
+	  break;
+	}
+	s = _qnext++;
+	if (_sec[s].tag != NATTRACE_SEC_DATA) {
+	  continue;
+	}
+      }
+      if (_sec[s].tfirst > _qt1 || !_loadSection (s, &_q)) {
+	break;
+      }
+    }
+    while (_decode (&_q, c)) {
+      if (c->tm > _qt1) {
+	_qdone = 1;
+	return 0;
+      }
+      if (c->id == _qid && c->tm >= _qt0) {
+	return 1;
+      }
+    }
+  }
+  _qdone = 1;
+  return 0;
+}
+
+
+/*------------------------------------------------------------------------
+ *
+ *  Value display
+ *
+ *------------------------------------------------------------------------
+ */
+
+static void _print_hex (FILE *fp, struct nattrace_change *c)
+{
+  int i = c->nw - 1;
+  while (i > 0 && c->v[i] == 0) {
+    i--;
+  }
+  fprintf (fp, "0x%lx", c->v[i]);
+  for (i--; i >= 0; i--) {
+    fprintf (fp, "%016lx", c->v[i]);
+  }
+}
+
+void nattrace_print_value (FILE *fp, int type, struct nattrace_change *c)
+{
+  switch (type) {
+  case NATTRACE_BOOL:
+    fprintf (fp, "%c", c->v[0] == 2 ? 'X' : (char)('0' + c->v[0]));
+    break;
+
+  case NATTRACE_INT:
+    _print_hex (fp, c);
+    break;
+
+  case NATTRACE_CHAN:
+    if (c->state == ACT_CHAN_VALUE) {
+      _print_hex (fp, c);
+    }
+    else if (c->state == ACT_CHAN_SEND_BLOCKED) {
+      fprintf (fp, "send-blocked");
+    }
+    else if (c->state == ACT_CHAN_RECV_BLOCKED) {
+      fprintf (fp, "recv-blocked");
+    }
+    else {
+      fprintf (fp, "idle");
+    }
+    break;
+
+  default:
+    fprintf (fp, "?");
+    break;
+  }
+}
+
+int nattrace_query (FILE *fp, const char *file, const char *name,
+		    unsigned long t0, unsigned long t1, int range)
+{
+  ActNativeTraceReader rd;
+  struct nattrace_change c;
+  int id;
+
+  if (!rd.open (file)) {
+    fprintf (stderr, "Could not read trace file `%s'\n", file);
+    return -1;
+  }
+  id = rd.findSignal (name);
+  if (id < 0) {
+    fprintf (stderr, "Signal `%s' not found in `%s'\n", name, file);
+    return -1;
+  }
+  if (!range) {
+    if (!rd.valueAt (id, t0, &c)) {
+      fprintf (fp, "%s: no value at %lu\n", name, t0);
+      return 0;
+    }
+    fprintf (fp, "%s: ", name);
+    nattrace_print_value (fp, rd.sigType (id), &c);
+    fprintf (fp, "  [changed at %lu]\n", c.tm);
+    return 1;
+  }
+  rd.changesStart (id, t0, t1);
+  while (rd.changesNext (&c)) {
+    fprintf (fp, "%lu %s: ", c.tm, name);
+    nattrace_print_value (fp, rd.sigType (id), &c);
+    fprintf (fp, "\n");
+  }
+  return 1;
+}
@@ -0,0 +1,282 @@
+/*************************************************************************
+ *
+ *  Copyright (c) 2024 Rajit Manohar
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA  02110-1301, USA.
+ *
+ **************************************************************************
+ */
+#ifndef __ACTSIM_NATTRACE_H__
+#define __ACTSIM_NATTRACE_H__
+
+#include <stdio.h>
+#include <common/misc.h>
+#include <common/array.h>
+#include <common/hash.h>
+
+/*
+ * actsim native trace format
+ *
+ * All integers other than the fixed header fields are unsigned LEB128
+ * varints.
+ *
+ *  header:   "ACTSIMTR"  (8 bytes)
+ *            version     (1 byte)
+ *            timescale   (8 bytes, double: seconds per time unit)
+ *            # signals
+ *            per signal: type (1 byte: 0 = bool, 1 = int, 2 = chan),
+ *                        bit width, name length, name
+ *
+ *  sections: tag (1 byte), first time, last time, # records,
+ *            uncompressed length, compressed length, zlib data
+ *
+ *  A data section (tag NATTRACE_SEC_DATA) holds a sequence of change
+ *  records:
+ *            time delta from the previous record (the first record
+ *              is relative to the first time of the section),
+ *            signal id,
+ *            value:  bool: 1 byte (0, 1, 2 = X)
+ *                    int:  # words, words
+ *                    chan: state (1 byte), # words, words
+ *
+ *  Version 2 adds:
+ *
+ *  keyframe (NATTRACE_SEC_KEY), after every NATTRACE_KEYFRAME data
+ *            sections: the value of every signal, in signal order,
+ *            after all the records that precede it. Both times are
+ *            the time of the last record before it.
+ *
+ *  index (NATTRACE_SEC_INDEX), written when the trace is closed:
+ *            # sections,
+ *            per section: tag (1 byte), file offset, first time,
+ *                         last time
+ *            per signal: # sections that change it, followed by the
+ *                        section numbers (delta-encoded)
+ *
+ *  trailer (NATTRACE_SEC_TRAILER): a section with zero times and
+ *            counts whose 16 data bytes are the file offset of the
+ *            index (8 bytes) and NATTRACE_TRAILER_MAGIC. It is always
+ *            the last 22 bytes of the file.
+ *
+ *  Readers skip sections with tags they do not know. Times are the
+ *  low 64 bits of the simulation time. Queries assume that time does
+ *  not go backward within a trace.
+ */
+#define NATTRACE_MAGIC   "ACTSIMTR"
+#define NATTRACE_VERSION 2
+
+#define NATTRACE_SEC_DATA    'D'
+#define NATTRACE_SEC_KEY     'K'
+#define NATTRACE_SEC_INDEX   'I'
+#define NATTRACE_SEC_TRAILER 'T'
+
+#define NATTRACE_TRAILER_MAGIC "ACTSIMIX"
+
+/* # of data sections between keyframes */
+#define NATTRACE_KEYFRAME 64
+
+#define NATTRACE_BOOL 0
+#define NATTRACE_INT  1
+#define NATTRACE_CHAN 2
+
+/* uncompressed size at which a section is closed */
+#define NATTRACE_BLOCK (64*1024)
+
+
+struct nattrace_signal {
+  char *name;
+  int type;
+  int width;
+};
+
+/* entry in the section table */
+struct nattrace_section {
+  unsigned long off;		// file offset
+  unsigned long tfirst, tlast;
+  int tag;
+};
+
+/* one change, as returned by the reader */
+struct nattrace_change {
+  unsigned long tm;
+  int id;
+  int state;			// channel state
+  int nw;			// # of words in v
+  unsigned long *v;		// value (owned by the reader)
+};
+
+
+class ActNativeTraceWriter {
+public:
+  ActNativeTraceWriter ();
+  ~ActNativeTraceWriter ();
+
+  int open (const char *file, double timescale); // 0 on failure
+
+  /* signals must all be added before start() */
+  int addSignal (const char *name, int type, int width);
+  void start ();
+
+  void change (unsigned long tm, int id, int state,
+	       int nw, const unsigned long *v);
+
+  void close ();
+  int isOpen () { return _fp ? 1 : 0; }
+  int numSignals () { return A_LEN (_sig); }
+
+  void printStats (FILE *fp);
+
+private:
+  FILE *_fp;
+  double _timescale;
+  A_DECL (struct nattrace_signal, _sig);
+
+  unsigned char *_raw;		// current section, uncompressed
+  int _rawlen, _rawmax;
+  unsigned char *_z;		// compression buffer
+  unsigned long _zmax;
+
+  unsigned long _tfirst, _tprev;
+  unsigned long _nrec;
+
+  /*-- for keyframes and the index --*/
+  unsigned long *_cur;		// current value of every signal
+  int *_curoff;			// offset of signal i in _cur
+  unsigned char *_curst;	// current channel state
+  int *_lastsec;		// last section that changed signal i
+  A_DECL (struct nattrace_section, _sec);
+  A_DECL (unsigned long, _post); // (section << 32) | signal id
+  unsigned long _ndata;
+
+  /* statistics */
+  unsigned long _nchanges;
+  unsigned long _nsections;
+  unsigned long _nkeys;
+  unsigned long _rawbytes;
+  unsigned long _filebytes;
+
+  void _flushSection ();
+  void _writeSection (int tag, unsigned long tfirst, unsigned long tlast,
+		      unsigned long nrec);
+  void _writeKeyframe ();
+  void _writeIndex ();
+  void _need (int n);
+  void _put (unsigned long v);
+  void _putByte (unsigned char c);
+  void _putValue (int id, int state, int nw, const unsigned long *v);
+  void _write (const void *buf, int len);
+  void _writeVarint (unsigned long v);
+};
+
+
+/* a decompressed section */
+struct nattrace_buf {
+  unsigned char *raw;
+  unsigned long rawlen, rawmax;
+  unsigned long pos;
+  unsigned long tprev;
+};
+
+
+class ActNativeTraceReader {
+public:
+  ActNativeTraceReader ();
+  ~ActNativeTraceReader ();
+
+  int open (const char *file);	// 0 on failure
+  void close ();
+
+  double getTimescale () { return _timescale; }
+  int numSignals () { return A_LEN (_sig); }
+  const char *sigName (int i) { return _sig[i].name; }
+  int sigType (int i) { return _sig[i].type; }
+  int sigWidth (int i) { return _sig[i].width; }
+  int findSignal (const char *name); // -1 if not found
+
+  int numSections () { return A_LEN (_sec); }
+  int hasIndex () { return _post ? 1 : 0; }
+
+  /* next change in file order; returns 0 at the end of the trace */
+  int next (struct nattrace_change *c);
+
+  /*
+   * Random access. These don't disturb next(). valueAt() returns the
+   * most recent change of signal <id> at or before <tm>, 0 if there
+   * isn't one.
+   */
+  int valueAt (int id, unsigned long tm, struct nattrace_change *c);
+
+  /* all changes of <id> in [t0,t1], returned by changesNext() */
+  void changesStart (int id, unsigned long t0, unsigned long t1);
+  int changesNext (struct nattrace_change *c);
+
+private:
+  FILE *_fp;
+  double _timescale;
+  A_DECL (struct nattrace_signal, _sig);
+  struct Hashtable *_names;
+  long _start;			// offset of the first section
+  long _fsize;
+
+  struct nattrace_buf _seq;	// for next()
+  struct nattrace_buf _q;	// for queries
+  unsigned char *_z;
+  unsigned long _zmax;
+
+  unsigned long *_val;		// value buffer handed out to callers
+  int _valmax;
+
+  /*-- section table, and per-signal section lists from the index --*/
+  A_DECL (struct nattrace_section, _sec);
+  unsigned int *_post;
+  unsigned long *_postidx;	// signal i: _post[_postidx[i].._postidx[i+1]]
+
+  /*-- changesStart/Next state --*/
+  int _qid;
+  unsigned long _qt0, _qt1;
+  long _qnext;			// next section (or posting) to read
+  int _qdone;
+
+  int _readVarint (unsigned long *v);
+  int _readHeader (int *tag, unsigned long *tfirst, unsigned long *tlast,
+		   unsigned long *nrec, unsigned long *rawlen,
+		   unsigned long *zlen);
+  int _readBody (struct nattrace_buf *b, unsigned long rawlen,
+		 unsigned long zlen);
+  int _readSection ();
+  int _loadSection (int i, struct nattrace_buf *b);
+  void _scanSections ();
+  int _readIndex ();
+  int _lastSection (unsigned long tm);
+  int _lastChange (int i, int id, unsigned long tm,
+		   struct nattrace_change *c);
+
+  unsigned long _get (struct nattrace_buf *b);
+  unsigned char _getByte (struct nattrace_buf *b);
+  void _getValue (struct nattrace_buf *b, int id,
+		  struct nattrace_change *c);
+  int _decode (struct nattrace_buf *b, struct nattrace_change *c);
+};
+
+/* print a value, as returned by the reader */
+void nattrace_print_value (FILE *fp, int type, struct nattrace_change *c);
+
+/* print the value of a signal at time t0, or with range set its
+   changes in [t0,t1]; -1 on error, 0 if there is no value at t0 */
+int nattrace_query (FILE *fp, const char *file, const char *name,
+		    unsigned long t0, unsigned long t1, int range);
+
+#endif /* __ACTSIM_NATTRACE_H__ */
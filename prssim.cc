@@ -33,6 +33,11 @@ PrsSim::PrsSim (PrsSimGraph *g, ActSimCore *sim, Process *p)
   _sim = NULL;
   _nobjs = 0;
   _inst_gate_delay = NULL;
+  _code = NULL;
+  for (int i=0; i < PRSSIM_NKINDS; i++) {
+    _nkind[i] = 0;
+  }
+  _ngeneric = 0;
 }
 
 PrsSim::~PrsSim()
@@ -50,6 +55,9 @@ PrsSim::~PrsSim()
   if (_inst_gate_delay) {
     FREE (_inst_gate_delay);
   }
+  if (_code) {
+    FREE (_code);
+  }
   _nobjs = 0;
 }
 
@@ -133,7 +141,7 @@ void PrsSim::printStatus (int val, bool io_glob)
 }
 
 
-void PrsSim::_computeFanout (prssim_expr *e, SimDES *s)
+void PrsSim::_computeFanout (prssim_expr *e, ActSimDES *s)
 {
   if (!e) return;
   switch (e->type) {
@@ -165,29 +173,175 @@ void PrsSim::_computeFanout (prssim_expr *e, SimDES *s)
 }
     
 
+/*
+ * Size of the postfix program for an expression; also returns the
+ * evaluation stack depth needed for it.
+ */
+int PrsSim::_codeSize (prssim_expr *e, int *depth)
+{
+  int a, b, da, db;
+  
+  if (!e) {
+    *depth = 1;
+    return 1;
+  }
+  switch (e->type) {
+  case PRSSIM_EXPR_AND:
+  case PRSSIM_EXPR_OR:
+    a = _codeSize (e->l, &da);
+    b = _codeSize (e->r, &db);
+    *depth = (da > db + 1) ? da : (db + 1);
+    return a + b + 1;
+    break;
+
+  case PRSSIM_EXPR_NOT:
+    return _codeSize (e->l, depth) + 1;
+    break;
+
+  case PRSSIM_EXPR_VAR:
+    *depth = 1;
+    return 2;
+    break;
+
+  case PRSSIM_EXPR_TRUE:
+  case PRSSIM_EXPR_FALSE:
+    *depth = 1;
+    return 1;
+    break;
+
+  default:
+    Assert (0, "What?");
+    break;
+  }
+  return 0;
+}
+
+int *PrsSim::_compile (prssim_expr *e, int *code)
+{
+  if (!e) {
+    *code++ = PRSSIM_OP_FALSE;
+    return code;
+  }
+  switch (e->type) {
+  case PRSSIM_EXPR_AND:
+  case PRSSIM_EXPR_OR:
+    code = _compile (e->l, code);
+    code = _compile (e->r, code);
+    *code++ = (e->type == PRSSIM_EXPR_AND ? PRSSIM_OP_AND : PRSSIM_OP_OR);
+    break;
+
+  case PRSSIM_EXPR_NOT:
+    code = _compile (e->l, code);
+    *code++ = PRSSIM_OP_NOT;
+    break;
+
+  case PRSSIM_EXPR_VAR:
+    *code++ = getGlobalOffset (e->vid, 0);
+    *code++ = e->vid;
+    break;
+
+  case PRSSIM_EXPR_TRUE:
+    *code++ = PRSSIM_OP_TRUE;
+    break;
+    
+  case PRSSIM_EXPR_FALSE:
+    *code++ = PRSSIM_OP_FALSE;
+    break;
+
+  default:
+    Assert (0, "What?");
+    break;
+  }
+  return code;
+}
+
+/*
+ * Returns the size of the compiled rule, or -1 if the rule cannot be
+ * compiled. If code is non-NULL, the program is written there.
+ */
+int PrsSim::_ruleCode (prssim_stmt *x, int *code)
+{
+  int sz = PRSSIM_CODE_HDR;
+  int depth;
+  
+  for (int i=0; i < 4; i++) {
+    prssim_expr *e = (i < 2) ? x->up[i] : x->dn[i-2];
+    int len = _codeSize (e, &depth);
+    if (depth > PRSSIM_MAX_STACK) {
+      return -1;
+    }
+    if (code) {
+      code[i] = sz;
+      int *end = _compile (e, code + sz);
+      *end = PRSSIM_OP_END;
+      Assert (end - code == sz + len, "What?");
+    }
+    sz += len + 1;
+  }
+  return sz;
+}
+    
+
 void PrsSim::computeFanout ()
 {
   prssim_stmt *x;
   int count = 0;
+  int codesz = 0;
 
   for (x = _g->getRules(); x; x = x->next) {
     count++;
+    if (x->type == PRSSIM_RULE && _sc->prsCompiledEval()) {
+      int sz = _ruleCode (x, NULL);
+      if (sz > 0) {
+	codesz += sz;
+      }
+    }
   }
   if (count > 0) {
     _nobjs = count;
     MALLOC (_sim, OnePrsSim, count);
   }
+  /* specialized gates are constructed in place in _sim[]; see the
+     static_assert in prssim.h */
+  if (codesz > 0) {
+    MALLOC (_code, int, codesz);
+  }
   count = 0;
+  codesz = 0;
   for (x = _g->getRules(); x; x = x->next) {
     /* -- create rule -- */
-    new (&_sim[count++]) OnePrsSim (this, x);
-    OnePrsSim *t = &_sim[count-1];
+    OnePrsSim *t = &_sim[count++];
+    int *code = NULL;
+    MultiPrsSim *mp = NULL;
+
+    if (x->type == PRSSIM_RULE) {
+      if (_code) {
+	int sz = _ruleCode (x, _code + codesz);
+	if (sz > 0) {
+	  code = _code + codesz;
+	  codesz += sz;
+	}
+      }
+      mp = _sc->getMulti (myGid (x->vid));
+    }
+
+    /* -- pick the simulation object for this gate -- */
+    _nkind[x->kind]++;
+    if (code && !mp && !_inst_gate_delay && x->kind == PRSSIM_KIND_STATIC) {
+      new (t) OnePrsSimRule<0> (this, x);
+    }
+    else if (code && !mp && !_inst_gate_delay && x->kind == PRSSIM_KIND_WEAK) {
+      new (t) OnePrsSimRule<1> (this, x);
+    }
+    else {
+      new (t) OnePrsSim (this, x);
+      _ngeneric++;
+    }
+    t->setCode (code);
 
     if (x->type == PRSSIM_RULE) {
       // XXX: check if this is part of a multi-driver!
-      int gid = myGid (x->vid);
-      MultiPrsSim *mp = _sc->getMulti (gid);
-      SimDES *_fo;
+      ActSimDES *_fo;
       if (mp) {
 #if 0
 	printf ("found multi! => ");
@@ -873,9 +1027,28 @@ PrsSimGraph *PrsSimGraph::buildPrsSimGraph (ActSimCore *sc, act_prs *p,
     pg->addPrs (sc, p->p, ci);
     p = p->next;
   }
+  pg->classify ();
   return pg;
 }
 
+void PrsSimGraph::classify ()
+{
+  for (struct prssim_stmt *s = _rules; s; s = s->next) {
+    if (s->type != PRSSIM_RULE) {
+      s->kind = PRSSIM_KIND_PASS;
+    }
+    else if (!s->std_delay) {
+      s->kind = PRSSIM_KIND_TABLE;
+    }
+    else if (s->up[PRSSIM_WEAK] || s->dn[PRSSIM_WEAK]) {
+      s->kind = PRSSIM_KIND_WEAK;
+    }
+    else {
+      s->kind = PRSSIM_KIND_STATIC;
+    }
+  }
+}
+
 
 /* 2 = X */
 static const int _not_table[3] = { 1, 0, 2 };
@@ -949,6 +1122,58 @@ int OnePrsSim::eval (prssim_expr *x, int cause, int *lid)
   return 0;
 }
 
+/*
+ * Non-recursive evaluation of a compiled pull-up/pull-down
+ * expression. Same semantics as eval(), including the cause lid.
+ */
+int OnePrsSim::_ceval (const int *code, int cause, int *lid)
+{
+  unsigned char stk[PRSSIM_MAX_STACK];
+  int sp = 0;
+  int op;
+
+  while ((op = *code++) != PRSSIM_OP_END) {
+    if (op >= 0) {
+      if (op == cause) {
+	*lid = *code;
+      }
+      code++;
+      stk[sp++] = _proc->getGlobalBool (op);
+    }
+    else {
+      switch (op) {
+      case PRSSIM_OP_AND:
+	sp--;
+	stk[sp-1] = _and_table[stk[sp-1]][stk[sp]];
+	break;
+
+      case PRSSIM_OP_OR:
+	sp--;
+	stk[sp-1] = _or_table[stk[sp-1]][stk[sp]];
+	break;
+
+      case PRSSIM_OP_NOT:
+	stk[sp-1] = _not_table[stk[sp-1]];
+	break;
+
+      case PRSSIM_OP_TRUE:
+	stk[sp++] = 1;
+	break;
+
+      case PRSSIM_OP_FALSE:
+	stk[sp++] = 0;
+	break;
+
+      default:
+	fatal_error ("What?");
+	break;
+      }
+    }
+  }
+  Assert (sp == 1, "What?");
+  return stk[0];
+}
+
 
 static int _breakpt;
 
@@ -988,17 +1213,306 @@ static int _breakpt;
 	}								\
 	ed = (ob)->_proc->getDelay (ed);				\
 	(of)->flags = (1 + (x));					\
-	(of)->_pending = new Event (this, SIM_EV_MKTYPE ((x), 0), ed);	\
+	(of)->_pending = ActSimEvents::mk (this, SIM_EV_MKTYPE ((x), 0), ed); \
       }									\
     }									\
   } while (0)
 
 
+#define WARNING_MSG(ob,s,t)				\
+  do {							\
+    (ob)->_proc->msgPrefix();				\
+    printf ("WARNING: " s " on `");			\
+    (ob)->_proc->printName (stdout, (ob)->_me->vid);	\
+    if (cause) {					\
+      ActSimDES *xx = (ActSimDES *) cause;		\
+      char buf[1024];					\
+      xx->sPrintCause (buf, 1024);			\
+      printf ("'   [by %s]\n", buf);			\
+    }							\
+    else {						\
+      printf (t "'\n");					\
+    }							\
+    if ((ob)->_proc->onWarning() == 2) {		\
+      exit (1);						\
+    }							\
+    else if ((ob)->_proc->onWarning() == 1) {		\
+      _breakpt = 1;					\
+    }							\
+  } while (0)
+
+
+#define MAKE_NODE_X(obj,nid)						\
+  do {									\
+    if ((obj)->_proc->getBool ((obj)->nid) != 2) {			\
+      if ((obj)->flags != PENDING_X) {					\
+	if ((obj)->_pending) {						\
+	  ActSimEvents::cancel ((obj)->_pending);			\
+	}								\
+	(obj)->flags = PENDING_X;					\
+	(obj)->_pending =						\
+	  ActSimEvents::mk (this, SIM_EV_MKTYPE (2, 0), 1, cause);	\
+      }									\
+    }									\
+    else {								\
+      if ((obj)->flags == PENDING_0 || (obj)->flags == PENDING_1) {	\
+	(obj)->flags = 0;						\
+	if ((obj)->_pending) {						\
+	  ActSimEvents::cancel ((obj)->_pending);			\
+	  (obj)->_pending = NULL;					\
+	}								\
+      }									\
+    }									\
+  } while (0)
+
+
+/*
+ * Rule evaluation shared by the general and the specialized gate
+ * objects. WEAK and GEN are constants, so the checks on them below
+ * are resolved at compile time.
+ */
+#define PULL(dn,weak)							\
+  (GEN ? evalPull ((dn), (weak), causeid, causeid == -1 ? NULL : &lid) : \
+   _ceval (_code + _code[PRSSIM_CODE_IDX ((dn), (weak))], -1, NULL))
+
+#define SET_VAL(x)						\
+  do {								\
+    if (GEN) {							\
+      DO_SET_VAL (this,this,_me->vid, lid, causeid, (x));	\
+    }								\
+    else if (_proc->getBool (_me->vid) != (x) && flags != (1 + (x))) { \
+      _setFixed (x);						\
+    }								\
+  } while (0)
+
+inline void OnePrsSim::_setFixed (int x)
+{
+  int ed = (x == 0 ? _me->delay.dn.lookup (0) : _me->delay.up.lookup (0));
+  flags = 1 + x;
+  _pending = ActSimEvents::mk (this, SIM_EV_MKTYPE (x, 0),
+			       _proc->getDelay (ed));
+}
+
+template<int WEAK, int GEN>
+void OnePrsSim::_propagateRule (void *cause, int causeid)
+{
+  int u_state, d_state;
+  int u_weak = 0, d_weak = 0;
+  int lid = -1;
+
+  /* evaluate up, up-weak and dn, dn-weak */
+  u_state = PULL (0, PRSSIM_NORM);
+  if (WEAK && u_state == 0) {
+    u_state = PULL (0, PRSSIM_WEAK);
+    if (u_state != 0) {
+      u_weak = 1;
+    }
+  }
+
+  d_state = PULL (1, PRSSIM_NORM);
+  if (WEAK && d_state == 0) {
+    d_state = PULL (1, PRSSIM_WEAK);
+    if (d_state != 0) {
+      d_weak = 1;
+    }
+  }
+
+  /* -- check for unstable rules -- */
+  if (flags == PENDING_1 && u_state != 1) {
+    if (u_state == 2) {
+      if (!_proc->isResetMode() && !_me->unstab) {
+	if (!_proc->isHazard (_me->vid)) {
+	  WARNING_MSG (this,"weak-unstable transition", "+");
+	}
+      }
+    }
+    else {
+      if (!_me->unstab) {
+	WARNING_MSG (this,"unstable transition", "+");
+      }
+    }
+    MAKE_NODE_X (this,_me->vid);
+#if 0
+    _pending->Remove();
+    if (_proc->getBool (_me->vid) != 2) {
+      _pending = new Event (this, SIM_EV_MKTYPE (2, 0), 1, cause);
+      flags = PENDING_X;
+    }
+#endif      
+  }
+
+  if (flags == PENDING_0 && d_state != 1) {
+    if (d_state == 2) {
+      if (!_proc->isResetMode() && !_me->unstab) {
+	if (!_proc->isHazard (_me->vid)) {
+	  WARNING_MSG (this,"weak-unstable transition", "-");
+	}
+      }
+    }
+    else {
+      if (!_me->unstab && !_proc->isHazard (_me->vid)) {
+	WARNING_MSG (this,"unstable transition", "-");
+      }
+    }
+    MAKE_NODE_X (this,_me->vid);
+#if 0      
+    _pending->Remove();
+    if (_proc->getBool (_me->vid) != 2) {
+      _pending = new Event (this, SIM_EV_MKTYPE (2, 0), 1, cause);
+      flags = PENDING_X;
+    }
+#endif      
+  }
+
+  if (u_state == 0) {
+    switch (d_state) {
+    case 0:
+      /* nothing to do */
+      break;
+
+    case 1:
+      /* set to 0 */
+      SET_VAL (0);
+      break;
+	
+    case 2:
+      if (_proc->getBool (_me->vid) == 1) {
+	/* u = 0, d = X: if output=1, it is now X */
+	MAKE_NODE_X (this,_me->vid);
+      }
+      break;
+    }
+  }
+  else if (u_state == 1) {
+    switch (d_state) {
+    case 0:
+      /* set to 1 */
+      SET_VAL (1);
+      break;
+
+    case 2:
+      if (!u_weak && d_weak) {
+	SET_VAL (1);
+      }
+      else {
+	if (!_proc->isResetMode()) {
+	  WARNING_MSG (this,"weak-interference", "");
+	}
+	MAKE_NODE_X (this,_me->vid);
+      }
+      break;
+
+    case 1:
+      /* interference */
+      if (u_weak && !d_weak) {
+	SET_VAL (0);
+      }
+      else if (!u_weak && d_weak) {
+	SET_VAL (1);
+      }
+      else {
+	WARNING_MSG (this, "interference", "");
+	MAKE_NODE_X (this,_me->vid);
+      }
+      break;
+    }
+  }
+  else {
+    /* u_state == 2 */
+    switch (d_state) {
+    case 0:
+      if (_proc->getBool (_me->vid) == 0) {
+	MAKE_NODE_X (this,_me->vid);
+      }
+      break;
+
+    case 1:
+      if (u_weak && !d_weak) {
+	/* set to 0 */
+	SET_VAL (0);
+      }
+      else {
+	if (!_proc->isResetMode()) {
+	  WARNING_MSG (this, "weak-interference", "");
+	}
+	MAKE_NODE_X (this,_me->vid);
+      }
+      break;
+
+    case 2:
+      /* set to X */
+      if (!_proc->isResetMode()) {
+	WARNING_MSG (this, "weak-interference", "");
+      }
+      MAKE_NODE_X (this,_me->vid);
+      break;
+    }
+  }
+}
+
+/*
+ * The output was just set to X with nothing pending: check if there
+ * should be a X -> 0 or X -> 1 transition that cleans up the X value.
+ */
+template<int WEAK, int GEN>
+void OnePrsSim::_settleX (int causeid)
+{
+  int u_state, d_state;
+  int u_weak = 0, d_weak = 0;
+  int lid = -1;
+
+  u_state = PULL (0, PRSSIM_NORM);
+  if (WEAK && u_state == 0) {
+    u_state = PULL (0, PRSSIM_WEAK);
+    if (u_state != 0) {
+      u_weak = 1;
+    }
+  }
+
+  d_state = PULL (1, PRSSIM_NORM);
+  if (WEAK && d_state == 0) {
+    d_state = PULL (1, PRSSIM_WEAK);
+    if (d_state != 0) {
+      d_weak = 1;
+    }
+  }
+
+  /* copied from propagate() */
+  if (u_state == 0) {
+    if (d_state == 1) {
+      SET_VAL (0);
+    }
+  }
+  else if (u_state == 1) {
+    if (d_state == 0) {
+      SET_VAL (1);
+    }
+    else if (d_state == 2 && (!u_weak && d_weak)) {
+      SET_VAL (1);
+    }
+    else if (d_state == 1) {
+      if (u_weak && !d_weak) {
+	SET_VAL (0);
+      }
+      else if (!u_weak && d_weak) {
+	SET_VAL (1);
+      }
+    }
+  }
+  else {
+    /* u_state == 2 */
+    if (d_state == 1) {
+      if (u_weak && !d_weak) {
+	SET_VAL (0);
+      }
+    }
+  }
+}
+
 int OnePrsSim::Step (Event *ev)
 {
   void *cause = ev->getCause ();
   int causeid;
-  int lid = -1;
   int ev_type = ev->getType ();
   int t = SIM_EV_TYPE (ev_type);
 
@@ -1010,6 +1524,8 @@ int OnePrsSim::Step (Event *ev)
     causeid = -1;
   }
 
+  ActSimEvents::fire (_proc);
+
   _breakpt = 0;
   _pending = NULL;
 
@@ -1039,59 +1555,7 @@ int OnePrsSim::Step (Event *ev)
        pending that cleans up this X value
     */
     if (t == 2 /* X */ && flags == PENDING_NONE) {
-      int u_state, d_state, u_weak, d_weak;
-      u_weak = 0;
-      d_weak = 0;
-      u_state = eval (_me->up[PRSSIM_NORM], causeid,
-		      causeid == -1 ? NULL : &lid);
-      if (u_state == 0) {
-	u_state = eval (_me->up[PRSSIM_WEAK], causeid,
-			causeid == -1 ? NULL : &lid);
-	if (u_state != 0) {
-	  u_weak = 1;
-	}
-      }
-
-      d_state = eval (_me->dn[PRSSIM_NORM], causeid,
-		      causeid == -1 ? NULL : &lid);
-      if (d_state == 0) {
-	d_state = eval (_me->dn[PRSSIM_WEAK], causeid,
-			causeid == -1 ? NULL : &lid);
-	if (d_state != 0) {
-	  d_weak = 1;
-	}
-      }
-
-      /* copied from propagate() */
-      if (u_state == 0) {
-	if (d_state == 1) {
-	  DO_SET_VAL (this,this,_me->vid, lid, causeid, 0);
-	}
-      }
-      else if (u_state == 1) {
-	if (d_state == 0) {
-	  DO_SET_VAL (this,this,_me->vid, lid, causeid, 1);
-	}
-	else if (d_state == 2 && (!u_weak && d_weak)) {
-	  DO_SET_VAL (this,this,_me->vid, lid, causeid, 1);
-	}
-	else if (d_state == 1) {
-	  if (u_weak && !d_weak) {
-	    DO_SET_VAL (this,this,_me->vid, lid, causeid, 0);
-	  }
-	  else if (!u_weak && d_weak) {
-	    DO_SET_VAL (this,this,_me->vid, lid, causeid, 1);
-	  }
-	}
-      }
-      else {
-	/* u_state == 2 */
-	if (d_state == 1) {
-	  if (u_weak && !d_weak) {
-	    DO_SET_VAL (this,this,_me->vid, lid, causeid, 0);
-	  }
-	}
-      }
+      _settleX<1,1> (causeid);
     }
     break;
 
@@ -1118,55 +1582,11 @@ int OnePrsSim::matches (int val)
 }
 
 
-#define WARNING_MSG(ob,s,t)				\
-  do {							\
-    (ob)->_proc->msgPrefix();				\
-    printf ("WARNING: " s " on `");			\
-    (ob)->_proc->printName (stdout, (ob)->_me->vid);	\
-    if (cause) {					\
-      ActSimDES *xx = (ActSimDES *) cause;		\
-      char buf[1024];					\
-      xx->sPrintCause (buf, 1024);			\
-      printf ("'   [by %s]\n", buf);			\
-    }							\
-    else {						\
-      printf (t "'\n");					\
-    }							\
-    if ((ob)->_proc->onWarning() == 2) {		\
-      exit (1);						\
-    }							\
-    else if ((ob)->_proc->onWarning() == 1) {		\
-      _breakpt = 1;					\
-    }							\
-  } while (0)
-
-
-#define MAKE_NODE_X(obj,nid)						\
-  do {									\
-    if ((obj)->_proc->getBool ((obj)->nid) != 2) {			\
-      if ((obj)->flags != PENDING_X) {					\
-	if ((obj)->_pending) {						\
-	  (obj)->_pending->Remove ();					\
-	}								\
-	(obj)->flags = PENDING_X;					\
-	(obj)->_pending = new Event (this, SIM_EV_MKTYPE (2, 0), 1, cause); \
-      }									\
-    }									\
-    else {								\
-      if ((obj)->flags == PENDING_0 || (obj)->flags == PENDING_1) {	\
-	(obj)->flags = 0;						\
-	if ((obj)->_pending) {						\
-	  (obj)->_pending->Remove();					\
-	}								\
-      }									\
-    }									\
-  } while (0)
 
 void OnePrsSim::propagate (void *cause)
 {
   int u_state, d_state;
   int u_weak = 0, d_weak = 0;
-  int lid = -1;
   int causeid;
 
   if (cause) {
@@ -1250,164 +1670,48 @@ void OnePrsSim::propagate (void *cause)
     break;
 
   case PRSSIM_RULE:
-    /* evaluate up, up-weak and dn, dn-weak */
-    u_state = eval (_me->up[PRSSIM_NORM], causeid, causeid == -1 ? NULL : &lid);
-    if (u_state == 0) {
-      u_state = eval (_me->up[PRSSIM_WEAK], causeid,
-		      causeid == -1 ? NULL : &lid);
-      if (u_state != 0) {
-        u_weak = 1;
-      }
-    }
-
-    d_state = eval (_me->dn[PRSSIM_NORM], causeid,
-		    causeid == -1 ? NULL : &lid);
-    if (d_state == 0) {
-      d_state = eval (_me->dn[PRSSIM_WEAK], causeid,
-		      causeid == -1 ? NULL : &lid);
-      if (d_state != 0) {
-	d_weak = 1;
-      }
-    }
-
-    /* -- check for unstable rules -- */
-    if (flags == PENDING_1 && u_state != 1) {
-      if (u_state == 2) {
-	if (!_proc->isResetMode() && !_me->unstab) {
-	  if (!_proc->isHazard (_me->vid)) {
-	    WARNING_MSG (this,"weak-unstable transition", "+");
-	  }
-	}
-      }
-      else {
-	if (!_me->unstab) {
-	  WARNING_MSG (this,"unstable transition", "+");
-	}
-      }
-      MAKE_NODE_X (this,_me->vid);
-#if 0
-      _pending->Remove();
-      if (_proc->getBool (_me->vid) != 2) {
-	_pending = new Event (this, SIM_EV_MKTYPE (2, 0), 1, cause);
-	flags = PENDING_X;
-      }
-#endif      
-    }
+    _propagateRule<1,1> (cause, causeid);
+    break;
 
-    if (flags == PENDING_0 && d_state != 1) {
-      if (d_state == 2) {
-	if (!_proc->isResetMode() && !_me->unstab) {
-	  if (!_proc->isHazard (_me->vid)) {
-	    WARNING_MSG (this,"weak-unstable transition", "-");
-	  }
-	}
-      }
-      else {
-	if (!_me->unstab && !_proc->isHazard (_me->vid)) {
-	  WARNING_MSG (this,"unstable transition", "-");
-	}
-      }
-      MAKE_NODE_X (this,_me->vid);
-#if 0      
-      _pending->Remove();
-      if (_proc->getBool (_me->vid) != 2) {
-	_pending = new Event (this, SIM_EV_MKTYPE (2, 0), 1, cause);
-	flags = PENDING_X;
-      }
-#endif      
-    }
+  default:
+    fatal_error ("What?");
+    break;
+  }
+}
 
-    if (u_state == 0) {
-      switch (d_state) {
-      case 0:
-	/* nothing to do */
-	break;
+template<int WEAK>
+int OnePrsSimRule<WEAK>::Step (Event *ev)
+{
+  int t = SIM_EV_TYPE (ev->getType ());
 
-      case 1:
-	/* set to 0 */
-	DO_SET_VAL (this,this,_me->vid, lid, causeid, 0);
-	break;
-	
-      case 2:
-	if (_proc->getBool (_me->vid) == 1) {
-	  /* u = 0, d = X: if output=1, it is now X */
-	  MAKE_NODE_X (this,_me->vid);
-	}
-	break;
-      }
-    }
-    else if (u_state == 1) {
-      switch (d_state) {
-      case 0:
-	/* set to 1 */
-	DO_SET_VAL (this,this,_me->vid, lid, causeid, 1);
-	break;
+  ActSimEvents::fire (_proc);
 
-      case 2:
-	if (!u_weak && d_weak) {
-	  DO_SET_VAL (this,this,_me->vid, lid, causeid, 1);
-	}
-	else {
-	  if (!_proc->isResetMode()) {
-	    WARNING_MSG (this,"weak-interference", "");
-	  }
-	  MAKE_NODE_X (this,_me->vid);
-	}
-	break;
+  _breakpt = 0;
+  _pending = NULL;
 
-      case 1:
-	/* interference */
-	if (u_weak && !d_weak) {
-	  DO_SET_VAL (this,this,_me->vid, lid, causeid, 0);
-	}
-	else if (!u_weak && d_weak) {
-	  DO_SET_VAL (this,this,_me->vid, lid, causeid, 1);
-	}
-	else {
-	  WARNING_MSG (this, "interference", "");
-	  MAKE_NODE_X (this,_me->vid);
-	}
-	break;
-      }
-    }
-    else {
-      /* u_state == 2 */
-      switch (d_state) {
-      case 0:
-	if (_proc->getBool (_me->vid) == 0) {
-	  MAKE_NODE_X (this,_me->vid);
-	}
-	break;
+  if (flags == (1 + t)) {
+    flags = PENDING_NONE;
+  }
+  if (!_proc->setBool (_me->vid, t, this, (ActSimObj *)ev->getCause())) {
+    flags = PENDING_NONE;
+  }
+  if (t == 2 /* X */ && flags == PENDING_NONE) {
+    _settleX<WEAK,0> (-1);
+  }
+  return 1-_breakpt;
+}
 
-      case 1:
-	if (u_weak && !d_weak) {
-	  /* set to 0 */
-	  DO_SET_VAL (this,this,_me->vid, lid, causeid, 0);
-	}
-	else {
-	  if (!_proc->isResetMode()) {
-	    WARNING_MSG (this, "weak-interference", "");
-	  }
-	  MAKE_NODE_X (this,_me->vid);
-	}
-	break;
+template<int WEAK>
+void OnePrsSimRule<WEAK>::propagate (void *cause)
+{
+  _propagateRule<WEAK,0> (cause, -1);
+}
 
-      case 2:
-	/* set to X */
-	if (!_proc->isResetMode()) {
-	  WARNING_MSG (this, "weak-interference", "");
-	}
-	MAKE_NODE_X (this,_me->vid);
-	break;
-      }
-    }
-    break;
+template class OnePrsSimRule<0>;
+template class OnePrsSimRule<1>;
 
-  default:
-    fatal_error ("What?");
-    break;
-  }
-}
+#undef PULL
+#undef SET_VAL
 
 void PrsSim::printName (FILE *fp, int lid)
 {
@@ -1452,24 +1756,29 @@ void PrsSim::sPrintName (char *buf, int sz, int lid)
 
 
 
-bool PrsSim::setBool (int lid, int v, OnePrsSim *me, ActSimObj *cause)
+bool PrsSim::setBool (int lid, int v, OnePrsSim *me, ActSimObj *cause,
+		      bool fanout)
 {
   int off = getGlobalOffset (lid, 0);
-  SimDES **arr;
+  ActSimDES **arr;
   const ActSimCore::watchpt_bucket *nm;
   const char *nm2;
   int verb;
   int oval;
 
   verb = 0;
+  nm = NULL;
+  nm2 = NULL;
 #ifdef DUMP_ALL
   verb = 1;
 #endif  
-  if ((nm = _sc->chkWatchPt (0, off))) {
-    verb = 1;
-  }
-  if ((nm2 = _sc->chkBreakPt (0, off))) {
-    verb |= 2;
+  if (_sc->isObserved (0, off)) {
+    if ((nm = _sc->chkWatchPt (0, off))) {
+      verb = 1;
+    }
+    if ((nm2 = _sc->chkBreakPt (0, off))) {
+      verb |= 2;
+    }
   }
   if (verb) {
     oval = _sc->getBool (off);
@@ -1487,15 +1796,17 @@ bool PrsSim::setBool (int lid, int v, OnePrsSim *me, ActSimObj *cause)
     if (verb) {
       if (oval != v) {
 	if (verb & 1) {
-	  msgPrefix ();
-	  printf ("%s := %c", nm->s, (v == 2 ? 'X' : ((char)v + '0')));
-	  if (cause) {
-	    ActSimDES *xx = (ActSimDES *) cause;
-	    char buf[1024];
-	    xx->sPrintCause (buf, 1024);
-	    printf ("   [by %s]", buf);
+	  if (!nm->quiet) {
+	    msgPrefix ();
+	    printf ("%s := %c", nm->s, (v == 2 ? 'X' : ((char)v + '0')));
+	    if (cause) {
+	      ActSimDES *xx = (ActSimDES *) cause;
+	      char buf[1024];
+	      xx->sPrintCause (buf, 1024);
+	      printf ("   [by %s]", buf);
+	    }
+	    printf ("\n");
 	  }
-	  printf ("\n");
 
 	  BigInt tmpv;
 	  tmpv = v;
@@ -1509,13 +1820,16 @@ bool PrsSim::setBool (int lid, int v, OnePrsSim *me, ActSimObj *cause)
 	}
       }
     }
+    if (!fanout) {
+      return true;
+    }
     arr = _sc->getFO (off, 0);
 #ifdef DUMP_ALL
     printf (" >>> fanout: %d\n", _sc->numFanout (off, 0));
 #endif
-    for (int i=0; i < _sc->numFanout (off, 0); i++) {
-      ActSimDES *p = dynamic_cast<ActSimDES *>(arr[i]);
-      Assert (p, "What?");
+    int nfanout = _sc->numFanout (off, 0);
+    for (int i=0; i < nfanout; i++) {
+      ActSimDES *p = arr[i];
 #ifdef DUMP_ALL
       printf ("   prop: ");
       {
@@ -1621,6 +1935,35 @@ void PrsSimGraph::checkFragmentation (ActSimCore *sc, PrsSim *ps, act_prs *p)
 }
 
 
+void PrsSim::saveState (FILE *fp)
+{
+  actsim_write_u32 (fp, _nobjs);
+  for (int i=0; i < _nobjs; i++) {
+    actsim_write_u32 (fp, _sim[i].getPendingFlags ());
+  }
+}
+
+void PrsSim::restoreState (FILE *fp)
+{
+  int n = actsim_read_u32 (fp);
+  if (n != _nobjs) {
+    fatal_error ("checkpoint: production rule count mismatch");
+  }
+  /* pending events are re-attached when the event queue is restored */
+  for (int i=0; i < _nobjs; i++) {
+    _sim[i].setPending (actsim_read_u32 (fp), NULL);
+  }
+}
+
+void PrsSim::clearStalePending ()
+{
+  for (int i=0; i < _nobjs; i++) {
+    if (!_sim[i].isPending()) {
+      _sim[i].setPending (PENDING_NONE, NULL);
+    }
+  }
+}
+
 void PrsSim::dumpState (FILE *fp)
 {
   fprintf (fp, "FIXME: prs dump state!\n");
@@ -1631,7 +1974,7 @@ OnePrsSim::OnePrsSim (PrsSim *p, struct prssim_stmt *x)
   _proc = p;
   _me = x;
   _pending = NULL;
-  
+  _code = NULL;
 }
 
 void OnePrsSim::registerExcl ()
@@ -1667,7 +2010,8 @@ void PrsSim::registerExcl ()
 void OnePrsSim::flushPending ()
 {
   if (_pending) {
-    _pending->Remove ();
+    ActSimEvents::cancel (_pending);
+    _pending = NULL;
     flags = PENDING_NONE;
   }
 }
@@ -1849,6 +2193,8 @@ int MultiPrsSim::Step (Event *ev)
     causeid = -1;
   }
 
+  ActSimEvents::fire (_objs[0]->getPrsSim());
+
   _breakpt = 0;
   _objs[0]->_pending = NULL;
 
@@ -1873,7 +2219,7 @@ int MultiPrsSim::Step (Event *ev)
     u_state = 0;
     u_idx = 0;
     for (int i=0; i < _count; i++) {
-      u_state = _objs[i]->eval (_objs[i]->_me->up[PRSSIM_NORM], causeid, causeid == -1 ? NULL : &lid);
+      u_state = _objs[i]->evalPull (0, PRSSIM_NORM, causeid, causeid == -1 ? NULL : &lid);
       if (u_state == 1) {
 	u_idx = i;
 	break;
@@ -1881,7 +2227,7 @@ int MultiPrsSim::Step (Event *ev)
     }
     if (!u_state) {
       for (int i=0; i < _count; i++) {
-	u_state = _objs[i]->eval (_objs[i]->_me->up[PRSSIM_WEAK], causeid, causeid == -1 ? NULL : &lid);
+	u_state = _objs[i]->evalPull (0, PRSSIM_WEAK, causeid, causeid == -1 ? NULL : &lid);
 	if (u_state == 1) {
 	  u_idx = i;
 	  break;
@@ -1896,7 +2242,7 @@ int MultiPrsSim::Step (Event *ev)
     d_state = 0;
     d_idx = 0;
     for (int i=0; i < _count; i++) {
-      d_state = _objs[i]->eval (_objs[i]->_me->dn[PRSSIM_NORM], causeid, causeid == -1 ? NULL : &lid);
+      d_state = _objs[i]->evalPull (1, PRSSIM_NORM, causeid, causeid == -1 ? NULL : &lid);
       if (d_state == 1) {
 	d_idx = i;
 	break;
@@ -1904,7 +2250,7 @@ int MultiPrsSim::Step (Event *ev)
     }
     if (!d_state) {
       for (int i=0; i < _count; i++) {
-	d_state = _objs[i]->eval (_objs[i]->_me->dn[PRSSIM_WEAK], causeid, causeid == -1 ? NULL : &lid);
+	d_state = _objs[i]->evalPull (1, PRSSIM_WEAK, causeid, causeid == -1 ? NULL : &lid);
 	if (d_state == 1) {
 	  d_idx = i;
 	  break;
@@ -1969,7 +2315,7 @@ void MultiPrsSim::propagate (void *cause)
   u_state = 0;
   u_idx = 0;
   for (int i=0; i < _count; i++) {
-    u_state = _objs[i]->eval (_objs[i]->_me->up[PRSSIM_NORM], causeid, causeid == -1 ? NULL : &lid);
+    u_state = _objs[i]->evalPull (0, PRSSIM_NORM, causeid, causeid == -1 ? NULL : &lid);
     if (u_state == 1) {
       u_idx = i;
       break;
@@ -1977,7 +2323,7 @@ void MultiPrsSim::propagate (void *cause)
   }
   if (!u_state) {
     for (int i=0; i < _count; i++) {
-      u_state = _objs[i]->eval (_objs[i]->_me->up[PRSSIM_WEAK], causeid, causeid == -1 ? NULL : &lid);
+      u_state = _objs[i]->evalPull (0, PRSSIM_WEAK, causeid, causeid == -1 ? NULL : &lid);
       if (u_state == 1) {
 	u_idx = i;
 	break;
@@ -1992,7 +2338,7 @@ void MultiPrsSim::propagate (void *cause)
   d_state = 0;
   d_idx = 0;
   for (int i=0; i < _count; i++) {
-    d_state = _objs[i]->eval (_objs[i]->_me->dn[PRSSIM_NORM], causeid, causeid == -1 ? NULL : &lid);
+    d_state = _objs[i]->evalPull (1, PRSSIM_NORM, causeid, causeid == -1 ? NULL : &lid);
     if (d_state == 1) {
       d_idx = i;
       break;
@@ -2000,7 +2346,7 @@ void MultiPrsSim::propagate (void *cause)
   }
   if (!d_state) {
     for (int i=0; i < _count; i++) {
-      d_state = _objs[i]->eval (_objs[i]->_me->dn[PRSSIM_WEAK], causeid, causeid == -1 ? NULL : &lid);
+      d_state = _objs[i]->evalPull (1, PRSSIM_WEAK, causeid, causeid == -1 ? NULL : &lid);
       if (d_state == 1) {
 	d_idx = i;
 	break;
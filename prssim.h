@@ -231,12 +231,50 @@ struct prssim_expr {
 #define PRSSIM_NORM 0
 #define PRSSIM_WEAK 1
 
+/*
+ * Rule classes, computed when the PrsSimGraph is built. Gates in the
+ * first two classes get a specialized simulation object (see
+ * OnePrsSimRule<>) when the rule is compiled and the instance has no
+ * delay tables of its own; everything else uses the general OnePrsSim.
+ */
+#define PRSSIM_KIND_STATIC 0	/* rule, fixed delay, no weak pull */
+#define PRSSIM_KIND_WEAK   1	/* rule, fixed delay, weak pull(s) */
+#define PRSSIM_KIND_TABLE  2	/* rule with delay tables */
+#define PRSSIM_KIND_PASS   3	/* pass/transmission gate */
+#define PRSSIM_NKINDS      4
+
+/*
+ * Compiled rules. Each rule is flattened into a postfix program over
+ * global bool offsets when the PrsSim instance is created. The
+ * program for one rule is a contiguous int array:
+ *
+ *   [0..3] = start of the up, weak-up, dn, weak-dn programs
+ *   [4..]  = programs, each terminated by PRSSIM_OP_END
+ *
+ * A non-negative entry is a variable reference (global offset), and
+ * is followed by the local id of the variable (used for cause
+ * tracking with delay tables). Negative entries are operators.
+ */
+#define PRSSIM_OP_END   -1
+#define PRSSIM_OP_AND   -2
+#define PRSSIM_OP_OR    -3
+#define PRSSIM_OP_NOT   -4
+#define PRSSIM_OP_TRUE  -5
+#define PRSSIM_OP_FALSE -6
+
+#define PRSSIM_CODE_HDR 4
+#define PRSSIM_CODE_IDX(dn,weak) (2*(dn)+(weak))
+
+/* rules that need a deeper evaluation stack use the expression tree */
+#define PRSSIM_MAX_STACK 64
+
 
 struct prssim_stmt {
   unsigned int type:2;		/* RULE, P, N, TRANSGATE */
   unsigned int unstab:1;	/* is unstable? */
   unsigned int std_delay:1;     /* 1 if this uses the standard delay,
 				   0 if it uses delay tables */
+  unsigned int kind:2;		/* PRSSIM_KIND_... */
   struct prssim_stmt *next;
 
   // default inst-independent delays/delay tables
@@ -325,6 +363,8 @@ public:
   prssim_stmt *getRules () { return _rules; }
   struct Hashtable *getLabels() { return _labels; }
 
+  void classify ();		/* set the kind of each rule */
+
 
   static PrsSimGraph *buildPrsSimGraph (ActSimCore *, act_prs *, sdf_cell *ci);
   static void checkFragmentation (ActSimCore *, PrsSim *, act_prs *);
@@ -369,7 +409,8 @@ class PrsSim : public ActSimObj {
   /*
     me, cause are both used for cause tracing
   */
-  bool setBool (int lid, int v, OnePrsSim *me, ActSimObj *cause = NULL);
+  bool setBool (int lid, int v, OnePrsSim *me, ActSimObj *cause = NULL,
+		bool fanout = true);
 
   void printName (FILE *fp, int lid);
   void sPrintName (char *buf, int sz, int lid);
@@ -387,9 +428,28 @@ class PrsSim : public ActSimObj {
   void updateDelays (act_prs *prs, sdf_celltype *ci);
 
   inline gate_delay_info *getInstDelay (OnePrsSim *sim);
+
+  int getGlobalBool (int gid) { return _sc->getBool (gid); }
+
+  int numGates() { return _nobjs; }
+
+  /* checkpoint support: pending flags of every gate */
+  void saveState (FILE *fp);
+  void restoreState (FILE *fp);
+  void clearStalePending ();
+  int gateIndex (OnePrsSim *g) { return g - _sim; }
+  OnePrsSim *getGate (int i) { return &_sim[i]; }
+
+  /* # of gates of each kind, and # of those using OnePrsSim */
+  int numKind (int k) { return _nkind[k]; }
+  int numGeneric () { return _ngeneric; }
   
  private:
-  void _computeFanout (prssim_expr *, SimDES *);
+  void _computeFanout (prssim_expr *, ActSimDES *);
+
+  int _codeSize (prssim_expr *, int *depth);
+  int *_compile (prssim_expr *, int *code);
+  int _ruleCode (prssim_stmt *, int *code);
 
   void _updatePrs (act_prs_lang_t *p);
   
@@ -398,16 +458,40 @@ class PrsSim : public ActSimObj {
   int _nobjs;			     // # of simulation objects
   OnePrsSim *_sim;		     // simulation objects
   gate_delay_info **_inst_gate_delay; // delay info specific to each instance
+
+  int *_code;			     // compiled rules for all objects
+
+  int _nkind[PRSSIM_NKINDS];	     // histogram of rule kinds
+  int _ngeneric;		     // # of gates not specialized
 };
 
 
 /*-- not actsimobj so that it can be lightweight --*/
 class OnePrsSim : public ActSimDES {
-private:
+protected:
   PrsSim *_proc;		// process core [maps, etc]
   struct prssim_stmt *_me;	// the rule
   Event *_pending;
+  int *_code;			// compiled rule, NULL if not compiled
   int eval (prssim_expr *, int cause_id = -1, int *lid = NULL);
+  int _ceval (const int *code, int cause_id, int *lid);
+
+  /* evaluate up (dn=0) or dn (dn=1) pull, normal or weak */
+  inline int evalPull (int dn, int weak, int cause_id, int *lid) {
+    if (_code) {
+      return _ceval (_code + _code[PRSSIM_CODE_IDX (dn, weak)],
+		     cause_id, lid);
+    }
+    return eval (dn ? _me->dn[weak] : _me->up[weak], cause_id, lid);
+  }
+
+  /*
+    Rule evaluation. WEAK = 0 skips the weak pulls; GEN = 0 assumes
+    compiled code and a fixed delay. The general object uses <1,1>.
+  */
+  template<int WEAK, int GEN> void _propagateRule (void *cause, int causeid);
+  template<int WEAK, int GEN> void _settleX (int causeid);
+  inline void _setFixed (int x);
 
 public:
   OnePrsSim (PrsSim *p, struct prssim_stmt *x);
@@ -422,11 +506,37 @@ public:
   void sPrintCause (char *buf, int sz);
   int causeGlobalIdx ();
   PrsSim *getPrsSim() { return _proc; }
+  ActSimObj *profObj () { return _proc; }
   int getPending();
+  void setCode (int *code) { _code = code; }
+  int getPendingFlags () { return flags; }
+  void setPending (int f, Event *ev) { flags = f; _pending = ev; }
+
+  /* node driven by this gate, and its compiled code (NULL if none) */
+  int outLid () { return _me->type == PRSSIM_RULE ? _me->vid : _me->t2; }
+  int outGid () { return _proc->myGid (outLid ()); }
+  const int *getCode () { return _code; }
 
   friend class MultiPrsSim;
 };
 
+/*
+ * Specialized object for a compiled rule with a fixed delay that is not
+ * part of a multi-driver. It has no state beyond OnePrsSim, so it can be
+ * constructed in place in the PrsSim gate array.
+ */
+template<int WEAK>
+class OnePrsSimRule : public OnePrsSim {
+public:
+  OnePrsSimRule (PrsSim *p, struct prssim_stmt *x) : OnePrsSim (p, x) { }
+  int Step (Event *ev);
+  void propagate (void *cause);
+};
+
+static_assert (sizeof (OnePrsSimRule<0>) == sizeof (OnePrsSim) &&
+	       sizeof (OnePrsSimRule<1>) == sizeof (OnePrsSim),
+	       "OnePrsSimRule<> must fit in a OnePrsSim slot");
+
 class MultiPrsSim : public ActSimDES {
 private:
   OnePrsSim **_objs;
@@ -464,6 +574,7 @@ public:
   void propagate (void *cause);
   void sPrintCause (char *buf, int sz);
   int causeGlobalIdx ();
+  ActSimObj *profObj () { return _objs[0]->getPrsSim(); }
 };
 
 #endif /* __ACT_CHP_SIM_H__ */
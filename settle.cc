@@ -0,0 +1,450 @@
+/*************************************************************************
+ *
+ *  Copyright (c) 2024 Rajit Manohar
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA  02110-1301, USA.
+ *
+ **************************************************************************
+ */
+#include <string.h>
+#include "actsim.h"
+#include "prssim.h"
+
+
+/*************************************************************************
+ *
+ * Levelized settling of production rules during reset
+ *
+ * During reset, most of the work done by the event-driven engine is
+ * spent rippling the reset value through combinational logic one
+ * event at a time. Here we instead order the simple production rules
+ * by level and evaluate them in place on a private copy of the
+ * Boolean state, repeating until nothing changes. The state copy and
+ * the comparison against the original state are done a word at a
+ * time; only the Booleans that actually changed are written back
+ * through the normal path, so watchpoints, breakpoints, and traces
+ * see the new values.
+ *
+ * Only compiled, fixed-delay rules without weak pulls whose output
+ * has a single driver and no constraints are handled here; everything
+ * else is left to the event-driven engine and is woken up through the
+ * fanout of the changed Booleans.
+ *
+ *************************************************************************
+ */
+
+static const unsigned char _s_and[3][3] = { { 0, 0, 0 },
+					     { 0, 1, 2 },
+					     { 0, 2, 2 } };
+
+static const unsigned char _s_or[3][3] = { { 0, 1, 2 },
+					    { 1, 1, 1 },
+					    { 2, 1, 2 } };
+
+static const unsigned char _s_not[3] = { 1, 0, 2 };
+
+
+ActSimSettle::ActSimSettle (ActSim *sim)
+{
+  int nb, n;
+  int *ndrv, *cand;
+  int *indeg, *level, *start, *adj, *order;
+  int nedges, head, tail;
+
+  Assert (sim, "What?");
+  _sim = sim;
+  _ngates = 0;
+  _acyclic = 0;
+  _nlevels = 0;
+  _gate = NULL;
+  _out = NULL;
+  _drv = NULL;
+  _v = NULL;
+  _x = NULL;
+  _v0 = NULL;
+  _x0 = NULL;
+
+  A_INIT (_objs);
+  _collect (sim->getInstTable ());
+
+  _nwords = sim->getState()->numBoolWords ();
+  nb = sim->getState()->numBools ();
+  if (nb == 0) {
+    return;
+  }
+
+  /*-- # of production rule drivers for each Boolean --*/
+  MALLOC (ndrv, int, nb);
+  for (int i=0; i < nb; i++) {
+    ndrv[i] = 0;
+  }
+  n = 0;
+  for (int i=0; i < A_LEN (_objs); i++) {
+    for (int j=0; j < _objs[i]->numGates(); j++) {
+      ndrv[_objs[i]->getGate (j)->outGid()]++;
+    }
+    n += _objs[i]->numGates();
+  }
+  if (n == 0) {
+    FREE (ndrv);
+    return;
+  }
+
+  /*-- pick the gates we can evaluate directly --*/
+  MALLOC (_gate, OnePrsSim *, n);
+  MALLOC (_drv, int, nb);
+  for (int i=0; i < nb; i++) {
+    _drv[i] = -1;
+  }
+  for (int i=0; i < A_LEN (_objs); i++) {
+    PrsSim *ps = _objs[i];
+    for (int j=0; j < ps->numGates(); j++) {
+      OnePrsSim *g = ps->getGate (j);
+      if (!dynamic_cast<OnePrsSimRule<0> *> (g)) {
+	continue;
+      }
+      if (ndrv[g->outGid()] != 1 || ps->isSpecialBool (g->outLid())) {
+	continue;
+      }
+      _drv[g->outGid()] = _ngates;
+      _gate[_ngates++] = g;
+    }
+  }
+  FREE (ndrv);
+  if (_ngates == 0) {
+    return;
+  }
+
+  /*-- edges from the gate driving an input to the gate reading it --*/
+  MALLOC (indeg, int, _ngates);
+  MALLOC (start, int, _ngates + 1);
+  for (int i=0; i <= _ngates; i++) {
+    if (i < _ngates) {
+      indeg[i] = 0;
+    }
+    start[i] = 0;
+  }
+  nedges = 0;
+  adj = NULL;
+  for (int pass=0; pass < 2; pass++) {
+    if (pass == 1) {
+      /* prefix sums give the adjacency list for each driver */
+      for (int i=0; i < _ngates; i++) {
+	start[i+1] += start[i];
+      }
+      nedges = start[_ngates];
+      MALLOC (adj, int, nedges > 0 ? nedges : 1);
+    }
+    for (int i=0; i < _ngates; i++) {
+      const int *code = _gate[i]->getCode ();
+      for (int dn=0; dn < 2; dn++) {
+	const int *op = code + code[PRSSIM_CODE_IDX (dn, PRSSIM_NORM)];
+	for (; *op != PRSSIM_OP_END; op++) {
+	  if (*op < 0) {
+	    continue;
+	  }
+	  int d = _drv[*op];
+	  op++;			/* skip local id */
+	  if (d == -1) {
+	    continue;
+	  }
+	  if (pass == 0) {
+	    start[d+1]++;
+	    indeg[i]++;
+	  }
+	  else {
+	    adj[--start[d+1]] = i;
+	  }
+	}
+      }
+    }
+  }
+  /* filling moved each start[d+1] back to the beginning of list d */
+  for (int i=0; i < _ngates; i++) {
+    start[i] = start[i+1];
+  }
+  start[_ngates] = nedges;
+
+  /*-- topological order, recording the level of each gate --*/
+  MALLOC (order, int, _ngates);
+  MALLOC (level, int, _ngates);
+  head = 0;
+  tail = 0;
+  for (int i=0; i < _ngates; i++) {
+    level[i] = -1;
+    if (indeg[i] == 0) {
+      level[i] = 0;
+      order[tail++] = i;
+    }
+  }
+  while (head < tail) {
+    int g = order[head++];
+    if (level[g] + 1 > _nlevels) {
+      _nlevels = level[g] + 1;
+    }
+    for (int e = start[g]; e < start[g+1]; e++) {
+      int h = adj[e];
+      if (level[h] < level[g] + 1) {
+	level[h] = level[g] + 1;
+      }
+      if (--indeg[h] == 0) {
+	order[tail++] = h;
+      }
+    }
+  }
+  _acyclic = tail;
+
+  /* gates in (or after) a cycle go last, in their original order */
+  for (int i=0; i < _ngates; i++) {
+    if (indeg[i] > 0) {
+      order[tail++] = i;
+    }
+  }
+  Assert (tail == _ngates, "What?");
+
+  {
+    OnePrsSim **tmp;
+    MALLOC (tmp, OnePrsSim *, _ngates);
+    MALLOC (_out, int, _ngates);
+    for (int i=0; i < _ngates; i++) {
+      tmp[i] = _gate[order[i]];
+      _out[i] = tmp[i]->outGid ();
+      _drv[_out[i]] = i;
+    }
+    FREE (_gate);
+    _gate = tmp;
+  }
+
+  FREE (indeg);
+  FREE (start);
+  FREE (adj);
+  FREE (order);
+  FREE (level);
+
+  MALLOC (_v, unsigned long, _nwords);
+  MALLOC (_x, unsigned long, _nwords);
+  MALLOC (_v0, unsigned long, _nwords);
+  MALLOC (_x0, unsigned long, _nwords);
+}
+
+ActSimSettle::~ActSimSettle ()
+{
+  A_FREE (_objs);
+  if (_gate) {
+    FREE (_gate);
+  }
+  if (_out) {
+    FREE (_out);
+  }
+  if (_drv) {
+    FREE (_drv);
+  }
+  if (_v) {
+    FREE (_v);
+    FREE (_x);
+    FREE (_v0);
+    FREE (_x0);
+  }
+}
+
+void ActSimSettle::_collect (ActInstTable *t)
+{
+  if (!t) {
+    return;
+  }
+  if (t->obj) {
+    PrsSim *ps = dynamic_cast<PrsSim *> (t->obj);
+    if (ps) {
+      A_NEW (_objs, PrsSim *);
+      A_NEXT (_objs) = ps;
+      A_INC (_objs);
+    }
+  }
+  if (t->H) {
+    hash_bucket_t *b;
+    hash_iter_t i;
+    hash_iter_init (t->H, &i);
+    while ((b = hash_iter_next (t->H, &i))) {
+      _collect ((ActInstTable *) b->v);
+    }
+  }
+}
+
+void ActSimSettle::_set (int off, int v)
+{
+  unsigned long m = ACT_BOOL_MASK (off);
+  int w = ACT_BOOL_WORD (off);
+  if (v == 2) {
+    _x[w] |= m;
+  }
+  else {
+    _x[w] &= ~m;
+    if (v) {
+      _v[w] |= m;
+    }
+    else {
+      _v[w] &= ~m;
+    }
+  }
+}
+
+/* same as OnePrsSim::_ceval, but on the private copy of the state */
+int ActSimSettle::_eval (const int *code)
+{
+  unsigned char stk[PRSSIM_MAX_STACK];
+  int sp = 0;
+  int op;
+
+  while ((op = *code++) != PRSSIM_OP_END) {
+    if (op >= 0) {
+      code++;
+      stk[sp++] = _get (op);
+    }
+    else {
+      switch (op) {
+      case PRSSIM_OP_AND:
+	sp--;
+	stk[sp-1] = _s_and[stk[sp-1]][stk[sp]];
+	break;
+
+      case PRSSIM_OP_OR:
+	sp--;
+	stk[sp-1] = _s_or[stk[sp-1]][stk[sp]];
+	break;
+
+      case PRSSIM_OP_NOT:
+	stk[sp-1] = _s_not[stk[sp-1]];
+	break;
+
+      case PRSSIM_OP_TRUE:
+	stk[sp++] = 1;
+	break;
+
+      case PRSSIM_OP_FALSE:
+	stk[sp++] = 0;
+	break;
+
+      default:
+	fatal_error ("What?");
+	break;
+      }
+    }
+  }
+  Assert (sp == 1, "What?");
+  return stk[0];
+}
+
+int ActSimSettle::Run (int max_passes)
+{
+  ActSimState *st = _sim->getState ();
+  int passes, changed, interf;
+  int nchg;
+
+  if (_ngates == 0) {
+    return 0;
+  }
+
+  /*-- the settled values replace anything in flight --*/
+  for (int i=0; i < _ngates; i++) {
+    _gate[i]->flushPending ();
+  }
+
+  for (int w=0; w < _nwords; w++) {
+    _v0[w] = st->getBoolWord (w);
+    _x0[w] = st->getXWord (w);
+  }
+  memcpy (_v, _v0, sizeof (unsigned long)*_nwords);
+  memcpy (_x, _x0, sizeof (unsigned long)*_nwords);
+
+  passes = 0;
+  do {
+    changed = 0;
+    interf = 0;
+    for (int i=0; i < _ngates; i++) {
+      const int *code = _gate[i]->getCode ();
+      int u = _eval (code + code[PRSSIM_CODE_IDX (0, PRSSIM_NORM)]);
+      int d = _eval (code + code[PRSSIM_CODE_IDX (1, PRSSIM_NORM)]);
+      int cur = _get (_out[i]);
+      int nv = cur;
+
+      /* same outcome as the event-driven rule, minus the delay */
+      if (u == 0) {
+	if (d == 1) {
+	  nv = 0;
+	}
+	else if (d == 2 && cur == 1) {
+	  nv = 2;
+	}
+      }
+      else if (u == 1) {
+	if (d == 0) {
+	  nv = 1;
+	}
+	else {
+	  if (d == 1) {
+	    interf++;
+	  }
+	  nv = 2;
+	}
+      }
+      else {
+	if (d != 0 || cur == 0) {
+	  nv = 2;
+	}
+      }
+      if (nv != cur) {
+	_set (_out[i], nv);
+	changed = 1;
+      }
+    }
+    passes++;
+  } while (changed && passes < max_passes);
+
+  if (changed) {
+    warning ("Levelized reset did not settle after %d passes", passes);
+  }
+  if (interf > 0) {
+    warning ("Levelized reset: interference on %d gate%s", interf,
+	     interf > 1 ? "s" : "");
+  }
+
+  /*-- write back the Booleans that changed, then notify fanout --*/
+  A_DECL (int, chg);
+  A_INIT (chg);
+  for (int w=0; w < _nwords; w++) {
+    unsigned long diff = (_x0[w] ^ _x[w]) | (~_x[w] & (_v0[w] ^ _v[w]));
+    while (diff) {
+      int off = w*ACT_BOOL_WORDBITS + __builtin_ctzl (diff);
+      OnePrsSim *g = _gate[_drv[off]];
+      diff &= diff - 1;
+      g->getPrsSim()->setBool (g->outLid(), _get (off), g, NULL, false);
+      A_NEW (chg, int);
+      A_NEXT (chg) = off;
+      A_INC (chg);
+    }
+  }
+  for (int i=0; i < A_LEN (chg); i++) {
+    int off = chg[i];
+    ActSimDES **arr = _sim->getFO (off, 0);
+    int nfanout = _sim->numFanout (off, 0);
+    for (int j=0; j < nfanout; j++) {
+      arr[j]->propagate (_gate[_drv[off]]);
+    }
+  }
+  nchg = A_LEN (chg);
+  A_FREE (chg);
+  return nchg;
+}
@@ -28,45 +28,78 @@
 
 L_A_DECL(FILE*, rom_fp);
 
-extern "C" expr_res actsim_read_rom(int argc, struct expr_res* args) {
-    expr_res ret;
-    ret.width = 64;
-    ret.v = 0;
-    if (argc != 1) {
-        fprintf(stderr, "actim_read_rom: should have 1 argument only\n");
-        return ret;
-    }
+/*
+ * Read the next value from ROM id; returns 0 on error/end of file.
+ */
+static unsigned long _read_rom(unsigned long id) {
+    unsigned long v = 0;
 
-    if (args[0].v > 4000) {
+    if (id > 4000) {
         fprintf(stderr, "actsim_read_rom: more than 4000 ROMSs?!\n");
-        return ret;
+        return 0;
     }
 
-    while (args[0].v >= A_LEN(rom_fp)) {
+    while (id >= A_LEN(rom_fp)) {
         A_NEW(rom_fp, FILE*);
         A_NEXT(rom_fp) = NULL;
         A_INC(rom_fp);
     }
-    if (!rom_fp[args[0].v]) {
+    if (!rom_fp[id]) {
         char buf[100];
-        snprintf(buf, 100, "_rom_file_.%d", (int)args[0].v);
-        rom_fp[args[0].v] = fopen(buf, "r");
-        if (!rom_fp[args[0].v]) {
+        snprintf(buf, 100, "_rom_file_.%d", (int)id);
+        rom_fp[id] = fopen(buf, "r");
+        if (!rom_fp[id]) {
             fprintf(stderr, "Could not open file `%s' for ROM contents.\n",
                     buf);
-            return ret;
+            return 0;
         }
     }
-    if (rom_fp[args[0].v]) {
-        if (fscanf(rom_fp[args[0].v], "%lx", &ret.v) != 1) {
-            ret.v = 0;
-            fclose(rom_fp[args[0].v]);
-            rom_fp[args[0].v] = NULL;
+    if (rom_fp[id]) {
+        if (fscanf(rom_fp[id], "%lx", &v) != 1) {
+            v = 0;
+            fclose(rom_fp[id]);
+            rom_fp[id] = NULL;
         }
     }
+    return v;
+}
+
+extern "C" expr_res actsim_read_rom(int argc, struct expr_res* args) {
+    expr_res ret;
+    ret.width = 64;
+    ret.v = 0;
+    if (argc != 1) {
+        fprintf(stderr, "actim_read_rom: should have 1 argument only\n");
+        return ret;
+    }
+    ret.v = _read_rom(args[0].v);
     return ret;
 }
 
+/*
+ * Batched form of actsim_read_rom (see actsim_ext.h): services ncalls
+ * reads in one invocation.
+ */
+extern "C" int actsim_read_rom_batch(int ncalls, int nargs,
+                                     expr_arg* args, expr_arg* ret) {
+    if (nargs != 1) {
+        fprintf(stderr, "actim_read_rom: should have 1 argument only\n");
+        return 1;
+    }
+    for (int i = 0; i < ncalls; i++) {
+        expr_arg* a = &args[i];
+        if (a->n != 1 || ret[i].n != 1) {
+            fprintf(stderr, "actsim_read_rom: integer argument expected\n");
+            return 1;
+        }
+        for (int j = 0; j < ret[i].val[0].len; j++) {
+            ret[i].val[0].v[j] = 0;
+        }
+        ret[i].val[0].v[0] = _read_rom(a->val[0].v[0]);
+    }
+    return 0;
+}
+
 extern "C" expr_res actsim_close_rom(int argc, struct expr_res* args) {
     expr_res ret;
     ret.width = 64;
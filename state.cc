@@ -32,25 +32,45 @@ ActSimState::ActSimState (int bools, int ints, int chantot)
   nbools = bools;
   
   if (bools > 0) {
-    bits = bitset_new (bools*3);
-    for (int i=0; i < bools; i++) {
-      bitset_set (bits, 3*i+1);
+    nbwords = (bools + ACT_BOOL_WORDBITS - 1)/ACT_BOOL_WORDBITS;
+    MALLOC (bval, unsigned long, nbwords);
+    MALLOC (bx, unsigned long, nbwords);
+    MALLOC (bspecial, unsigned long, nbwords);
+    for (int i=0; i < nbwords; i++) {
+      bval[i] = 0;
+      bx[i] = ~0UL;
+      bspecial[i] = 0;
+    }
+    /* everything starts out as X; unused bits in the last word are
+       zero in all planes */
+    if (bools % ACT_BOOL_WORDBITS) {
+      bx[nbwords-1] = ACT_BOOL_MASK (bools) - 1;
     }
   }
   else {
-    bits = NULL;
+    nbwords = 0;
+    bval = NULL;
+    bx = NULL;
+    bspecial = NULL;
   }
   hazards = NULL;
 
   nints = ints;
+  A_INIT (iwide);
+  A_INIT (iwide_free);
   if (nints > 0) {
-    MALLOC (ival, BigInt, nints);
+    BigInt tmp;
+    MALLOC (ival, unsigned long, nints);
+    MALLOC (iwidth, unsigned char, nints);
     for (int i=0; i < nints; i++) {
-      new (&ival[i]) BigInt;
+      ival[i] = 0;
+      iwidth[i] = 0;
+      _setInt (i, tmp);
     }
   }
   else {
     ival = NULL;
+    iwidth = NULL;
   }
 
   nchans = chantot;
@@ -70,12 +90,22 @@ ActSimState::ActSimState (int bools, int ints, int chantot)
 
 ActSimState::~ActSimState()
 {
-  if (bits) {
-    bitset_free (bits);
+  if (bval) {
+    FREE (bval);
+    FREE (bx);
+    FREE (bspecial);
   }
   if (ival) {
     FREE (ival);
+    FREE (iwidth);
+  }
+  for (int i=0; i < A_LEN (iwide); i++) {
+    if (iwide[i]) {
+      delete iwide[i];
+    }
   }
+  A_FREE (iwide);
+  A_FREE (iwide_free);
   if (chans) {
     for (int i=0; i < nchans; i++) {
       chans[i].~act_channel_state();
@@ -92,38 +122,99 @@ ActSimState::~ActSimState()
   list_free (extra_state);
 }
 		 
-BigInt *ActSimState::getInt (int x)
+/*
+ * Make integer x wide, giving it an entry in iwide
+ */
+void ActSimState::_setWide (int x)
 {
-  Assert (0 <= x && x < nints, "What");
-  return &ival[x];
+  int i;
+  if (isWideInt (x)) {
+    return;
+  }
+  if (A_LEN (iwide_free) > 0) {
+    i = iwide_free[A_LEN (iwide_free)-1];
+    A_LEN (iwide_free)--;
+  }
+  else {
+    A_NEW (iwide, BigInt *);
+    i = A_LEN (iwide);
+    A_INC (iwide);
+  }
+  iwide[i] = new BigInt;
+  ival[x] = i;
+  iwidth[x] = ACT_INT_NATIVE_BITS + 1;
 }
 
-void ActSimState::setInt (int x, BigInt &v)
+/*
+ * Release the iwide entry of integer x, if it has one
+ */
+void ActSimState::_clrWide (int x)
 {
-  Assert (0 <= x && x < nints, "What");
-  ival[x] = v;
+  if (!isWideInt (x)) {
+    return;
+  }
+  delete iwide[ival[x]];
+  iwide[ival[x]] = NULL;
+  A_NEW (iwide_free, int);
+  A_NEXT (iwide_free) = ival[x];
+  A_INC (iwide_free);
+  iwidth[x] = 0;
 }
 
-act_channel_state *ActSimState::getChan (int x)
+BigInt ActSimState::getInt (int x)
 {
-  Assert (0 <= x && x < nchans, "What");
-  return &chans[x];
+  Assert (0 <= x && x < nints, "What");
+  if (isWideInt (x)) {
+    return getWideInt (x);
+  }
+  BigInt r;
+  r.setWidth (iwidth[x]);
+  r.setVal (0, ival[x]);
+  r.toStatic ();
+  return r;
 }
 
-int ActSimState::getBool (int x)
+void ActSimState::_setInt (int x, BigInt &v)
 {
-  if (bitset_tst (bits, 3*x+1)) {
-    /* X */
-    return 2;
+  if (v.getWidth() <= ACT_INT_NATIVE_BITS) {
+    _clrWide (x);
+    ival[x] = v.getVal (0);
+    iwidth[x] = v.getWidth();
   }
-  if (bitset_tst (bits, 3*x)) {
-    return 1;
+  else {
+    _setWide (x);
+    *iwide[ival[x]] = v;
+  }
+}
+
+void ActSimState::setInt (int x, BigInt &v)
+{
+  Assert (0 <= x && x < nints, "What");
+  _setInt (x, v);
+}
+
+void ActSimState::setInt (int x, unsigned long v, int w)
+{
+  Assert (0 <= x && x < nints, "What");
+  if (w <= ACT_INT_NATIVE_BITS) {
+    _clrWide (x);
+    ival[x] = v;
+    iwidth[x] = w;
   }
   else {
-    return 0;
+    BigInt tmp;
+    tmp.setWidth (w);
+    tmp.setVal (0, v);
+    _setInt (x, tmp);
   }
 }
 
+act_channel_state *ActSimState::getChan (int x)
+{
+  Assert (0 <= x && x < nchans, "What");
+  return &chans[x];
+}
+
 bool ActSimState::setBool (int x, int v)
 {
   int special = 0;
@@ -147,20 +238,84 @@ bool ActSimState::setBool (int x, int v)
     }
   }
 
+  unsigned long m = ACT_BOOL_MASK (x);
+  int w = ACT_BOOL_WORD (x);
   if (v == 1) {
-    bitset_set (bits, 3*x);
-    bitset_clr (bits, 3*x+1);
+    bval[w] |= m;
+    bx[w] &= ~m;
   }
   else if (v == 0) {
-    bitset_clr (bits, 3*x);
-    bitset_clr (bits, 3*x+1);
+    bval[w] &= ~m;
+    bx[w] &= ~m;
   }
   else {
-    bitset_set (bits, 3*x+1);
+    bx[w] |= m;
   }
   return true;
 }
 
+void ActSimState::setBoolWord (int w, unsigned long v, unsigned long xv)
+{
+  Assert (0 <= w && w < nbwords, "What?");
+  if (w == nbwords-1 && (nbools % ACT_BOOL_WORDBITS)) {
+    unsigned long m = ACT_BOOL_MASK (nbools) - 1;
+    v &= m;
+    xv &= m;
+  }
+  bval[w] = v;
+  bx[w] = xv;
+}
+
+void ActSimState::getBoolRange (int start, int n,
+				unsigned long *v, unsigned long *xv)
+{
+  int w = ACT_BOOL_WORD (start);
+  int sh = start % ACT_BOOL_WORDBITS;
+  unsigned long m;
+
+  Assert (0 <= n && n <= ACT_BOOL_WORDBITS, "What?");
+  Assert (0 <= start && start + n <= nbools, "What?");
+
+  if (n == 0) {
+    *v = 0;
+    *xv = 0;
+    return;
+  }
+  *v = bval[w] >> sh;
+  *xv = bx[w] >> sh;
+  if (sh != 0 && sh + n > ACT_BOOL_WORDBITS) {
+    *v |= bval[w+1] << (ACT_BOOL_WORDBITS - sh);
+    *xv |= bx[w+1] << (ACT_BOOL_WORDBITS - sh);
+  }
+  if (n < ACT_BOOL_WORDBITS) {
+    m = ACT_BOOL_MASK (n) - 1;
+    *v &= m;
+    *xv &= m;
+  }
+}
+
+int ActSimState::countBools (int val)
+{
+  int count = 0;
+  for (int i=0; i < nbwords; i++) {
+    unsigned long m;
+    if (val == 2) {
+      m = bx[i];
+    }
+    else if (val == 1) {
+      m = bval[i] & ~bx[i];
+    }
+    else {
+      m = ~(bval[i] | bx[i]);
+      if (i == nbwords-1 && (nbools % ACT_BOOL_WORDBITS)) {
+	m &= ACT_BOOL_MASK (nbools) - 1;
+      }
+    }
+    count += __builtin_popcountl (m);
+  }
+  return count;
+}
+
 void *ActSimState::allocState (int sz)
 {
   struct extra_state_alloc *s;
@@ -292,7 +447,7 @@ void expr_multires::_fill_helper (Data *d, ActSimCore *sc, int *pos, int *oi, in
     }
     else if (TypeFactory::isIntType (it) || TypeFactory::isEnum (it)) {
       while (sz > 0) {
-	v[*pos] = *(sc->getInt (*oi));
+	v[*pos] = sc->getInt (*oi);
 	*oi = *oi + 1;
 	*pos = *pos + 1;
 	sz--;
@@ -480,3 +635,220 @@ BigInt expr_multires::allbits () const
   }
   return res;
 }
+
+
+/*------------------------------------------------------------------------
+ *
+ *  Checkpoint support
+ *
+ *------------------------------------------------------------------------
+ */
+
+void actsim_write (FILE *fp, const void *buf, size_t sz)
+{
+  if (sz > 0 && fwrite (buf, 1, sz, fp) != sz) {
+    fatal_error ("checkpoint: write failed");
+  }
+}
+
+void actsim_read (FILE *fp, void *buf, size_t sz)
+{
+  if (sz > 0 && fread (buf, 1, sz, fp) != sz) {
+    fatal_error ("checkpoint: truncated or corrupt file");
+  }
+}
+
+/*
+ * Checkpoint values are stored little-endian with a fixed width, so
+ * the file does not depend on the host's word size or byte order.
+ */
+void actsim_write_u32 (FILE *fp, unsigned int v)
+{
+  unsigned char buf[4];
+  for (int i=0; i < 4; i++) {
+    buf[i] = (v >> (8*i)) & 0xff;
+  }
+  actsim_write (fp, buf, 4);
+}
+
+void actsim_write_u64 (FILE *fp, unsigned long v)
+{
+  unsigned char buf[8];
+  for (int i=0; i < 8; i++) {
+    buf[i] = (v >> (8*i)) & 0xff;
+  }
+  actsim_write (fp, buf, 8);
+}
+
+unsigned int actsim_read_u32 (FILE *fp)
+{
+  unsigned char buf[4];
+  unsigned int v = 0;
+  actsim_read (fp, buf, 4);
+  for (int i=3; i >= 0; i--) {
+    v = (v << 8) | buf[i];
+  }
+  return v;
+}
+
+unsigned long actsim_read_u64 (FILE *fp)
+{
+  unsigned char buf[8];
+  unsigned long v = 0;
+  actsim_read (fp, buf, 8);
+  for (int i=7; i >= 0; i--) {
+    v = (v << 8) | buf[i];
+  }
+  return v;
+}
+
+void actsim_write_bigint (FILE *fp, BigInt &v)
+{
+  int len = v.getLen ();
+  actsim_write_u32 (fp, v.getWidth ());
+  actsim_write_u32 (fp, len);
+  for (int i=0; i < len; i++) {
+    actsim_write_u64 (fp, v.getVal (i));
+  }
+}
+
+void actsim_read_bigint (FILE *fp, BigInt &v)
+{
+  int w, len;
+  w = actsim_read_u32 (fp);
+  len = actsim_read_u32 (fp);
+  v.setWidth (w);
+  if (v.getLen() != len) {
+    fatal_error ("checkpoint: integer size mismatch");
+  }
+  for (int i=0; i < len; i++) {
+    v.setVal (i, actsim_read_u64 (fp));
+  }
+}
+
+void actsim_write_multires (FILE *fp, expr_multires &v)
+{
+  actsim_write_u32 (fp, v.nvals);
+  for (int i=0; i < v.nvals; i++) {
+    actsim_write_bigint (fp, v.v[i]);
+  }
+}
+
+void actsim_read_multires (FILE *fp, expr_multires &v)
+{
+  int n = actsim_read_u32 (fp);
+  if (n < 0) {
+    fatal_error ("checkpoint: corrupt file");
+  }
+  v.resize (n);
+  for (int i=0; i < n; i++) {
+    actsim_read_bigint (fp, v.v[i]);
+  }
+}
+
+#define CHAN_NFIELDS 14
+
+void ActSimState::saveState (FILE *fp)
+{
+  for (int i=0; i < nbwords; i++) {
+    actsim_write_u64 (fp, getBoolWord (i));
+    actsim_write_u64 (fp, getXWord (i));
+  }
+
+  for (int i=0; i < nints; i++) {
+    BigInt tmp = getInt (i);
+    actsim_write_bigint (fp, tmp);
+  }
+
+  for (int i=0; i < nchans; i++) {
+    act_channel_state *ch = &chans[i];
+    unsigned int f[CHAN_NFIELDS];
+
+    f[0] = ch->send_here;
+    f[1] = ch->sender_probe;
+    f[2] = ch->recv_here;
+    f[3] = ch->receiver_probe;
+    f[4] = ch->fragmented;
+    f[5] = ch->sfrag_st;
+    f[6] = ch->rfrag_st;
+    f[7] = ch->frag_warn;
+    f[8] = ch->sufrag_st;
+    f[9] = ch->rufrag_st;
+    f[10] = ch->use_flavors;
+    f[11] = ch->send_flavor;
+    f[12] = ch->recv_flavor;
+    f[13] = ch->skip_action;
+    for (int j=0; j < CHAN_NFIELDS; j++) {
+      actsim_write_u32 (fp, f[j]);
+    }
+    actsim_write_u64 (fp, ch->count);
+    actsim_write_multires (fp, ch->data);
+    actsim_write_multires (fp, ch->data2);
+  }
+}
+
+void ActSimState::restoreState (FILE *fp)
+{
+  struct pHashtable *P;
+  phash_bucket_t *b;
+  phash_iter_t it;
+
+  for (int i=0; i < nbwords; i++) {
+    unsigned long v = actsim_read_u64 (fp);
+    unsigned long xv = actsim_read_u64 (fp);
+    setBoolWord (i, v, xv);
+  }
+
+  for (int i=0; i < nints; i++) {
+    BigInt tmp;
+    actsim_read_bigint (fp, tmp);
+    _setInt (i, tmp);
+  }
+
+  /* one probe wait list can be shared by all the channels in a guard */
+  P = phash_new (4);
+  for (int i=0; i < nchans; i++) {
+    act_channel_state *ch = &chans[i];
+    unsigned int f[CHAN_NFIELDS];
+
+    if (ch->probe && !phash_lookup (P, ch->probe)) {
+      phash_add (P, ch->probe);
+    }
+    for (int j=0; j < CHAN_NFIELDS; j++) {
+      f[j] = actsim_read_u32 (fp);
+    }
+    ch->send_here = f[0];
+    ch->sender_probe = f[1];
+    ch->recv_here = f[2];
+    ch->receiver_probe = f[3];
+    ch->fragmented = f[4];
+    ch->sfrag_st = f[5];
+    ch->rfrag_st = f[6];
+    ch->frag_warn = f[7];
+    ch->sufrag_st = f[8];
+    ch->rufrag_st = f[9];
+    ch->use_flavors = f[10];
+    ch->send_flavor = f[11];
+    ch->recv_flavor = f[12];
+    ch->skip_action = f[13];
+    ch->count = actsim_read_u64 (fp);
+    actsim_read_multires (fp, ch->data);
+    actsim_read_multires (fp, ch->data2);
+
+    /* probe waits are re-established by the probing process */
+    if (ch->sender_probe) {
+      ch->send_here = 0;
+      ch->sender_probe = 0;
+    }
+    if (ch->receiver_probe) {
+      ch->recv_here = 0;
+      ch->receiver_probe = 0;
+    }
+    ch->probe = NULL;
+  }
+  phash_iter_init (P, &it);
+  while ((b = phash_iter_next (P, &it))) {
+    delete ((WaitForOne *) b->key);
+  }
+  phash_free (P);
+}
@@ -88,16 +88,31 @@ class expr_multires {
   void Print (FILE *fp);
   
   expr_multires &operator=(expr_multires &&m) {
-    if (nvals > 0) {
-      FREE (v);
-    }
+    _delete_objects ();
     v = m.v;
     nvals = m.nvals;
     m.nvals = 0;
+    m.v = NULL;
     _d = m._d;
     _arr = m._arr;
     return *this;
   }
+
+  /* exchange contents with m; no allocation */
+  void swap (expr_multires &m) {
+    BigInt *tv = v;
+    int tn = nvals;
+    Data *td = _d;
+    Array *ta = _arr;
+    v = m.v;
+    nvals = m.nvals;
+    _d = m._d;
+    _arr = m._arr;
+    m.v = tv;
+    m.nvals = tn;
+    m._d = td;
+    m._arr = ta;
+  }
   
   expr_multires &operator=(expr_multires &m) {
     if (nvals != m.nvals) {
@@ -144,6 +159,25 @@ class expr_multires {
 
   void setAllWidths (int width);
 
+  /* change the number of values, keeping the structure type */
+  void resize (int n) {
+    if (n == nvals) {
+      return;
+    }
+    Data *d = _d;
+    Array *a = _arr;
+    _delete_objects ();
+    if (n > 0) {
+      MALLOC (v, BigInt, n);
+      for (int i=0; i < n; i++) {
+	new (&v[i]) BigInt;
+      }
+    }
+    nvals = n;
+    _d = d;
+    _arr = a;
+  }
+
   BigInt *v;
   int nvals;
 
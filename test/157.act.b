@@ -0,0 +1 @@
+cycle
@@ -0,0 +1,142 @@
+/*
+ * Micro-benchmark: getBool/setBool throughput on a 10M-node state
+ * vector, for the old layout (value, X, and special bits interleaved
+ * in one bitset_t) and the current one (separate word planes, as in
+ * ActSimState). Used by run_bool.sh
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <common/misc.h>
+#include <common/bitset.h>
+
+#define N      10000000
+#define NOPS   100000000
+
+#define WORDBITS (8*(int)sizeof (unsigned long))
+#define WORD(x)  ((x)/WORDBITS)
+#define MASK(x)  (1UL << ((x) % WORDBITS))
+
+/*-- old layout --*/
+static bitset_t *bits;
+
+static int old_get (int x)
+{
+  if (bitset_tst (bits, 3*x+1)) {
+    return 2;
+  }
+  return bitset_tst (bits, 3*x) ? 1 : 0;
+}
+
+static void old_set (int x, int v)
+{
+  if (bitset_tst (bits, 3*x+2)) {
+    return;
+  }
+  if (v == 1) {
+    bitset_set (bits, 3*x);
+    bitset_clr (bits, 3*x+1);
+  }
+  else if (v == 0) {
+    bitset_clr (bits, 3*x);
+    bitset_clr (bits, 3*x+1);
+  }
+  else {
+    bitset_set (bits, 3*x+1);
+  }
+}
+
+/*-- planes --*/
+static unsigned long *bval, *bx, *bspecial;
+
+static inline int new_get (int x)
+{
+  unsigned long m = MASK (x);
+  if (bx[WORD (x)] & m) {
+    return 2;
+  }
+  return (bval[WORD (x)] & m) ? 1 : 0;
+}
+
+static inline void new_set (int x, int v)
+{
+  unsigned long m = MASK (x);
+  int w = WORD (x);
+  if (bspecial[w] & m) {
+    return;
+  }
+  if (v == 1) {
+    bval[w] |= m;
+    bx[w] &= ~m;
+  }
+  else if (v == 0) {
+    bval[w] &= ~m;
+    bx[w] &= ~m;
+  }
+  else {
+    bx[w] |= m;
+  }
+}
+
+static double now ()
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+/* the same pseudo-random node sequence for both layouts */
+#define NEXT(x) ((x) = (x)*1103515245UL + 12345UL)
+#define NODE(x) ((int)(((x) >> 16) % N))
+
+int main (void)
+{
+  unsigned long r;
+  unsigned long sum;
+  double t;
+  int nw = (N + WORDBITS - 1)/WORDBITS;
+
+  bits = bitset_new (3*N);
+  bval = (unsigned long *) calloc (nw, sizeof (unsigned long));
+  bx = (unsigned long *) calloc (nw, sizeof (unsigned long));
+  bspecial = (unsigned long *) calloc (nw, sizeof (unsigned long));
+  if (!bval || !bx || !bspecial) {
+    fprintf (stderr, "out of memory\n");
+    return 1;
+  }
+
+  r = 1; t = now ();
+  for (long i=0; i < NOPS; i++) {
+    NEXT (r);
+    old_set (NODE (r), i % 3);
+  }
+  printf ("old setBool: %6.2f ns/op\n", (now () - t)*1e9/NOPS);
+  r = 1; sum = 0; t = now ();
+  for (long i=0; i < NOPS; i++) {
+    NEXT (r);
+    sum += old_get (NODE (r));
+  }
+  printf ("old getBool: %6.2f ns/op  (%lu)\n", (now () - t)*1e9/NOPS, sum);
+
+  r = 1; t = now ();
+  for (long i=0; i < NOPS; i++) {
+    NEXT (r);
+    new_set (NODE (r), i % 3);
+  }
+  printf ("new setBool: %6.2f ns/op\n", (now () - t)*1e9/NOPS);
+  r = 1; sum = 0; t = now ();
+  for (long i=0; i < NOPS; i++) {
+    NEXT (r);
+    sum += new_get (NODE (r));
+  }
+  printf ("new getBool: %6.2f ns/op  (%lu)\n", (now () - t)*1e9/NOPS, sum);
+
+  /* word-level scan: count X nodes */
+  t = now ();
+  sum = 0;
+  for (int w=0; w < nw; w++) {
+    sum += __builtin_popcountl (bx[w]);
+  }
+  printf ("new X count: %6.2f ns/node  (%lu)\n", (now () - t)*1e9/N, sum);
+  return 0;
+}
@@ -0,0 +1,29 @@
+#include <stdio.h>
+#include <act/actsim_ext.h>
+
+/* trivial external function used by run_extern.sh */
+struct expr_res ext_id (int num, struct expr_res *args)
+{
+  return args[0];
+}
+
+/* batched form of the same function */
+static long ninvoke, ncalls;
+
+int ext_idb_batch (int n, int nargs, expr_arg *args, expr_arg *ret)
+{
+  ninvoke++;
+  ncalls += n;
+  for (int i=0; i < n; i++) {
+    ret[i].val[0].v[0] = args[i].val[0].v[0];
+  }
+  return 0;
+}
+
+__attribute__((destructor)) static void ext_idb_report (void)
+{
+  if (ninvoke > 0) {
+    fprintf (stderr, "ext_idb_batch: %ld calls in %ld invocations\n",
+	     ncalls, ninvoke);
+  }
+}
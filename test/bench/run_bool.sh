@@ -0,0 +1,11 @@
+#!/bin/sh
+#
+# Measure getBool/setBool throughput on a 10M-node state vector for the
+# old interleaved layout and the current word-plane layout.
+#
+# Usage: ./run_bool.sh
+#
+
+c++ -O2 -I$ACT_HOME/include -o boolstate boolstate.cc -L$ACT_HOME/lib -lvlsilib || exit 1
+./boolstate
+rm -f boolstate
@@ -0,0 +1,44 @@
+#!/bin/sh
+#
+# Measure the cost of tracing a 256-bit bus that changes every cycle:
+# once with the bus watched but no trace file, and once with a VCD
+# trace. The watch output itself is discarded.
+#
+# Usage: ./run_bus.sh [actsim binary]
+#
+
+if [ $# -ge 1 ]
+then
+	ACTTOOL=$1
+else
+	ACTTOOL=$ACT_HOME/bin/actsim
+fi
+
+DELAY=2000000
+
+scr=/tmp/actsim_bus_$$.scr
+vcd=/tmp/actsim_bus_$$.vcd
+
+for tr in none vcd
+do
+	echo "watch x" > $scr
+	if [ $tr = vcd ]
+	then
+		echo "vcd_start $vcd" >> $scr
+	fi
+	echo "advance $DELAY" >> $scr
+	if [ $tr = vcd ]
+	then
+		echo "vcd_stop" >> $scr
+	fi
+
+	start=`date +%s.%N`
+	$ACTTOOL -cnf=../sim.conf bus.act test < $scr > /dev/null 2>&1
+	end=`date +%s.%N`
+	echo "$tr $start $end" | awk '{ printf ("trace: %-5s  time: %8.3fs\n", $1, $3 - $2); }'
+	if [ $tr = vcd ]
+	then
+		echo "  vcd size: `wc -c < $vcd` bytes"
+	fi
+	rm -f $scr $vcd
+done
@@ -0,0 +1,39 @@
+#!/bin/sh
+#
+# Measure CHP simulation throughput and heap allocations on a
+# pipeline with narrow integer datapaths (chp.act) and one with
+# structure-typed channels (chpstruct.act). Give one or more actsim
+# binaries to compare (e.g. before/after a change); allocation counts
+# are reported if valgrind is available.
+#
+# Usage: ./run_chp.sh [actsim binary ...]
+#
+
+if [ $# -eq 0 ]
+then
+	set -- $ACT_HOME/bin/actsim
+fi
+
+DELAY=2000000
+
+scr=/tmp/actsim_chp_$$.scr
+echo "event-stats -c" > $scr
+echo "advance $DELAY" >> $scr
+echo "event-stats" >> $scr
+
+for design in chp.act chpstruct.act
+do
+	echo "== $design"
+	for ACTTOOL in "$@"
+	do
+		start=`date +%s.%N`
+		nev=`$ACTTOOL -cnf=../sim.conf $design test < $scr 2>/dev/null | awk '/^Events executed:/ { print $3 }'`
+		end=`date +%s.%N`
+		echo "$ACTTOOL $nev $start $end" | awk '{ t = $4 - $3; printf ("%s\n  events: %10d  time: %8.3fs  events/sec: %.0f\n", $1, $2, t, $2/t); }'
+		if which valgrind >/dev/null 2>&1
+		then
+			valgrind $ACTTOOL -cnf=../sim.conf $design test < $scr 2>&1 >/dev/null | awk '/total heap usage/ { printf ("  heap: %s allocs, %s bytes\n", $5, $9); }'
+		fi
+	done
+done
+rm -f $scr
@@ -0,0 +1,26 @@
+#!/bin/sh
+#
+# Measure the cost of external function calls: a CHP loop calls a
+# trivial C function 10M times, first one call at a time and then
+# through the batched interface with four calls per invocation.
+#
+# Usage: ./run_extern.sh [actsim binary]
+#
+
+if [ $# -ge 1 ]
+then
+	ACTTOOL=$1
+else
+	ACTTOOL=$ACT_HOME/bin/actsim
+fi
+
+cc -O2 -fPIC -shared -I$ACT_HOME/include -o libextbench.so extern_bench.c || exit 1
+
+for proc in test test_batch
+do
+	start=`date +%s.%N`
+	echo cycle | $ACTTOOL -cnf=extern.conf extern.act $proc 2>&1 | grep ext_idb_batch
+	end=`date +%s.%N`
+	echo "$proc $start $end" | awk '{ t = $3 - $2; printf ("%-10s calls: 10000000  time: %8.3fs  ns/call: %.1f\n", $1, t, t*1e9/10000000); }'
+done
+rm -f libextbench.so
@@ -0,0 +1,52 @@
+#!/bin/sh
+#
+# Compare the global event queue with the CHP run queue
+# (initialize -q) on the CHP-only pipelines used by run_chp.sh. The
+# first pass checks that the watched channel traces are identical;
+# the second measures simulation throughput.
+#
+# Usage: ./run_rq.sh [actsim binary]
+#
+
+if [ $# -ge 1 ]
+then
+	ACTTOOL=$1
+else
+	ACTTOOL=$ACT_HOME/bin/actsim
+fi
+
+TDELAY=20000
+DELAY=2000000
+
+scr=/tmp/actsim_rq_$$.scr
+out=/tmp/actsim_rq_$$.out
+
+for design in chp.act chpstruct.act
+do
+	echo "== $design"
+	for q in "" "-q"
+	do
+		echo "initialize $q test" > $scr
+		echo "watch c[1] c[8] c[16]" >> $scr
+		echo "advance $TDELAY" >> $scr
+		$ACTTOOL -cnf=../sim.conf $design test < $scr > $out$q 2>/dev/null
+	done
+	if cmp $out $out-q >/dev/null 2>&1
+	then
+		echo "  traces: identical (`wc -l < $out` lines)"
+	else
+		echo "  traces: DIFFERENT"
+	fi
+	for q in "" "-q"
+	do
+		echo "initialize $q test" > $scr
+		echo "event-stats -c" >> $scr
+		echo "advance $DELAY" >> $scr
+		echo "event-stats" >> $scr
+		start=`date +%s.%N`
+		nev=`$ACTTOOL -cnf=../sim.conf $design test < $scr 2>/dev/null | awk '/^Events executed:/ { print $3 }'`
+		end=`date +%s.%N`
+		echo "initialize $q $nev $start $end" | awk '{ if (NF == 5) { q = $2; n = $3; s = $4; e = $5 } else { q = "  "; n = $2; s = $3; e = $4 } printf ("  initialize %s  events: %10d  time: %8.3fs\n", q, n, e - s); }'
+	done
+done
+rm -f $scr $out $out-q
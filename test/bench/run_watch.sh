@@ -0,0 +1,42 @@
+#!/bin/sh
+#
+# Measure simulation throughput with 0, 10, and 10000 watchpoints.
+# The watched nodes never change, so this measures the cost of the
+# watch/break check on each Boolean update.
+#
+# Usage: ./run_watch.sh [actsim binary]
+#
+
+if [ $# -ge 1 ]
+then
+	ACTTOOL=$1
+else
+	ACTTOOL=$ACT_HOME/bin/actsim
+fi
+
+DELAY=20000000
+
+for nw in 0 10 10000
+do
+	scr=/tmp/actsim_watch_$$.scr
+	echo "mode reset" > $scr
+	echo "set r 1" >> $scr
+	echo "cycle" >> $scr
+	i=0
+	while [ $i -lt $nw ]
+	do
+		echo "watch idle[$i]" >> $scr
+		i=`expr $i + 1`
+	done
+	echo "mode run" >> $scr
+	echo "event-stats -c" >> $scr
+	echo "set r 0" >> $scr
+	echo "advance $DELAY" >> $scr
+	echo "event-stats" >> $scr
+
+	start=`date +%s.%N`
+	nev=`$ACTTOOL -cnf=../sim.conf watch.act test < $scr 2>/dev/null | awk '/^Events executed:/ { print $3 }'`
+	end=`date +%s.%N`
+	echo "$nw $nev $start $end" | awk '{ t = $4 - $3; printf ("watchpoints: %6d  events: %10d  time: %8.3fs  events/sec: %.0f\n", $1, $2, t, $2/t); }'
+	rm -f $scr
+done
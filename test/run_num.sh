@@ -56,6 +56,12 @@ do
 	count=`expr $count + 1`
 	bname=`expr $i : '\(.*\).act'`
 	num=`expr $num + 1`
+	# a test can use its own configuration file
+	cnf=sim.conf
+	if [ -f $i.conf ]
+	then
+		cnf=$i.conf
+	fi
         if [ $bname -lt 10 ]
         then
 	   myecho ".[0$bname]"
@@ -66,13 +72,22 @@ do
              lim=8
            fi
         fi
-	if [ -f $i.scr ]
+	if [ -f $i.batch ]
+	then
+	# batch mode: drop the event count and wall time columns
+	$ACTTOOL "$@" -cnf=$cnf -b $i.batch $i 2> runs/$i.t.stderr | cut -f1-5 > runs/$i.t.stdout
+	elif [ -f $i.scr ]
 	then
-	$ACTTOOL "$@" -cnf=sim.conf $i test > runs/$i.t.stdout 2> runs/$i.t.stderr < $i.scr
+	$ACTTOOL "$@" -cnf=$cnf $i test > runs/$i.t.stdout 2> runs/$i.t.stderr < $i.scr
 	else
-	$ACTTOOL "$@" -cnf=sim.conf $i test > runs/$i.t.stdout 2> runs/$i.t.stderr <<EOF
+	$ACTTOOL "$@" -cnf=$cnf $i test > runs/$i.t.stdout 2> runs/$i.t.stderr <<EOF
 cycle
 EOF
+	fi
+	# a test can check the files it wrote; the output is compared too
+	if [ -f $i.chk ]
+	then
+	ACTTOOL="$ACTTOOL" sh $i.chk >> runs/$i.t.stdout 2>> runs/$i.t.stderr
 	fi
         grep -v "WARNING: Boolean variable \`enable" runs/$i.t.stdout > runs/$i.tmp; mv runs/$i.tmp runs/$i.t.stdout
 	ok=1
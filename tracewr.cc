@@ -0,0 +1,125 @@
+/*************************************************************************
+ *
+ *  Copyright (c) 2024 Rajit Manohar
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA  02110-1301, USA.
+ *
+ **************************************************************************
+ */
+#include <chrono>
+#include "tracewr.h"
+
+ActSimTraceWriter::ActSimTraceWriter (ActSimCore *sc, int nrecs)
+{
+  unsigned long sz;
+
+  Assert (sc, "What?");
+  _sc = sc;
+
+  /* round up to a power of two */
+  sz = 1024;
+  while (sz < (unsigned long) nrecs) {
+    sz <<= 1;
+  }
+  _mask = sz - 1;
+  MALLOC (_buf, actsim_trace_rec, sz);
+
+  _head.store (0);
+  _tail.store (0);
+  _sleeping.store (false);
+  _done.store (false);
+
+  _nrec = 0;
+  _nsync = 0;
+  _nstall = 0;
+  _nflush = 0;
+  _maxocc = 0;
+
+  _thr = std::thread (&ActSimTraceWriter::_run, this);
+}
+
+ActSimTraceWriter::~ActSimTraceWriter ()
+{
+  flush ();
+  _done.store (true);
+  _wake ();
+  _thr.join ();
+  FREE (_buf);
+}
+
+void ActSimTraceWriter::_wake ()
+{
+  std::lock_guard<std::mutex> l(_lock);
+  _cv.notify_one ();
+}
+
+void ActSimTraceWriter::flush ()
+{
+  _nflush++;
+  if (_tail.load (std::memory_order_acquire) ==
+      _head.load (std::memory_order_relaxed)) {
+    return;
+  }
+  _wake ();
+  while (_tail.load (std::memory_order_acquire) !=
+	 _head.load (std::memory_order_relaxed)) {
+    std::this_thread::yield ();
+  }
+}
+
+void ActSimTraceWriter::_run ()
+{
+  unsigned long t = _tail.load (std::memory_order_relaxed);
+
+  while (1) {
+    unsigned long h = _head.load (std::memory_order_acquire);
+    if (h == t) {
+      if (_done.load ()) {
+	break;
+      }
+      /*
+	Announce that we are going to sleep and check again; push()
+	stores head before it looks at _sleeping, so one of the two
+	sides always sees the other.
+      */
+      std::unique_lock<std::mutex> l(_lock);
+      _sleeping.store (true);
+      if (_head.load () == t && !_done.load ()) {
+	_cv.wait_for (l, std::chrono::milliseconds (10));
+      }
+      _sleeping.store (false);
+      continue;
+    }
+    /* records are written in order, and released one at a time */
+    while (t != h) {
+      _sc->writeTraceRec (&_buf[t & _mask]);
+      t++;
+      _tail.store (t, std::memory_order_release);
+    }
+  }
+}
+
+void ActSimTraceWriter::printStats (FILE *fp, int verbose)
+{
+  fprintf (fp, "Trace records queued     : %lu\n", _nrec);
+  fprintf (fp, "Trace records synchronous: %lu\n", _nsync);
+  fprintf (fp, "Ring size                : %lu\n", _mask + 1);
+  fprintf (fp, "Flushes                  : %lu\n", _nflush);
+  if (verbose) {
+    fprintf (fp, "Peak ring occupancy      : %lu\n", _maxocc);
+    fprintf (fp, "Producer stalls (full)   : %lu\n", _nstall);
+  }
+}
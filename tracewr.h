@@ -0,0 +1,117 @@
+/*************************************************************************
+ *
+ *  Copyright (c) 2024 Rajit Manohar
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA  02110-1301, USA.
+ *
+ **************************************************************************
+ */
+#ifndef __ACTSIM_TRACEWR_H__
+#define __ACTSIM_TRACEWR_H__
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "actsim.h"
+
+/*
+ * One traced change. Only changes whose time and value each fit in a
+ * single word are queued; anything wider is written synchronously
+ * after the queue has been drained.
+ */
+struct actsim_trace_rec {
+  const ActSimCore::watchpt_bucket *w; // the traced signal
+  unsigned long tm;		// simulation time
+  float ftm;			// simulation time in metric units
+  unsigned long val;		// value (0/1/2 for Booleans)
+  unsigned char type;		// 0 = bool, 1 = int, 2 = channel
+  unsigned char state;		// channel state
+};
+
+/*
+ * Background trace writer. The simulation thread is the only
+ * producer; it appends records to a fixed-size ring without taking a
+ * lock. A single writer thread drains the ring in order, calling
+ * ActSimCore::writeTraceRec() for each record, so the trace formats
+ * are only ever used by one thread at a time. flush() returns once
+ * every queued record has been written; it must be called before
+ * anything else touches the trace files or the watchpoints.
+ */
+class ActSimTraceWriter {
+public:
+  ActSimTraceWriter (ActSimCore *sc, int nrecs);
+  ~ActSimTraceWriter ();
+
+  void push (const actsim_trace_rec *r) {
+    unsigned long h = _head.load (std::memory_order_relaxed);
+    unsigned long t = _tail.load (std::memory_order_acquire);
+
+    if (h - t > _mask) {
+      /* ring full: wait for the writer */
+      _nstall++;
+      _wake ();
+      do {
+	std::this_thread::yield ();
+	t = _tail.load (std::memory_order_acquire);
+      } while (h - t > _mask);
+    }
+    _buf[h & _mask] = *r;
+    _head.store (h + 1);
+    _nrec++;
+    if (h + 1 - t > _maxocc) {
+      _maxocc = h + 1 - t;
+    }
+    if (_sleeping.load ()) {
+      _wake ();
+    }
+  }
+
+  void flush ();
+
+  /* a record was written synchronously (too wide to queue) */
+  void noteSync () { _nsync++; }
+
+  /* verbose adds the counters that depend on thread timing */
+  void printStats (FILE *fp, int verbose = 0);
+
+private:
+  ActSimCore *_sc;
+
+  actsim_trace_rec *_buf;	// ring buffer, power of two entries
+  unsigned long _mask;
+
+  std::atomic<unsigned long> _head; // next slot to fill (producer)
+  std::atomic<unsigned long> _tail; // next slot to write (writer)
+  std::atomic<bool> _sleeping;	    // writer is waiting for records
+  std::atomic<bool> _done;
+
+  std::mutex _lock;
+  std::condition_variable _cv;
+  std::thread _thr;
+
+  /* statistics, all updated by the producer */
+  unsigned long _nrec;		// # of records queued
+  unsigned long _nsync;		// # of records written synchronously
+  unsigned long _nstall;	// # of times the ring was full
+  unsigned long _nflush;	// # of flushes
+  unsigned long _maxocc;	// peak ring occupancy
+
+  void _wake ();
+  void _run ();
+};
+
+#endif /* __ACTSIM_TRACEWR_H__ */
@@ -467,7 +467,7 @@ void XyceActInterface::_addProcess (XyceSim *xc)
   A_INC (_analog_inst);
 
   if (!_pending) {
-    _pending = new Event (xc, SIM_EV_MKTYPE (0,0), 0);
+    _pending = ActSimEvents::mk (xc, SIM_EV_MKTYPE (0,0), 0);
   }
 }
 
@@ -1172,7 +1172,7 @@ void XyceActInterface::step()
       }
     }
   }
-  _pending = new Event (_analog_inst[0], SIM_EV_MKTYPE (0, 0), sim_dt);
+  _pending = ActSimEvents::mk (_analog_inst[0], SIM_EV_MKTYPE (0, 0), sim_dt);
 #endif
 }
 
@@ -1190,6 +1190,7 @@ XyceSim::~XyceSim()
 
 int XyceSim::Step (Event * /*ev*/)
 {
+  ActSimEvents::fire ();
   /* run simulation for X units of delay */
   XyceActInterface::getXyceInterface()->step ();
   return 1;
@@ -1239,10 +1240,9 @@ void XyceSim::setBool (int lid, int v)
 void XyceSim::setGlobalBool (int off, int v)
 {
   _sc->setBool (off, v);
-  SimDES **arr = _sc->getFO (off, 0);
-  for (int i=0; i < _sc->numFanout (off, 0); i++) {
-    ActSimDES *p = dynamic_cast<ActSimDES *>(arr[i]);
-    Assert (p, "What?");
-    p->propagate (this);
+  ActSimDES **arr = _sc->getFO (off, 0);
+  int nfanout = _sc->numFanout (off, 0);
+  for (int i=0; i < nfanout; i++) {
+    arr[i]->propagate (this);
   }
 }